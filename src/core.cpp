@@ -7,19 +7,35 @@
 #include <ctime>
 #include <stdarg.h>
 #include <zlib.h>
-#include "cpu.h"    
-#include "memory.h" 
-#include "io.h"
+#include <unistd.h>
+#include <pthread.h>
+#include "machine.h"
+#include "gdbstub.h"
+#include "snapshot.h"
 
 uint8_t* floppy_data = nullptr; 
 size_t floppy_size = 0;         
 
-static arm3_cpu_t* cpu = nullptr;
-static memory_t* memory = nullptr;
-static io_t* io = nullptr;
+static machine_t* machine = nullptr;
+static gdbstub_t* gdb = nullptr; // Debugger server, while acornarc_gdb_port is set
+static threadpool_t* snapshot_pool = nullptr; // Savestate (de)compression workers, created on first use
 static bool running = false;
+static char rom_profile[64] = "auto"; // acornarc_rom_profile as last applied
+
+// Frontends do not report pausing, they just stop calling retro_run. A watcher
+// thread suspends the machine's RAM (machine_suspend) once retro_run has not
+// been called for acornarc_suspend_paused seconds; the next frame restores it.
+static pthread_mutex_t machine_lock = PTHREAD_MUTEX_INITIALIZER; // Frontend calls vs the watcher
+static pthread_cond_t watcher_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t watcher;
+static bool watcher_running = false;
+static bool watcher_stop = false;
+static unsigned suspend_after = 0; // Seconds without retro_run before suspending, 0 = never
+static time_t last_run;            // CLOCK_MONOTONIC seconds of the last retro_run
 static const unsigned DEFAULT_WIDTH = 640;  // Match VIDC default
 static const unsigned DEFAULT_HEIGHT = 480; // Match VIDC default
+static unsigned geometry_width = DEFAULT_WIDTH;   // Frame size last reported to the frontend
+static unsigned geometry_height = DEFAULT_HEIGHT;
 
 static retro_video_refresh_t video_cb;
 static retro_input_poll_t input_poll_cb;
@@ -29,6 +45,7 @@ static retro_log_printf_t log_cb = nullptr;
 static bool pixel_format_set = false;
 
 static void handle_input(void);
+static void check_variables(void);
 
 static void fallback_log(const char* fmt, ...) {
     va_list args;
@@ -89,20 +106,21 @@ void retro_set_environment(retro_environment_t cb) {
     // Tell RetroArch this core can run without content
     bool no_content = true;
     env_cb(RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME, &no_content);
+
+    static const struct retro_variable variables[] = {
+        { "acornarc_render_threads", "Render threads (high resolution modes); 1|2|3|4|6|8" },
+        { "acornarc_page_dedup", "Share identical RAM pages across instances (KSM); disabled|enabled" },
+        { "acornarc_export_memory", "Export RAM and status to external tools (memfd); disabled|enabled" },
+        { "acornarc_gdb_port", "GDB server on localhost; disabled|1234|2345|3333" },
+        { "acornarc_suspend_paused", "Compress RAM while paused (seconds); disabled|10|30|60" },
+        { "acornarc_rom_profile", "ROM shortcut profile (romprofiles.txt); auto|bringup" },
+        { NULL, NULL },
+    };
+    env_cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void*)variables);
 }
 
 void retro_init(void) {
     log_message(RETRO_LOG_INFO, "retro_init called\n");
-
-    io = io_create(DEFAULT_WIDTH, DEFAULT_HEIGHT); // Initialize with default resolution
-    if (!io) {
-        log_message(RETRO_LOG_ERROR, "Failed to initialize I/O module\n");
-        send_message("Core failed to initialize I/O module");
-        running = false;
-        return;
-    }
-
-    running = true;
     log_message(RETRO_LOG_INFO, "retro_init completed successfully\n");
     send_message("Acorn Archimedes Emulator initialized");
 }
@@ -110,35 +128,36 @@ void retro_init(void) {
 bool retro_load_game(const struct retro_game_info* game) {
     log_message(RETRO_LOG_INFO, "retro_load_game called\n");
 
-    const char* rom_path = "riscos.rom"; 
-    uint32_t rom_base = 0x03800000; // Updated to match ROM_DEFAULT_BASE
-    memory = memory_create(rom_path, rom_base, io);
-    if (!memory) {
-        log_message(RETRO_LOG_ERROR, "Failed to create memory system with ROM: %s at 0x%08X\n", rom_path, rom_base);
-        send_message("Failed to create memory system");
-        return false;
-    }
-
-    cpu = cpu_create(memory);
-    if (!cpu) {
-        log_message(RETRO_LOG_ERROR, "Failed to create CPU\n");
-        send_message("Failed to create CPU");
-        memory_destroy(memory);
-        memory = nullptr;
+    // Content is an AIF or raw ARM binary run without the OS; otherwise boot the ROM
+    bool hle = game && game->path;
+    const char* rom_path = "riscos.rom";
+    machine = machine_create(rom_path, hle ? game->path : NULL, hle ? game->path : NULL);
+    if (!machine) {
+        log_message(RETRO_LOG_ERROR, "Failed to create machine\n");
+        send_message(hle ? "Failed to load image" : "Failed to create memory system");
         return false;
     }
+    snprintf(rom_profile, sizeof(rom_profile), "auto"); // machine_create selected by crc32
+    check_variables();
+    running = true;
 
-    // Write test data to video memory (assuming 4 bits per pixel)
-    uint8_t* video_mem = memory->ram + (io->vidc.video_base - RAM_BASE);
-    for (uint32_t i = 0; i < io->frame_width * io->frame_height; i++) {
-        video_mem[i] = (i % 16); // Cycle through palette entries 0-15
+    // Stop cleanly instead of spinning on a hung guest. The step budget is the
+    // old hard cap on the boot trace log.
+    watchdog_config_t watchdog = {};
+    watchdog.stuck_frames = 500;
+    watchdog.stuck_range = 256;
+    watchdog.fault_repeats = 1000;
+    watchdog.max_steps = 10000000;
+    machine_set_watchdog(machine, &watchdog);
+
+    if (hle) {
+        send_message("Image loaded");
+        return true;
     }
-
-    log_message(RETRO_LOG_INFO, "Successfully loaded ROM: %s at 0x%08X\n", rom_path, memory->rom_base);
+    log_message(RETRO_LOG_INFO, "Successfully loaded ROM: %s at 0x%08X\n", rom_path, machine->mem->rom_base);
     send_message("ROM loaded successfully");
     return true;
 }
-
 bool retro_load_game_special(unsigned game_type, const struct retro_game_info* info, size_t num_info) {
     log_message(RETRO_LOG_WARN, "retro_load_game_special not implemented\n");
     send_message("Special game loading not supported");
@@ -148,9 +167,17 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info* i
 void retro_deinit(void) {
     log_message(RETRO_LOG_INFO, "retro_deinit called\n");
     running = false;
-    if (cpu) { cpu_destroy(cpu); cpu = nullptr; }
-    if (memory) { memory_destroy(memory); memory = nullptr; }
-    if (io) { io_destroy(io); io = nullptr; }
+    if (watcher_running) {
+        pthread_mutex_lock(&machine_lock);
+        watcher_stop = true;
+        pthread_cond_signal(&watcher_wake);
+        pthread_mutex_unlock(&machine_lock);
+        pthread_join(watcher, NULL);
+        watcher_running = watcher_stop = false;
+    }
+    if (gdb) { gdbstub_destroy(gdb); gdb = nullptr; }
+    if (snapshot_pool) { threadpool_destroy(snapshot_pool); snapshot_pool = nullptr; }
+    if (machine) { machine_destroy(machine); machine = nullptr; }
     if (floppy_data) { free(floppy_data); floppy_data = nullptr; }
 }
 
@@ -170,17 +197,27 @@ void retro_get_system_info(struct retro_system_info* info) {
     memset(info, 0, sizeof(*info));
     info->library_name = "Acorn Archimedes Emulator (ARM3)";
     info->library_version = "1.0";
-    info->valid_extensions = ""; // No extensions needed
-    info->need_fullpath = false; // No content file required
+    info->valid_extensions = "aif|bin|ff8"; // Optional: run a program without the ROM
+    info->need_fullpath = true; // Images are loaded by path
     info->block_extract = false;
 }
 
+// Doubled low resolution modes, high resolution modes and woven interlaced
+// frames all differ in size; the maximum covers every mode VIDC can program
+static void get_geometry(struct retro_game_geometry* geometry) {
+    geometry->base_width = geometry_width;
+    geometry->base_height = geometry_height;
+    geometry->max_width = VIDC_MAX_OUTPUT_WIDTH;
+    geometry->max_height = VIDC_MAX_OUTPUT_HEIGHT;
+    geometry->aspect_ratio = (float)geometry_width / geometry_height;
+}
+
 void retro_get_system_av_info(struct retro_system_av_info* info) {
-    info->geometry.base_width = DEFAULT_WIDTH;
-    info->geometry.base_height = DEFAULT_HEIGHT;
-    info->geometry.max_width = DEFAULT_WIDTH;
-    info->geometry.max_height = DEFAULT_HEIGHT;
-    info->geometry.aspect_ratio = (float)DEFAULT_WIDTH / DEFAULT_HEIGHT;
+    if (machine) {
+        geometry_width = machine->io->frame_width;
+        geometry_height = machine->io->frame_height;
+    }
+    get_geometry(&info->geometry);
     info->timing.fps = 50.0;
     info->timing.sample_rate = 44100.0;
 }
@@ -188,8 +225,8 @@ void retro_get_system_av_info(struct retro_system_av_info* info) {
 unsigned retro_get_region(void) { return RETRO_REGION_PAL; }
 
 void* retro_get_memory_data(unsigned id) {
-    if (id == RETRO_MEMORY_SYSTEM_RAM && memory) {
-        return memory->ram;
+    if (id == RETRO_MEMORY_SYSTEM_RAM && machine) {
+        return machine->mem->ram;
     }
     return nullptr;
 }
@@ -201,58 +238,123 @@ size_t retro_get_memory_size(unsigned id) {
     return 0;
 }
 
-void retro_run(void) {
-    if (!running || !cpu || !memory || !io) return;
+static time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static void* watch_for_pause(void*) {
+    pthread_mutex_lock(&machine_lock);
+    while (!watcher_stop) {
+        struct timespec wake;
+        clock_gettime(CLOCK_REALTIME, &wake);
+        wake.tv_sec++;
+        pthread_cond_timedwait(&watcher_wake, &machine_lock, &wake);
+        if (machine && suspend_after && !machine->mem->store && monotonic_seconds() - last_run >= (time_t)suspend_after) {
+            machine_suspend(machine, 0); // Nothing ages while paused, so every page is as cold as it gets
+        }
+    }
+    pthread_mutex_unlock(&machine_lock);
+    return NULL;
+}
+
+static void run_frame(void) {
+    if (!running || !machine) return;
+
+    bool updated = false;
+    if (env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated) {
+        check_variables();
+    }
 
     input_poll_cb();
     handle_input();
 
-    // Update timers and check for interrupts
-    io_update_timers(io);
-
-    // Check for interrupts and handle them
-    if (io_get_irq(io) && !(cpu->cpsr & PSR_I)) {
-        // IRQ: Save CPSR, switch to IRQ mode, disable IRQs, jump to vector
-        cpu->spsr = cpu->spsr_irq = cpu->cpsr; // Save CPSR to IRQ mode SPSR
-        cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_IRQ | PSR_I;
-        cpu->registers[14] = cpu->registers[15] + 4; // Save return address (PC + 4)
-        cpu->registers[15] = 0x00000018 & ADDR_MASK; // IRQ vector
-        log_message(RETRO_LOG_INFO, "IRQ triggered\n");
-    }
-    if (io_get_fiq(io) && !(cpu->cpsr & PSR_F)) {
-        // FIQ: Save CPSR, switch to FIQ mode, disable FIQs, jump to vector
-        cpu->spsr = cpu->spsr_fiq = cpu->cpsr; // Save CPSR to FIQ mode SPSR
-        cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_FIQ | PSR_F;
-        cpu->registers[14] = cpu->registers[15] + 4; // Save return address (PC + 4)
-        cpu->registers[15] = 0x0000001C & ADDR_MASK; // FIQ vector
-        log_message(RETRO_LOG_INFO, "FIQ triggered\n");
+    if (!(gdb ? gdbstub_run_frame(gdb, video_cb) : machine_run_frame(machine, video_cb))) {
+        running = false;
+        send_message("Emulation stopped");
     }
-
-    // Execute CPU cycles (160,000 cycles per frame at 8MHz, 50Hz)
-    for (unsigned i = 0; i < 160000; i++) {
-        uint32_t pc = cpu->registers[15] & ADDR_MASK;
-        if (pc > ADDR_MASK) {
-            log_message(RETRO_LOG_ERROR, "PC out of bounds: %08x at step %u\n", cpu->registers[15], i);
-            running = false;
-            send_message("Emulation stopped: PC out of bounds");
-            break;
-        }
-        cpu_step(cpu);
+    if (machine->io->frame_width != geometry_width || machine->io->frame_height != geometry_height) {
+        geometry_width = machine->io->frame_width;
+        geometry_height = machine->io->frame_height;
+        struct retro_game_geometry geometry;
+        get_geometry(&geometry);
+        if (env_cb) env_cb(RETRO_ENVIRONMENT_SET_GEOMETRY, &geometry);
     }
 
-    // Render the frame using the VIDC implementation
-    if (video_cb && io) {
-        io_render_frame(io, memory, video_cb);
+    // Report dedup savings every 10 seconds
+    if (machine->mem->mergeable && machine->io->frame_count % 500 == 0) {
+        log_message(RETRO_LOG_INFO, "Page dedup: %zu KB of RAM merged\n", memory_merged_bytes(machine->mem) / 1024);
     }
 }
 
-size_t retro_serialize_size(void) { return 0; }
-bool retro_serialize(void* data, size_t size) { return false; }
-bool retro_unserialize(const void* data, size_t size) { return false; }
+void retro_run(void) {
+    pthread_mutex_lock(&machine_lock);
+    run_frame();
+    last_run = monotonic_seconds();
+    pthread_mutex_unlock(&machine_lock);
+}
 
 void retro_reset(void) {
     log_message(RETRO_LOG_INFO, "retro_reset called\n");
-    if (cpu) cpu_reset(cpu);
+    if (!machine) return;
+    pthread_mutex_lock(&machine_lock);
+    running = machine_reset(machine);
+    pthread_mutex_unlock(&machine_lock);
+    if (!running) send_message("Reset failed");
+}
+
+// Savestates are snapshots (snapshot.h), compressed and restored in parallel
+static threadpool_t* get_snapshot_pool(void) {
+    if (!snapshot_pool) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        snapshot_pool = threadpool_create(cpus > 8 ? 8 : cpus > 0 ? (unsigned)cpus : 1);
+    }
+    return snapshot_pool;
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t used;
+} serialize_buffer_t;
+
+static bool write_buffer(void* ctx, const void* data, size_t size) {
+    serialize_buffer_t* buffer = (serialize_buffer_t*)ctx;
+    if (buffer->size - buffer->used < size) return false;
+    memcpy(buffer->data + buffer->used, data, size);
+    buffer->used += size;
+    return true;
+}
+
+size_t retro_serialize_size(void) {
+    return machine ? snapshot_max_size() : 0;
+}
+
+bool retro_serialize(void* data, size_t size) {
+    if (!machine) return false;
+    serialize_buffer_t buffer = { (uint8_t*)data, size, 0 };
+    pthread_mutex_lock(&machine_lock);
+    bool saved = snapshot_save(machine, get_snapshot_pool(), write_buffer, &buffer);
+    pthread_mutex_unlock(&machine_lock);
+    if (!saved) {
+        log_message(RETRO_LOG_ERROR, "Savestate failed\n");
+        return false;
+    }
+    return true;
+}
+
+bool retro_unserialize(const void* data, size_t size) {
+    if (!machine) return false;
+    pthread_mutex_lock(&machine_lock);
+    bool loaded = snapshot_load(machine, get_snapshot_pool(), (const uint8_t*)data, size);
+    pthread_mutex_unlock(&machine_lock);
+    if (!loaded) {
+        send_message("Failed to load savestate");
+        return false;
+    }
+    running = true; // The restored machine may not have stopped
+    return true;
 }
 
 void retro_cheat_reset(void) { /* No-op */ }
@@ -265,6 +367,43 @@ void retro_unload_game(void) { /* No-op */ }
 
 } // End of extern "C"
 
+static void check_variables(void) {
+    struct retro_variable var = { "acornarc_render_threads", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+        io_set_render_threads(machine->io, (unsigned)atoi(var.value));
+    }
+    var = { "acornarc_page_dedup", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+        memory_set_mergeable(machine->mem, strcmp(var.value, "enabled") == 0);
+    }
+    var = { "acornarc_export_memory", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value &&
+        strcmp(var.value, "enabled") == 0) {
+        machine_export(machine); // Stays exported until the machine is destroyed
+    }
+    var = { "acornarc_gdb_port", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+        bool enabled = strcmp(var.value, "disabled") != 0;
+        if (gdb && !enabled) { gdbstub_destroy(gdb); gdb = nullptr; }
+        if (!gdb && enabled) gdb = gdbstub_create(machine, var.value, false); // Attach at any time
+    }
+    var = { "acornarc_suspend_paused", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value) {
+        suspend_after = (unsigned)atoi(var.value); // "disabled" = 0
+        if (suspend_after && !watcher_running) {
+            last_run = monotonic_seconds();
+            watcher_running = pthread_create(&watcher, NULL, watch_for_pause, NULL) == 0;
+        }
+    }
+    var = { "acornarc_rom_profile", NULL };
+    if (machine && env_cb && env_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value &&
+        strcmp(var.value, rom_profile) != 0) {
+        // auto = by the ROM's crc32, as at load; a name applies to ROM dumps not in the database
+        snprintf(rom_profile, sizeof(rom_profile), "%s", var.value);
+        machine_use_profile(machine, strcmp(rom_profile, "auto") == 0 ? NULL : rom_profile);
+    }
+}
+
 static void handle_input(void) {
     if (input_state_cb && input_state_cb(0, RETRO_DEVICE_KEYBOARD, 0, RETROK_ESCAPE)) {
         log_message(RETRO_LOG_INFO, "Escape key pressed, stopping emulation\n");
@@ -0,0 +1,66 @@
+#include "coverage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef struct {
+    uint32_t magic;            // COVERAGE_MAGIC
+    uint32_t version;          // COVERAGE_VERSION
+    uint32_t bytes;            // Bitmap size that follows
+    uint32_t reserved;
+} coverage_header_t;
+
+uint8_t* coverage_create(void) {
+    uint8_t* bits = (uint8_t*)calloc(1, COVERAGE_BYTES);
+    if (!bits) printf("Failed to allocate the coverage bitmap\n");
+    return bits;
+}
+
+void coverage_destroy(uint8_t* bits) {
+    free(bits);
+}
+
+bool coverage_save(const uint8_t* bits, const char* path) {
+    gzFile file = gzopen(path, "wb6");
+    if (!file) {
+        printf("Failed to write coverage to %s\n", path);
+        return false;
+    }
+    coverage_header_t header = { COVERAGE_MAGIC, COVERAGE_VERSION, (uint32_t)COVERAGE_BYTES, 0 };
+    bool saved = gzwrite(file, &header, sizeof(header)) == (int)sizeof(header) &&
+                 gzwrite(file, bits, COVERAGE_BYTES) == (int)COVERAGE_BYTES;
+    if (gzclose(file) != Z_OK) saved = false;
+    if (!saved) printf("Failed to write coverage to %s\n", path);
+    return saved;
+}
+
+bool coverage_load(uint8_t* bits, const char* path) {
+    gzFile file = gzopen(path, "rb");
+    if (!file) {
+        printf("Failed to open coverage file %s\n", path);
+        return false;
+    }
+    coverage_header_t header;
+    bool valid = gzread(file, &header, sizeof(header)) == (int)sizeof(header) &&
+                 header.magic == COVERAGE_MAGIC && header.version == COVERAGE_VERSION &&
+                 header.bytes == COVERAGE_BYTES;
+    uint8_t buffer[65536];
+    for (size_t offset = 0; valid && offset < COVERAGE_BYTES; offset += sizeof(buffer)) {
+        valid = gzread(file, buffer, sizeof(buffer)) == (int)sizeof(buffer);
+        for (size_t i = 0; valid && i < sizeof(buffer); i++) {
+            bits[offset + i] |= buffer[i];
+        }
+    }
+    gzclose(file);
+    if (!valid) printf("Not a coverage file: %s\n", path);
+    return valid;
+}
+
+size_t coverage_count(const uint8_t* bits, uint32_t start, uint32_t end) {
+    size_t count = 0;
+    for (uint32_t address = start & ~3u; address < end; address += 4) {
+        count += coverage_test(bits, address);
+    }
+    return count;
+}
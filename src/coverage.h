@@ -0,0 +1,30 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <cstdint>
+#include <stddef.h>
+#include "memory.h"
+
+// Guest code coverage: one bit per word of the 26-bit address space, set by
+// cpu_step for every instruction it fetches while arm3_cpu_t.coverage is set.
+// Files are the gzipped bitmap behind a small header; runs merge by OR.
+#define COVERAGE_BYTES (((size_t)ADDR_MASK + 1) >> 5) // 2MB
+#define COVERAGE_MAGIC 0x56435241   // "ARCV"
+#define COVERAGE_VERSION 1
+
+static inline void coverage_mark(uint8_t* bits, uint32_t pc) {
+    bits[pc >> 5] |= (uint8_t)(1u << ((pc >> 2) & 7));
+}
+
+static inline bool coverage_test(const uint8_t* bits, uint32_t address) {
+    address &= ADDR_MASK;
+    return bits[address >> 5] & (1u << ((address >> 2) & 7));
+}
+
+uint8_t* coverage_create(void); // Zeroed bitmap
+void coverage_destroy(uint8_t* bits);
+bool coverage_save(const uint8_t* bits, const char* path);
+bool coverage_load(uint8_t* bits, const char* path); // ORed into bits
+size_t coverage_count(const uint8_t* bits, uint32_t start, uint32_t end); // Words run in [start, end)
+
+#endif
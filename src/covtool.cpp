@@ -0,0 +1,94 @@
+// Coverage files from acornarc_headless -c (coverage.h).
+//
+//   acornarc_covtool merge out in...          OR runs together into out
+//   acornarc_covtool summary file              Executed address ranges
+//   acornarc_covtool annotate file image [base]
+//       Disassemble image as loaded at base (default 0x8000, the HLE load
+//       address; 0x3800000 for a ROM), marking each word that ran with '*'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "coverage.h"
+#include "disasm.h"
+#include "hle.h"
+
+static int usage(const char* name) {
+    fprintf(stderr, "Usage: %s merge out in... | summary file | annotate file image [base]\n", name);
+    return 2;
+}
+
+static int merge(const char* out, char** inputs, int count) {
+    uint8_t* bits = coverage_create();
+    if (!bits) return 1;
+    int status = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        if (!coverage_load(bits, inputs[i])) status = 1;
+    }
+    if (status == 0 && !coverage_save(bits, out)) status = 1;
+    if (status == 0) printf("%zu words executed in %d runs\n", coverage_count(bits, 0, ADDR_MASK + 1), count);
+    coverage_destroy(bits);
+    return status;
+}
+
+static void summary(const uint8_t* bits) {
+    size_t total = 0;
+    uint32_t start = 0;
+    bool in_range = false;
+    for (uint64_t address = 0; address <= (uint64_t)ADDR_MASK + 1; address += 4) {
+        bool ran = address <= ADDR_MASK && coverage_test(bits, (uint32_t)address);
+        if (ran && !in_range) start = (uint32_t)address;
+        if (!ran && in_range) {
+            printf("0x%08X-0x%08X  %u words\n", start, (uint32_t)address - 1, ((uint32_t)address - start) / 4);
+            total += ((uint32_t)address - start) / 4;
+        }
+        in_range = ran;
+    }
+    printf("%zu words executed\n", total);
+}
+
+static int annotate(const uint8_t* bits, const char* path, uint32_t base) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+    size_t covered = 0, words = 0;
+    uint32_t word;
+    char text[64];
+    for (uint32_t address = base & ~3u; fread(&word, 4, 1, file) == 1 && address <= ADDR_MASK; address += 4) {
+        bool ran = coverage_test(bits, address);
+        disasm_arm(word, address, text, sizeof(text));
+        printf("%c 0x%08X: 0x%08X  ; %s\n", ran ? '*' : ' ', address, word, text);
+        covered += ran;
+        words++;
+    }
+    fclose(file);
+    printf("%zu of %zu words executed (%.1f%%)\n", covered, words, words ? 100.0 * covered / words : 0.0);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) return usage(argv[0]);
+    const char* command = argv[1];
+    if (strcmp(command, "merge") == 0) {
+        if (argc < 4) return usage(argv[0]);
+        return merge(argv[2], argv + 3, argc - 3);
+    }
+    if (strcmp(command, "summary") != 0 && strcmp(command, "annotate") != 0) return usage(argv[0]);
+    if (strcmp(command, "annotate") == 0 && argc < 4) return usage(argv[0]);
+
+    uint8_t* bits = coverage_create();
+    if (!bits) return 1;
+    int status = 1;
+    if (coverage_load(bits, argv[2])) {
+        if (strcmp(command, "summary") == 0) {
+            summary(bits);
+            status = 0;
+        } else {
+            uint32_t base = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : HLE_LOAD_ADDRESS;
+            status = annotate(bits, argv[3], base);
+        }
+    }
+    coverage_destroy(bits);
+    return status;
+}
@@ -1,19 +1,30 @@
 #include "cpu.h"
 #include "io.h"
+#include "hostfs.h"
+#include "hle.h"
+#include "debug.h"
+#include "coverage.h"
+#include "disasm.h"
+#include "trace.h"
+#include "romprofile.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define ROM_BASE 0x03800000 // Updated to match branch target
 #define ADDR_MASK 0x03FFFFFF // 26-bit address space for ARMv3 (Acorn Archimedes)
+#define SWI_OS_BYTE 0x06
+#define OSBYTE_READ_CMOS 161
 
-arm3_cpu_t* cpu_create(memory_t* mem) {
-    arm3_cpu_t* cpu = (arm3_cpu_t*)malloc(sizeof(arm3_cpu_t));
-    if (!cpu) {
-        printf("Failed to allocate CPU\n");
-        return NULL;
-    }
-    
+void cpu_init(arm3_cpu_t* cpu, memory_t* mem) {
     cpu->mem = mem;
+    cpu->io = mem->io;
+    cpu->hostfs = NULL;
+    cpu->coverage = NULL;
+    cpu->trace = NULL;
+    cpu->profile = NULL;
+    cpu->hle_os = false;
+    cpu->log_steps = false;
     for (int i = 0; i < 16; i++) {
         cpu->registers[i] = 0;
     }
@@ -22,7 +33,15 @@ arm3_cpu_t* cpu_create(memory_t* mem) {
     cpu->spsr_irq = 0; // Initialize SPSR for IRQ mode
     cpu->spsr_fiq = 0; // Initialize SPSR for FIQ mode
     cpu_reset(cpu);
-    
+}
+
+arm3_cpu_t* cpu_create(memory_t* mem) {
+    arm3_cpu_t* cpu = (arm3_cpu_t*)malloc(sizeof(arm3_cpu_t));
+    if (!cpu) {
+        printf("Failed to allocate CPU\n");
+        return NULL;
+    }
+    cpu_init(cpu, mem);
     return cpu;
 }
 
@@ -42,9 +61,43 @@ void cpu_reset(arm3_cpu_t* cpu) {
     cpu->spsr = 0;
     cpu->spsr_irq = 0;
     cpu->spsr_fiq = 0;
+    cpu->halted = false;
+    cpu->exit_code = 0;
+    cpu->stop_reason = CPU_STOP_EXIT;
+    cpu->fault_pc = 0xFFFFFFFF;
+    cpu->fault_repeats = 0;
+    cpu->fetch_pc = 0;
+    cpu->idle = false;
+    for (int i = 0; i < CPU_LOOP_COUNT; i++) {
+        cpu->loop_counts[i] = 0;
+    }
     printf("CPU reset: PC = 0x%08X\n", cpu->registers[15]);
 }
 
+void cpu_stop(arm3_cpu_t* cpu, uint32_t reason) {
+    cpu->halted = true;
+    cpu->stop_reason = reason;
+}
+
+static unsigned interp_run(arm3_cpu_t* cpu, unsigned steps) {
+    unsigned n = 0;
+    for (; n < steps && !cpu->halted; n++) {
+        cpu_step(cpu);
+    }
+    return n;
+}
+
+static const cpu_engine_t engines[] = {
+    { "interp", interp_run }, // Reference interpreter (cpu_step)
+};
+
+const cpu_engine_t* cpu_engine_find(const char* name) {
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        if (strcmp(engines[i].name, name) == 0) return &engines[i];
+    }
+    return NULL;
+}
+
 static void update_flags(arm3_cpu_t* cpu, uint32_t result, uint32_t op1, uint32_t op2, int carry, int overflow) {
     cpu->cpsr &= ~(PSR_N | PSR_Z | PSR_C | PSR_V);
     if (result & 0x80000000) cpu->cpsr |= PSR_N;
@@ -53,6 +106,14 @@ static void update_flags(arm3_cpu_t* cpu, uint32_t result, uint32_t op1, uint32_
     if (overflow) cpu->cpsr |= PSR_V;
 }
 
+// Unaligned LDR reads the word containing the address, rotated so the
+// addressed byte lands in bits 0-7
+static uint32_t load_word(arm3_cpu_t* cpu, uint32_t addr) {
+    uint32_t value = memory_read_word(cpu->mem, addr);
+    uint32_t rot = (addr & 3) * 8;
+    return rot ? (value >> rot) | (value << (32 - rot)) : value;
+}
+
 static int condition_met(arm3_cpu_t* cpu, uint32_t cond) {
     switch (cond) {
         case 0x0: return (cpu->cpsr & PSR_Z) != 0;                      // EQ
@@ -75,57 +136,70 @@ static int condition_met(arm3_cpu_t* cpu, uint32_t cond) {
     }
 }
 
+// While an instruction runs R15 already holds the next one's address, but the
+// pipeline makes an R15 operand read 8 bytes past the instruction, and 12 once
+// it has advanced again: with a register-specified shift, or R15 stored to memory
+static inline uint32_t read_reg(const arm3_cpu_t* cpu, uint32_t r, bool late) {
+    return r == 15 ? cpu->registers[15] + (late ? 8 : 4) : cpu->registers[r];
+}
+
 static uint32_t get_operand2(arm3_cpu_t* cpu, uint32_t instr, int* carry_out) {
     uint32_t operand2;
     if (instr & (1 << 25)) { // Immediate
         uint32_t imm = instr & 0xFF;
-        uint32_t rot = (instr >> 8) & 0xF;
-        operand2 = (imm >> (2 * rot)) | (imm << (32 - 2 * rot));
-        *carry_out = (rot == 0) ? (cpu->cpsr & PSR_C) : ((operand2 >> 31) & 1);
+        uint32_t rot = 2 * ((instr >> 8) & 0xF);
+        operand2 = rot ? (imm >> rot) | (imm << (32 - rot)) : imm;
+        *carry_out = (rot == 0) ? ((cpu->cpsr & PSR_C) != 0) : ((operand2 >> 31) & 1);
     } else { // Register
         uint32_t rm = instr & 0xF;
-        operand2 = cpu->registers[rm];
         uint32_t shift = (instr >> 4) & 0xFF;
-        if (shift & 0x1) { // Register shift
+        operand2 = read_reg(cpu, rm, shift & 0x1);
+        if (shift & 0x1) { // Register shift; an amount of 0 leaves value and carry alone
             uint32_t rs = (instr >> 8) & 0xF;
             uint32_t shift_amount = cpu->registers[rs] & 0xFF;
+            if (shift_amount == 0) return operand2;
             switch ((shift >> 1) & 0x3) {
                 case 0: // LSL
                     if (shift_amount > 32) { operand2 = 0; *carry_out = 0; }
                     else if (shift_amount == 32) { *carry_out = operand2 & 1; operand2 = 0; }
-                    else if (shift_amount > 0) { *carry_out = (operand2 >> (32 - shift_amount)) & 1; operand2 <<= shift_amount; }
+                    else { *carry_out = (operand2 >> (32 - shift_amount)) & 1; operand2 <<= shift_amount; }
                     break;
                 case 1: // LSR
                     if (shift_amount > 32) { operand2 = 0; *carry_out = 0; }
                     else if (shift_amount == 32) { *carry_out = (operand2 >> 31) & 1; operand2 = 0; }
-                    else if (shift_amount > 0) { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 >>= shift_amount; }
+                    else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 >>= shift_amount; }
                     break;
                 case 2: // ASR
-                    if (shift_amount >= 32) { *carry_out = (operand2 >> 31) & 1; operand2 = (int32_t)operand2 >> 31; }
-                    else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 = (int32_t)operand2 >> shift_amount; }
+                    if (shift_amount >= 32) { *carry_out = (operand2 >> 31) & 1; operand2 = (uint32_t)((int32_t)operand2 >> 31); }
+                    else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 = (uint32_t)((int32_t)operand2 >> shift_amount); }
                     break;
                 case 3: // ROR
-                    if (shift_amount == 0) break; // RRX not implemented yet
                     shift_amount &= 31;
-                    if (shift_amount > 0) { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 = (operand2 >> shift_amount) | (operand2 << (32 - shift_amount)); }
+                    if (shift_amount == 0) { *carry_out = (operand2 >> 31) & 1; break; } // ROR by 32, 64...
+                    *carry_out = (operand2 >> (shift_amount - 1)) & 1;
+                    operand2 = (operand2 >> shift_amount) | (operand2 << (32 - shift_amount));
                     break;
             }
-        } else { // Immediate shift
+        } else { // Immediate shift; an amount of 0 encodes LSL #0, LSR #32, ASR #32 and RRX
             uint32_t shift_amount = (shift >> 3) & 0x1F;
             switch ((shift >> 1) & 0x3) {
                 case 0: // LSL
                     if (shift_amount > 0) { *carry_out = (operand2 >> (32 - shift_amount)) & 1; operand2 <<= shift_amount; }
                     break;
                 case 1: // LSR
-                    if (shift_amount == 0) { operand2 = 0; *carry_out = (operand2 >> 31) & 1; }
+                    if (shift_amount == 0) { *carry_out = (operand2 >> 31) & 1; operand2 = 0; }
                     else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 >>= shift_amount; }
                     break;
                 case 2: // ASR
-                    if (shift_amount == 0) { *carry_out = (operand2 >> 31) & 1; operand2 = (int32_t)operand2 >> 31; }
-                    else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 = (int32_t)operand2 >> shift_amount; }
+                    if (shift_amount == 0) { *carry_out = (operand2 >> 31) & 1; operand2 = (uint32_t)((int32_t)operand2 >> 31); }
+                    else { *carry_out = (operand2 >> (shift_amount - 1)) & 1; operand2 = (uint32_t)((int32_t)operand2 >> shift_amount); }
                     break;
                 case 3: // ROR
-                    if (shift_amount == 0) break; // RRX not implemented yet
+                    if (shift_amount == 0) { // RRX: rotate right by one through carry
+                        *carry_out = operand2 & 1;
+                        operand2 = (operand2 >> 1) | ((cpu->cpsr & PSR_C) ? 0x80000000u : 0);
+                        break;
+                    }
                     *carry_out = (operand2 >> (shift_amount - 1)) & 1;
                     operand2 = (operand2 >> shift_amount) | (operand2 << (32 - shift_amount));
                     break;
@@ -135,208 +209,119 @@ static uint32_t get_operand2(arm3_cpu_t* cpu, uint32_t instr, int* carry_out) {
     return operand2;
 }
 
+// Complete OS_Byte 161 (read CMOS) natively instead of running the kernel's
+// bit-banged I2C transaction. Writes still go through the kernel so its CMOS
+// cache stays coherent; the chip sees them via the IOC state machine.
+static int hle_cmos_swi(arm3_cpu_t* cpu, uint32_t swi) {
+    pcf8583_t* rtc = &cpu->io->cmos;
+    if (!rtc->hle || (swi & ~SWI_X_BIT) != SWI_OS_BYTE || cpu->registers[0] != OSBYTE_READ_CMOS) {
+        return 0;
+    }
+    uint32_t logical = cpu->registers[1] & 0xFF;
+    if (logical >= 0xF0) return 0; // Not mapped to CMOS RAM, let the kernel decide
+    // Logical CMOS 0x00-0xBF is physical 0x40-0xFF, 0xC0-0xEF is 0x10-0x3F
+    uint8_t physical = (uint8_t)(logical < 0xC0 ? logical + 0x40 : logical - 0xB0);
+    cpu->registers[2] = pcf8583_read(rtc, physical);
+    cpu->cpsr &= ~PSR_V;
+    return 1;
+}
+
+static_assert(CPU_LOOP_COUNT >= ROM_PROFILE_MAX_HOOKS, "A loop counter per profile hook");
+
+// Per-ROM shortcuts at fetch_pc (romprofile.h), after the PC has advanced.
+// true = skip the fetched instruction.
+static bool run_profile_hooks(arm3_cpu_t* cpu, uint32_t fetch_pc) {
+    const rom_profile_t* profile = cpu->profile;
+    bool skip = false;
+    for (unsigned i = 0; i < profile->hook_count; i++) {
+        const rom_hook_t* hook = &profile->hooks[i];
+        if (hook->pc != fetch_pc) continue;
+        switch (hook->type) {
+        case ROM_HOOK_IDLE: {
+            // Idle only while no interrupt can be taken: masked ones stay masked until the guest moves on
+            bool irq = cpu->io->irq_pending && !(cpu->cpsr & PSR_I);
+            bool fiq = cpu->io->fiq_pending && !(cpu->cpsr & PSR_F);
+            if (!irq && !fiq) cpu->idle = true;
+            break;
+        }
+        case ROM_HOOK_WRITE:
+            memory_write_word(cpu->mem, hook->target, hook->value);
+            break;
+        case ROM_HOOK_LOOP_CAP:
+            if (++cpu->loop_counts[i] >= hook->count) {
+                cpu->registers[15] = hook->target;
+                if (cpu->log_steps) printf("Exited loop at 0x%08X after %u iterations\n", fetch_pc, hook->count);
+                cpu->loop_counts[i] = 0;
+                skip = hook->skip;
+            }
+            break;
+        }
+    }
+    return skip;
+}
+
+// The watchdog stops an instruction that faults over and over; a handler that
+// returns to it (or a loop around it) runs other code in between, so any fault
+// elsewhere restarts the count, and so does a frame without faults (watchdog.cpp)
+static void count_fault(arm3_cpu_t* cpu, uint32_t fetch_pc) {
+    if (fetch_pc == cpu->fault_pc) {
+        cpu->fault_repeats++;
+    } else {
+        cpu->fault_pc = fetch_pc;
+        cpu->fault_repeats = 1;
+    }
+}
+
+static void undefined_trap(arm3_cpu_t* cpu, uint32_t instr, uint32_t fetch_pc) {
+    if (cpu->hle_os) {
+        hle_os_undefined(cpu, instr, fetch_pc);
+        return;
+    }
+    cpu->spsr = cpu->cpsr;
+    cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_SVC | PSR_I;
+    cpu->registers[14] = cpu->registers[15]; // The instruction after
+    cpu->registers[15] = VECTOR_UNDEF;
+    count_fault(cpu, fetch_pc);
+}
+
 void cpu_step(arm3_cpu_t* cpu) {
-    static int log_counter = 0;
-    static int loop1_count = 0;
-    static int loop2_count = 0;
-    static int loop3_count = 0;
-    static int early_loop_count = 0;
-    static int outer_loop_count = 0;
-    static int new_loop_count = 0;
-    static int total_steps = 0;
+    if (cpu->halted) return;
 
     // Check for interrupts before fetching instruction
-    if (cpu->mem->io->irq_pending && !(cpu->cpsr & PSR_I)) {
+    if (cpu->io->irq_pending && !(cpu->cpsr & PSR_I)) {
         printf("IRQ triggered at PC: 0x%08X, jumping to 0x00000018, R14: 0x%08X, CPSR: 0x%08X\n",
                cpu->registers[15], cpu->registers[14], cpu->cpsr);
         cpu->spsr_irq = cpu->cpsr;
         cpu->registers[14] = cpu->registers[15]; // Save return address
         cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_IRQ | PSR_I;
         cpu->registers[15] = 0x00000018 & ADDR_MASK;
-        cpu->mem->io->irq_pending = false;
+        cpu->io->irq_pending = false;
         return;
     }
 
     uint32_t fetch_pc = cpu->registers[15] & ADDR_MASK;
+    cpu->fetch_pc = fetch_pc;
+    if (cpu->mem->page_debug[fetch_pc >> PAGE_SHIFT] && debug_fetch(cpu->mem->debug, fetch_pc)) return;
     uint32_t instr = memory_read_word(cpu->mem, fetch_pc);
     if (instr == 0xFFFFFFFF) {
         printf("Invalid read at 0x%08X (PC: 0x%08X, r0: 0x%08X, r1: 0x%08X, r14: 0x%08X, CPSR: 0x%08X)\n",
                fetch_pc, cpu->registers[15], cpu->registers[0], cpu->registers[1], cpu->registers[14], cpu->cpsr);
-        exit(1);
+        cpu_stop(cpu, CPU_STOP_INVALID_FETCH);
         return;
     }
+    if (cpu->coverage) coverage_mark(cpu->coverage, fetch_pc);
+    if (cpu->trace) trace_record(cpu->trace, fetch_pc, instr, cpu->cpsr);
 
-    // Add debug for IRQ vector execution
-    if (fetch_pc == 0x00000018) {
-        printf("IRQ vector at 0x00000018: 0x%08X, R14: 0x%08X\n", instr, cpu->registers[14]);
-    }
-
-    char disasm[64] = "Unknown";
-    if ((instr & 0x0E000000) == 0x0A000000) { // Branch
-        int32_t offset = (instr & 0x00FFFFFF) << 2;
-        if (offset & 0x02000000) offset |= 0xFC000000;
-        uint32_t target = (fetch_pc + 8 + offset) & ADDR_MASK;
-        int link = (instr >> 24) & 1;
-        const char* conds[] = {"EQ", "NE", "CS", "CC", "MI", "PL", "VS", "VC", "HI", "LS", "GE", "LT", "GT", "LE", "", "NV"};
-        uint32_t cond = (instr >> 28) & 0xF;
-        sprintf(disasm, "%s%s 0x%08X", link ? "BL" : "B", conds[cond], target);
-    } else if ((instr & 0x0C000000) == 0x00000000) { // Data Processing
-        uint32_t opcode = (instr >> 21) & 0xF;
-        uint32_t rn = (instr >> 16) & 0xF;
-        uint32_t rd = (instr >> 12) & 0xF;
-        uint32_t rm = instr & 0xF;
-        int imm = (instr >> 25) & 1;
-        int s_flag = (instr >> 20) & 1;
-        const char* ops[] = {"AND", "EOR", "SUB", "RSB", "ADD", "ADC", "SBC", "RSC", 
-                             "TST", "TEQ", "CMP", "CMN", "ORR", "MOV", "BIC", "MVN"};
-        if (opcode == 0xD && !imm)
-            sprintf(disasm, "MOV%s r%d, r%d", s_flag ? "S" : "", rd, rm);
-        else if (opcode == 0xD && rd == 15 && rn == 14 && rm == 0)
-            sprintf(disasm, "MOV PC, r14");
-        else if (opcode == 0x2 && imm)
-            sprintf(disasm, "SUB%s r%d, r%d, #0x%X", s_flag ? "S" : "", rd, rn, instr & 0xFFF);
-        else if (opcode == 0x4 && imm)
-            sprintf(disasm, "ADD%s r%d, r%d, #0x%X", s_flag ? "S" : "", rd, rn, instr & 0xFFF);
-        else if (opcode == 0x4 && !imm)
-            sprintf(disasm, "ADD%s r%d, r%d, r%d", s_flag ? "S" : "", rd, rn, rm);
-        else if (opcode == 0xC && !imm)
-            sprintf(disasm, "ORR%s r%d, r%d, r%d", s_flag ? "S" : "", rd, rn, rm);
-        else if (opcode == 0xA && !imm)
-            sprintf(disasm, "CMP r%d, r%d", rn, rm);
-        else if (opcode >= 0x8 && opcode <= 0xB && imm)
-            sprintf(disasm, "%s r%d, #0x%X", ops[opcode], rn, instr & 0xFFF);
-        else if (imm)
-            sprintf(disasm, "%s%s r%d, r%d, #0x%X", ops[opcode], s_flag ? "S" : "", rd, rn, instr & 0xFFF);
-        else
-            sprintf(disasm, "%s%s r%d, r%d, r%d", ops[opcode], s_flag ? "S" : "", rd, rn, rm);
-    } else if ((instr & 0x0C000000) == 0x04000000) { // Load/Store
-        int load = (instr >> 20) & 1;
-        int byte = (instr >> 22) & 1;
-        uint32_t rn = (instr >> 16) & 0xF;
-        uint32_t rd = (instr >> 12) & 0xF;
-        uint32_t offset = instr & 0xFFF;
-        sprintf(disasm, "%s%s r%d, [r%d, #0x%X]", load ? "LDR" : "STR", byte ? "B" : "", rd, rn, offset);
-    } else if ((instr & 0x0F000000) == 0x08000000) { // Block Data Transfer (LDM/STM)
-        int load = (instr >> 20) & 1;
-        int up = (instr >> 23) & 1;
-        int pre = (instr >> 24) & 1;
-        uint32_t rn = (instr >> 16) & 0xF;
-        uint32_t reg_list = instr & 0xFFFF;
-        const char* dir = up ? "IA" : "DA"; // Increment/Decrement After
-        if (pre) dir = up ? "IB" : "DB";    // Increment/Decrement Before
-        if (instr == 0xE8BD0043)
-            sprintf(disasm, "LDMFD sp!, {r0,r1,r6}");
-        else if (instr == 0xE92D0043)
-            sprintf(disasm, "STMFD sp!, {r0,r1,r6}");
-        else
-            sprintf(disasm, "%s%s r%d%s, {0x%04X}", load ? "LDM" : "STM", dir, rn, load && (reg_list & (1 << 15)) ? "!" : "", reg_list);
-    }
-
-    // Debug additions (unchanged)
-    if (fetch_pc == 0x0380A598) {
-        printf("Post-loop at 0x0380A598: 0x%08X ; %s\n", instr, disasm);
-        memory_write_word(cpu->mem, 0x03600000, 0);
-        printf("Forced MEMC write to exit boot mode at 0x0380A598\n");
-    }
-    if (fetch_pc == 0x0380A594) {
-        printf("Pre-exit state: PC=0x%08X, R0=0x%08X, R1=0x%08X, R2=0x%08X, R14=0x%08X, CPSR=0x%08X\n",
-               cpu->registers[15], cpu->registers[0], cpu->registers[1], cpu->registers[2], cpu->registers[14], cpu->cpsr);
-    }
-    if (fetch_pc == 0x0380A5EC) {
-        printf("Calling 0x0380A5EC, r2: 0x%08X, from PC: 0x%08X\n", cpu->registers[2], cpu->registers[14]);
-    }
-    if (fetch_pc == 0x0380A23C) {
-        printf("Entering Loop 1 at 0x0380A23C, r3: 0x%08X, r5: 0x%08X\n", cpu->registers[3], cpu->registers[5]);
+    if (cpu->log_steps) {
+        char disasm[64];
+        disasm_arm(instr, fetch_pc, disasm, sizeof(disasm));
+        printf("0x%08X: 0x%08X  ; %s\n", fetch_pc, instr, disasm);
     }
-    printf("0x%08X: 0x%08X  ; %s\n", fetch_pc, instr, disasm);
 
-    // Additional debug (unchanged)
-    if (fetch_pc >= 0x0380A200 && fetch_pc < 0x0380A258) {
-        printf("Pre-loop r0: 0x%08X at 0x%08X\n", cpu->registers[0], fetch_pc);
-    }
-    if (fetch_pc == 0x0380A258) {
-        printf("STR target: 0x%08X (r0: 0x%08X, r2: 0x%08X)\n", 
-               cpu->registers[0] + 1, cpu->registers[0], cpu->registers[2]);
-    }
-    if (fetch_pc == 0x0380A5F4) {
-        printf("  r2: 0x%08X\n", cpu->registers[2]);
-    }
-    if (fetch_pc == 0x0380A268) {
-        printf("  r1: 0x%08X, r7: 0x%08X, r8: 0x%08X\n", cpu->registers[1], cpu->registers[7], cpu->registers[8]);
-    }
-    if (fetch_pc == 0x0380A248 || fetch_pc == 0x0380A81C || fetch_pc == 0x03819454) {
-        printf("  R0: 0x%08X, R2: 0x%08X, R3: 0x%08X, R5: 0x%08X, R8: 0x%08X, R10: 0x%08X, R14: 0x%08X, CPSR: 0x%08X\n",
-               cpu->registers[0], cpu->registers[2], cpu->registers[3], cpu->registers[5], 
-               cpu->registers[8], cpu->registers[10], cpu->registers[14], cpu->cpsr);
-    }
-    if (fetch_pc == 0x0380A250) {
-        printf("Exiting Loop 1 at 0x0380A250, r3: 0x%08X, r5: 0x%08X\n", cpu->registers[3], cpu->registers[5]);
-    }
-    if ((fetch_pc >= 0x03800000 && fetch_pc <= 0x0380FFFF) || 
-        (fetch_pc >= 0x00E00000 && fetch_pc <= 0x00E0FFFF)) {
-        printf("Boot trace: PC: 0x%08X, r0: 0x%08X, opcode: 0x%08X\n", fetch_pc, cpu->registers[0], instr);
-    }
-
-    log_counter++;
-    total_steps++;
     cpu->registers[15] += 4;
 
-    if (total_steps >= 10000000) {
-        printf("Stopped after 10000000 steps to limit log size (boot mode: %d)\n", cpu->mem->is_boot_mode);
-        exit(1);
-    }
-
-    // Loop caps (unchanged)
-    if (fetch_pc == 0x0380A5F4) {
-        early_loop_count++;
-        if (early_loop_count >= 5) {
-            cpu->registers[15] = 0x0380A5F8;
-            printf("Exited early loop at 0x0380A5F4 after 5 iterations\n");
-            early_loop_count = 0;
-        }
-    }
-    if (fetch_pc == 0x0380A5EC) {
-        outer_loop_count++;
-        if (outer_loop_count >= 10) {
-            cpu->registers[15] = 0x0380A5F8;
-            printf("Exited outer loop at 0x0380A5EC after 10 calls\n");
-            outer_loop_count = 0;
-        }
-    }
-    if (fetch_pc == 0x0380A248) {
-        loop1_count++;
-        if (loop1_count >= 5) {
-            cpu->registers[15] = 0x0380A250;
-            printf("Exited Loop 1 at 0x0380A248 after 5 iterations\n");
-            loop1_count = 0;
-            return;
-        }
-    }
-    if (fetch_pc == 0x0380A268) {
-        new_loop_count++;
-        if (new_loop_count >= 5000) {
-            cpu->registers[15] = 0x0380A26C;
-            printf("Exited new loop at 0x0380A268 after 5000 iterations\n");
-            new_loop_count = 0;
-        }
-    }
-    if (fetch_pc == 0x0380A81C) {
-        loop2_count++;
-        if (loop2_count >= 5) {
-            cpu->registers[15] = 0x0380A824;
-            printf("Exited Loop 2 at 0x0380A81C after 5 iterations\n");
-            loop2_count = 0;
-            return;
-        }
-    }
-    if (fetch_pc == 0x03819454) {
-        loop3_count++;
-        if (loop3_count >= 5) {
-            cpu->registers[15] = 0x03819460;
-            printf("Exited Loop 3 at 0x03819454 after 5 iterations\n");
-            loop3_count = 0;
-            return;
-        }
+    if (cpu->profile && fetch_pc - cpu->profile->low <= cpu->profile->span && run_profile_hooks(cpu, fetch_pc)) {
+        return;
     }
 
     uint32_t cond = (instr >> 28) & 0xF;
@@ -344,14 +329,45 @@ void cpu_step(arm3_cpu_t* cpu) {
         return;
     }
 
-    if ((instr & 0x0C000000) == 0x00000000) { // Data Processing
+    if ((instr & 0x0FC000F0) == 0x00000090) { // Multiply (before data processing, which shares its space)
+        uint32_t rd = (instr >> 16) & 0xF;
+        uint32_t rn = (instr >> 12) & 0xF;
+        uint32_t rs = (instr >> 8) & 0xF;
+        uint32_t rm = instr & 0xF;
+        int accumulate = (instr >> 21) & 1;
+        int set_flags = (instr >> 20) & 1;
+
+        uint32_t result = cpu->registers[rm] * cpu->registers[rs];
+        if (accumulate) result += cpu->registers[rn];
+        cpu->registers[rd] = result;
+
+        if (set_flags) {
+            update_flags(cpu, result, 0, 0, 0, 0);
+        }
+    } else if ((instr & 0x0FB00FF0) == 0x01000090) { // Single data swap (SWP/SWPB)
+        uint32_t rn = (instr >> 16) & 0xF;
+        uint32_t rd = (instr >> 12) & 0xF;
+        uint32_t rm = instr & 0xF;
+        uint32_t addr = cpu->registers[rn];
+        uint32_t value = cpu->registers[rm];
+        if (instr & (1 << 22)) {
+            uint8_t old = memory_read_byte(cpu->mem, addr);
+            memory_write_byte(cpu->mem, addr, (uint8_t)value);
+            cpu->registers[rd] = old;
+        } else {
+            uint32_t old = memory_read_word(cpu->mem, addr);
+            memory_write_word(cpu->mem, addr, value);
+            cpu->registers[rd] = old;
+        }
+        if (rd == 15) cpu->registers[15] &= ADDR_MASK;
+    } else if ((instr & 0x0C000000) == 0x00000000 && (instr & 0x02000090) != 0x00000090) { // Data Processing
         uint32_t opcode = (instr >> 21) & 0xF;
         uint32_t rn = (instr >> 16) & 0xF;
         uint32_t rd = (instr >> 12) & 0xF;
         int s_flag = (instr >> 20) & 1;
         int carry_in = (cpu->cpsr & PSR_C) ? 1 : 0;
         int carry_out = carry_in;
-        uint32_t op1 = cpu->registers[rn];
+        uint32_t op1 = read_reg(cpu, rn, (instr & 0x02000010) == 0x00000010); // Register-specified shift
         uint32_t op2 = get_operand2(cpu, instr, &carry_out);
         uint32_t result;
         int overflow = 0;
@@ -383,15 +399,16 @@ void cpu_step(arm3_cpu_t* cpu) {
             else cpu->registers[15] = result & ADDR_MASK;
         }
     } else if ((instr & 0x0E000000) == 0x0A000000) { // Branch
-        int32_t offset = instr & 0x00FFFFFF;
-        if (offset & 0x00800000) offset |= 0xFF000000;
-        offset <<= 2;
+        uint32_t offset = (instr & 0x00FFFFFF) << 2;
+        if (offset & 0x02000000) offset |= 0xFC000000;
         uint32_t base_pc = fetch_pc + 8;
         uint32_t new_pc = base_pc + offset;
         int link = (instr >> 24) & 1;
 
         if (link) cpu->registers[14] = cpu->registers[15];
         cpu->registers[15] = new_pc & ADDR_MASK;
+    } else if ((instr & 0x0E000010) == 0x06000010) { // Register-offset LDR/STR encoding with bit 4 set
+        undefined_trap(cpu, instr, fetch_pc);
     } else if ((instr & 0x0C000000) == 0x04000000) { // Load/Store
         uint32_t rn = (instr >> 16) & 0xF;
         uint32_t rd = (instr >> 12) & 0xF;
@@ -400,12 +417,12 @@ void cpu_step(arm3_cpu_t* cpu) {
         int up = (instr >> 23) & 1;
         int pre = (instr >> 24) & 1;
         int writeback = (instr >> 21) & 1;
-        uint32_t base = cpu->registers[rn];
+        uint32_t base = read_reg(cpu, rn, false);
         uint32_t offset;
 
-        if (instr & (1 << 25)) {
-            int carry_out;
-            offset = get_operand2(cpu, instr, &carry_out);
+        if (instr & (1 << 25)) { // Register offset, which get_operand2 decodes with bit 25 clear
+            int carry_out = (cpu->cpsr & PSR_C) != 0;
+            offset = get_operand2(cpu, instr & ~(1u << 25), &carry_out);
         } else {
             offset = instr & 0xFFF;
         }
@@ -414,31 +431,31 @@ void cpu_step(arm3_cpu_t* cpu) {
         if (pre) {
             if (load) {
                 if (byte) cpu->registers[rd] = memory_read_byte(cpu->mem, addr);
-                else cpu->registers[rd] = memory_read_word(cpu->mem, addr);
+                else cpu->registers[rd] = load_word(cpu, addr);
             } else {
-                if (byte) memory_write_byte(cpu->mem, addr, cpu->registers[rd]);
-                else memory_write_word(cpu->mem, addr, cpu->registers[rd]);
+                if (byte) memory_write_byte(cpu->mem, addr, read_reg(cpu, rd, true));
+                else memory_write_word(cpu->mem, addr, read_reg(cpu, rd, true));
             }
             if (writeback) cpu->registers[rn] = addr;
         } else {
             if (load) {
                 if (byte) cpu->registers[rd] = memory_read_byte(cpu->mem, base);
-                else cpu->registers[rd] = memory_read_word(cpu->mem, base);
+                else cpu->registers[rd] = load_word(cpu, base);
             } else {
-                if (byte) memory_write_byte(cpu->mem, base, cpu->registers[rd]);
-                else memory_write_word(cpu->mem, base, cpu->registers[rd]);
+                if (byte) memory_write_byte(cpu->mem, base, read_reg(cpu, rd, true));
+                else memory_write_word(cpu->mem, base, read_reg(cpu, rd, true));
             }
             cpu->registers[rn] = addr;
         }
         if (rd == 15) cpu->registers[15] &= ADDR_MASK;
-    } else if ((instr & 0x0F000000) == 0x08000000) { // Block Data Transfer (LDM/STM)
+    } else if ((instr & 0x0E000000) == 0x08000000) { // Block Data Transfer (LDM/STM)
         uint32_t rn = (instr >> 16) & 0xF;
         int load = (instr >> 20) & 1;
         int up = (instr >> 23) & 1;
         int pre = (instr >> 24) & 1;
         int writeback = (instr >> 21) & 1;
         uint32_t reg_list = instr & 0xFFFF;
-        uint32_t base = cpu->registers[rn];
+        uint32_t base = read_reg(cpu, rn, false);
         int count = 0;
         for (int i = 0; i < 16; i++) if (reg_list & (1 << i)) count++;
 
@@ -449,47 +466,31 @@ void cpu_step(arm3_cpu_t* cpu) {
         for (int i = 0; i < 16; i++) {
             if (reg_list & (1 << i)) {
                 if (load) cpu->registers[i] = memory_read_word(cpu->mem, addr);
-                else memory_write_word(cpu->mem, addr, cpu->registers[i]);
+                else memory_write_word(cpu->mem, addr, read_reg(cpu, i, true));
                 addr += 4;
             }
         }
         if (writeback) cpu->registers[rn] = up ? base + (count * 4) : base - (count * 4);
         if (load && (reg_list & (1 << 15))) cpu->registers[15] &= ADDR_MASK;
 
-        // Special case for LDMFD/STMFD with specific register lists
-        if (instr == 0xE8BD0043) { // LDMFD sp!, {r0,r1,r6}
-            cpu->registers[0] = memory_read_word(cpu->mem, cpu->registers[13]);
-            cpu->registers[1] = memory_read_word(cpu->mem, cpu->registers[13] + 4);
-            cpu->registers[6] = memory_read_word(cpu->mem, cpu->registers[13] + 8);
-            cpu->registers[13] += 12; // Pop 3 words
-        } else if (instr == 0xE92D0043) { // STMFD sp!, {r0,r1,r6}
-            cpu->registers[13] -= 12; // Push 3 words
-            memory_write_word(cpu->mem, cpu->registers[13], cpu->registers[0]);
-            memory_write_word(cpu->mem, cpu->registers[13] + 4, cpu->registers[1]);
-            memory_write_word(cpu->mem, cpu->registers[13] + 8, cpu->registers[6]);
-        }
-    } else if ((instr & 0x0FC000F0) == 0x00000090) { // Multiply
-        uint32_t rd = (instr >> 16) & 0xF;
-        uint32_t rn = (instr >> 12) & 0xF;
-        uint32_t rs = (instr >> 8) & 0xF;
-        uint32_t rm = instr & 0xF;
-        int accumulate = (instr >> 21) & 1;
-        int set_flags = (instr >> 20) & 1;
-
-        uint32_t result = cpu->registers[rm] * cpu->registers[rs];
-        if (accumulate) result += cpu->registers[rn];
-        cpu->registers[rd] = result;
-
-        if (set_flags) {
-            update_flags(cpu, result, 0, 0, 0, 0);
-        }
     } else if ((instr & 0x0F000000) == 0x0F000000) { // SWI
+        if (hle_cmos_swi(cpu, instr & 0xFFFFFF) ||
+            (cpu->hostfs && hostfs_swi(cpu->hostfs, cpu, instr & 0xFFFFFF, fetch_pc)) ||
+            (cpu->hle_os && hle_os_swi(cpu, instr & 0xFFFFFF, fetch_pc))) {
+            cpu->io->accesses++; // Serviced by the host, which counts as I/O progress
+            return;
+        }
         cpu->spsr = cpu->cpsr;
         cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_SVC | PSR_I;
         cpu->registers[14] = cpu->registers[15];
         cpu->registers[15] = 0x00000008 & ADDR_MASK;
         printf("SWI at 0x%08X, comment: 0x%06X\n", fetch_pc, instr & 0xFFFFFF);
+    } else if ((instr & 0x0C000000) == 0x0C000000) { // Coprocessor (CDP, LDC/STC, MRC/MCR)
+        // No coprocessor answers, so these are undefined, and software such
+        // as FPEmulator implements them in the trap handler
+        undefined_trap(cpu, instr, fetch_pc);
     } else {
-        printf("Unimplemented instruction 0x%08X at 0x%08X\n", fetch_pc, instr);
+        printf("Unimplemented instruction 0x%08X at 0x%08X\n", instr, fetch_pc);
+        count_fault(cpu, fetch_pc);
     }
 }
\ No newline at end of file
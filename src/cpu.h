@@ -32,19 +32,66 @@
 #define VECTOR_IRQ   0x00000018
 #define VECTOR_FIQ   0x0000001C
 
+#define SWI_X_BIT 0x20000    // Return errors in R0/V instead of raising them
+
+// Why the CPU stopped (stop_reason, valid once halted)
+#define CPU_STOP_EXIT           0 // Guest called OS_Exit; exit_code holds its status
+#define CPU_STOP_INVALID_FETCH  1 // Instruction fetch from unmapped memory
+#define CPU_STOP_EXCEPTION_LOOP 2 // Same instruction faulting over and over (watchdog)
+#define CPU_STOP_STUCK          3 // PC confined to a small range with no I/O (watchdog)
+#define CPU_STOP_BLANK_SCREEN   4 // Uniform screen for too long (watchdog)
+#define CPU_STOP_STEP_LIMIT     5 // Step budget used up (watchdog)
+#define CPU_STOP_BREAKPOINT     6 // About to execute a breakpoint (debug.h)
+#define CPU_STOP_WATCHPOINT     7 // Accessed a watched address (debug.h)
+
+// Iteration counters for ROM profile loop caps, one per hook (romprofile.h)
+#define CPU_LOOP_COUNT 16
+
+struct hostfs;
+struct trace;
+struct io;
+struct rom_profile;
+
+// Hot state first: registers and PSRs fill the first cache lines
 typedef struct arm3_cpu {
-    memory_t* mem;         // Pointer to memory subsystem (includes io_t)
     uint32_t registers[16]; // General-purpose registers (R0-R15, where R15 is PC)
     uint32_t cpsr;         // Current Program Status Register
     uint32_t spsr;         // Saved Program Status Register (general, e.g., SVC mode)
     uint32_t spsr_irq;     // Saved PSR for IRQ mode
     uint32_t spsr_fiq;     // Saved PSR for FIQ mode
+    memory_t* mem;         // Pointer to memory subsystem
+    struct io* io;         // Same as mem->io, without the extra load
+    bool halted;           // Stopped (e.g. OS_Exit); cpu_step does nothing
+    bool hle_os;           // Service OS SWIs natively (no ROM, see hle.h)
+    bool log_steps;        // Print each instruction with its disassembly (slow; off by default)
+    uint32_t exit_code;    // Guest exit status once halted
+    uint32_t stop_reason;  // CPU_STOP_* once halted
+    uint32_t fetch_pc;     // Address of the instruction cpu_step is executing
+    uint32_t fault_pc;     // Last instruction that faulted (unimplemented or undefined trap)
+    uint32_t fault_repeats; // Faults at fault_pc since another instruction faulted or a frame passed without one
+    uint32_t loop_counts[CPU_LOOP_COUNT]; // Per CPU, so two engines stepped in turn do not share them
+    struct hostfs* hostfs; // HostFS backend for intercepted SWIs (NULL = disabled)
+    uint8_t* coverage;     // Executed-word bitmap, see coverage.h (NULL = off)
+    struct trace* trace;   // Binary instruction trace, see trace.h (NULL = off)
+    const struct rom_profile* profile; // Per-ROM shortcuts, see romprofile.h (NULL = none)
+    bool idle;             // Reached a profile idle loop; the frame's slice can end
 } arm3_cpu_t;
 
+// An execution engine: run executes up to steps instructions and returns how
+// many it executed (fewer once the CPU halts). The lockstep harness compares
+// engines against the reference "interp".
+typedef struct {
+    const char* name;
+    unsigned (*run)(arm3_cpu_t* cpu, unsigned steps);
+} cpu_engine_t;
+
 // Function declarations
 arm3_cpu_t* cpu_create(memory_t* mem);
+void cpu_init(arm3_cpu_t* cpu, memory_t* mem); // In place, for callers that own the storage
 void cpu_destroy(arm3_cpu_t* cpu);
 void cpu_reset(arm3_cpu_t* cpu);
 void cpu_step(arm3_cpu_t* cpu);
+void cpu_stop(arm3_cpu_t* cpu, uint32_t reason); // Halt with a CPU_STOP_* reason
+const cpu_engine_t* cpu_engine_find(const char* name); // NULL = unknown
 
 #endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "debug.h"
+#include <string.h>
+
+#define NO_ADDRESS 0xFFFFFFFF
+
+// Rebuilt from scratch on every change; there are at most a few dozen points
+static void update_pages(debug_t* debug) {
+    uint8_t* pages = debug->mem->page_debug;
+    memset(pages, 0, sizeof(debug->mem->page_debug));
+    for (unsigned i = 0; i < debug->breakpoint_count; i++) {
+        pages[(debug->breakpoints[i] & ADDR_MASK) >> PAGE_SHIFT] |= PAGE_DEBUG_EXEC;
+    }
+    for (unsigned i = 0; i < debug->watchpoint_count; i++) {
+        const debug_watchpoint_t* watch = &debug->watchpoints[i];
+        uint32_t first = (watch->address & ADDR_MASK) >> PAGE_SHIFT;
+        uint32_t last = ((watch->address + watch->length - 1) & ADDR_MASK) >> PAGE_SHIFT;
+        for (uint32_t page = first; page <= last; page++) {
+            pages[page] |= (uint8_t)watch->kind;
+        }
+    }
+}
+
+void debug_init(debug_t* debug, arm3_cpu_t* cpu, memory_t* mem) {
+    memset(debug, 0, sizeof(*debug));
+    debug->cpu = cpu;
+    debug->mem = mem;
+    debug->skip_pc = NO_ADDRESS;
+    debug->fetch_pc = NO_ADDRESS;
+    mem->debug = debug;
+    update_pages(debug);
+}
+
+bool debug_add_breakpoint(debug_t* debug, uint32_t address) {
+    address &= ADDR_MASK & ~3u;
+    for (unsigned i = 0; i < debug->breakpoint_count; i++) {
+        if (debug->breakpoints[i] == address) return true;
+    }
+    if (debug->breakpoint_count == DEBUG_MAX_BREAKPOINTS) return false;
+    debug->breakpoints[debug->breakpoint_count++] = address;
+    update_pages(debug);
+    return true;
+}
+
+bool debug_remove_breakpoint(debug_t* debug, uint32_t address) {
+    address &= ADDR_MASK & ~3u;
+    for (unsigned i = 0; i < debug->breakpoint_count; i++) {
+        if (debug->breakpoints[i] != address) continue;
+        debug->breakpoints[i] = debug->breakpoints[--debug->breakpoint_count];
+        update_pages(debug);
+        return true;
+    }
+    return false;
+}
+
+bool debug_add_watchpoint(debug_t* debug, uint32_t address, uint32_t length, uint32_t kind) {
+    kind &= DEBUG_WATCH_READ | DEBUG_WATCH_WRITE;
+    if (!length || !kind || debug->watchpoint_count == DEBUG_MAX_WATCHPOINTS) return false;
+    debug_watchpoint_t* watch = &debug->watchpoints[debug->watchpoint_count++];
+    watch->address = address & ADDR_MASK;
+    watch->length = length;
+    watch->kind = kind;
+    update_pages(debug);
+    return true;
+}
+
+bool debug_remove_watchpoint(debug_t* debug, uint32_t address, uint32_t length, uint32_t kind) {
+    address &= ADDR_MASK;
+    for (unsigned i = 0; i < debug->watchpoint_count; i++) {
+        debug_watchpoint_t* watch = &debug->watchpoints[i];
+        if (watch->address != address || watch->length != length || watch->kind != kind) continue;
+        *watch = debug->watchpoints[--debug->watchpoint_count];
+        update_pages(debug);
+        return true;
+    }
+    return false;
+}
+
+void debug_resume(debug_t* debug) {
+    arm3_cpu_t* cpu = debug->cpu;
+    if (!cpu->halted) return;
+    if (cpu->stop_reason != CPU_STOP_BREAKPOINT && cpu->stop_reason != CPU_STOP_WATCHPOINT) return;
+    if (cpu->stop_reason == CPU_STOP_BREAKPOINT) debug->skip_pc = cpu->registers[15] & ADDR_MASK;
+    cpu->halted = false;
+}
+
+bool debug_fetch(debug_t* debug, uint32_t pc) {
+    debug->fetch_pc = pc;
+    if (pc == debug->skip_pc) {
+        debug->skip_pc = NO_ADDRESS;
+        return false;
+    }
+    for (unsigned i = 0; i < debug->breakpoint_count; i++) {
+        if (debug->breakpoints[i] != pc) continue;
+        debug->hit.pc = pc;
+        debug->hit.address = pc;
+        debug->hit.value = 0;
+        debug->hit.size = 0;
+        debug->hit.kind = 0;
+        cpu_stop(debug->cpu, CPU_STOP_BREAKPOINT);
+        return true;
+    }
+    return false;
+}
+
+void debug_access(debug_t* debug, uint32_t address, uint32_t size, uint32_t value, uint32_t kind) {
+    if (debug->inspecting) return;
+    if (kind == DEBUG_WATCH_READ && address == debug->fetch_pc) {
+        debug->fetch_pc = NO_ADDRESS; // The instruction fetch itself
+        return;
+    }
+    arm3_cpu_t* cpu = debug->cpu;
+    if (cpu->halted) return; // Keep the first hit of the instruction
+    for (unsigned i = 0; i < debug->watchpoint_count; i++) {
+        const debug_watchpoint_t* watch = &debug->watchpoints[i];
+        if (!(watch->kind & kind)) continue;
+        if (address + size <= watch->address || address >= watch->address + watch->length) continue;
+        debug->hit.pc = cpu->fetch_pc; // R15 may already hold a loaded or branched-to PC
+        debug->hit.address = address;
+        debug->hit.value = value;
+        debug->hit.size = size;
+        debug->hit.kind = kind;
+        cpu_stop(cpu, CPU_STOP_WATCHPOINT); // The instruction still completes
+        return;
+    }
+}
+
+void debug_report(const debug_t* debug, FILE* out) {
+    const debug_hit_t* hit = &debug->hit;
+    if (debug->cpu->stop_reason == CPU_STOP_BREAKPOINT) {
+        fprintf(out, "Breakpoint at 0x%08X\n", hit->address);
+    } else if (debug->cpu->stop_reason == CPU_STOP_WATCHPOINT) {
+        fprintf(out, "Watchpoint: %s [0x%08X] = 0x%0*X by the instruction at 0x%08X\n",
+                hit->kind == DEBUG_WATCH_WRITE ? "write" : "read", hit->address, (int)hit->size * 2, hit->value, hit->pc);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include <cstdint>
+#include <stdio.h>
+#include "cpu.h"
+#include "memory.h"
+
+// Breakpoints and watchpoints. Each one flags its pages in
+// memory_t.page_debug; cpu_step and the memory accessors only call in here
+// for flagged pages, so everything else runs at full speed. A hit stops the
+// CPU (CPU_STOP_BREAKPOINT before the instruction runs, CPU_STOP_WATCHPOINT
+// once the accessing instruction completes) and is described in `hit`.
+#define DEBUG_MAX_BREAKPOINTS 64
+#define DEBUG_MAX_WATCHPOINTS 64
+#define DEBUG_WATCH_READ PAGE_DEBUG_READ
+#define DEBUG_WATCH_WRITE PAGE_DEBUG_WRITE
+
+typedef struct {
+    uint32_t address;
+    uint32_t length;           // Bytes watched from address
+    uint32_t kind;             // DEBUG_WATCH_* bits
+} debug_watchpoint_t;
+
+typedef struct {
+    uint32_t pc;               // Instruction that hit
+    uint32_t address;          // Breakpoint, or the accessed address
+    uint32_t value;            // Watchpoints: value read or written
+    uint32_t size;             // Watchpoints: access size in bytes
+    uint32_t kind;             // Watchpoints: DEBUG_WATCH_READ or DEBUG_WATCH_WRITE
+} debug_hit_t;
+
+typedef struct debug {
+    arm3_cpu_t* cpu;
+    memory_t* mem;
+    uint32_t breakpoints[DEBUG_MAX_BREAKPOINTS];
+    unsigned breakpoint_count;
+    debug_watchpoint_t watchpoints[DEBUG_MAX_WATCHPOINTS];
+    unsigned watchpoint_count;
+    uint32_t skip_pc;          // Breakpoint passed once after resuming from it
+    uint32_t fetch_pc;         // Fetch in progress on a flagged page, not a data read
+    debug_hit_t hit;           // Last hit
+    bool inspecting;           // A debugger is reading or writing memory: not a guest access
+} debug_t;
+
+void debug_init(debug_t* debug, arm3_cpu_t* cpu, memory_t* mem); // Clears all points
+bool debug_add_breakpoint(debug_t* debug, uint32_t address);
+bool debug_remove_breakpoint(debug_t* debug, uint32_t address);
+bool debug_add_watchpoint(debug_t* debug, uint32_t address, uint32_t length, uint32_t kind);
+bool debug_remove_watchpoint(debug_t* debug, uint32_t address, uint32_t length, uint32_t kind);
+void debug_resume(debug_t* debug); // Continue after a hit, stepping over the breakpoint; other stops stay
+void debug_report(const debug_t* debug, FILE* out);
+
+// Slow paths, called only for pages with PAGE_DEBUG_* flags
+bool debug_fetch(debug_t* debug, uint32_t pc); // true = breakpoint, CPU stopped
+void debug_access(debug_t* debug, uint32_t address, uint32_t size, uint32_t value, uint32_t kind);
+
+#endif
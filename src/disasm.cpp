@@ -0,0 +1,199 @@
+#include "disasm.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DISASM_ADDR_MASK 0x03FFFFFF // 26-bit address space
+
+typedef void (*disasm_format_t)(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size);
+
+typedef struct {
+    uint32_t mask;
+    uint32_t value;
+    disasm_format_t format;
+} disasm_entry_t;
+
+static const char* const conditions[16] = {
+    "EQ", "NE", "CS", "CC", "MI", "PL", "VS", "VC", "HI", "LS", "GE", "LT", "GT", "LE", "", "NV"
+};
+static const char* const registers[16] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc"
+};
+static const char* const data_ops[16] = {
+    "AND", "EOR", "SUB", "RSB", "ADD", "ADC", "SBC", "RSC", "TST", "TEQ", "CMP", "CMN", "ORR", "MOV", "BIC", "MVN"
+};
+static const char* const shifts[4] = { "LSL", "LSR", "ASR", "ROR" };
+static const char* const block_modes[4] = { "DA", "IA", "DB", "IB" }; // Indexed by P:U
+
+#define REG(instr, shift) registers[((instr) >> (shift)) & 0xF]
+
+// Shifted register operand of data processing and register-offset transfers
+static void format_shifted_register(uint32_t instr, char* out, size_t size) {
+    uint32_t type = (instr >> 5) & 3;
+    uint32_t amount = (instr >> 7) & 0x1F;
+    if (instr & 0x10) {
+        snprintf(out, size, "%s, %s %s", REG(instr, 0), shifts[type], REG(instr, 8));
+    } else if (type == 0 && amount == 0) {
+        snprintf(out, size, "%s", REG(instr, 0));
+    } else if (type == 3 && amount == 0) {
+        snprintf(out, size, "%s, RRX", REG(instr, 0));
+    } else {
+        snprintf(out, size, "%s, %s #%u", REG(instr, 0), shifts[type], amount ? amount : 32);
+    }
+}
+
+static void format_data(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    uint32_t opcode = (instr >> 21) & 0xF;
+    bool set_flags = instr & (1 << 20);
+    char operand[32];
+    if (instr & (1 << 25)) {
+        uint32_t rotate = ((instr >> 8) & 0xF) * 2;
+        uint32_t value = instr & 0xFF;
+        if (rotate) value = (value >> rotate) | (value << (32 - rotate));
+        snprintf(operand, sizeof(operand), "#0x%X", value);
+    } else {
+        format_shifted_register(instr, operand, sizeof(operand));
+    }
+
+    if (opcode >= 8 && opcode <= 11) { // Compares: no destination; Rd = pc writes the PSR (the P form)
+        bool psr = ((instr >> 12) & 0xF) == 15;
+        snprintf(out, size, "%s%s%s %s, %s", data_ops[opcode], cond, psr ? "P" : "", REG(instr, 16), operand);
+    } else if (opcode == 13 || opcode == 15) { // MOV and MVN take no Rn
+        snprintf(out, size, "%s%s%s %s, %s", data_ops[opcode], cond, set_flags ? "S" : "", REG(instr, 12), operand);
+    } else {
+        snprintf(out, size, "%s%s%s %s, %s, %s", data_ops[opcode], cond, set_flags ? "S" : "",
+                 REG(instr, 12), REG(instr, 16), operand);
+    }
+}
+
+static void format_multiply(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    const char* s = (instr & (1 << 20)) ? "S" : "";
+    if (instr & (1 << 21)) {
+        snprintf(out, size, "MLA%s%s %s, %s, %s, %s", cond, s, REG(instr, 16), REG(instr, 0), REG(instr, 8), REG(instr, 12));
+    } else {
+        snprintf(out, size, "MUL%s%s %s, %s, %s", cond, s, REG(instr, 16), REG(instr, 0), REG(instr, 8));
+    }
+}
+
+static void format_swap(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    snprintf(out, size, "SWP%s%s %s, %s, [%s]", cond, (instr & (1 << 22)) ? "B" : "",
+             REG(instr, 12), REG(instr, 0), REG(instr, 16));
+}
+
+static void format_transfer(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    bool load = instr & (1 << 20);
+    bool writeback = instr & (1 << 21);
+    bool byte = instr & (1 << 22);
+    bool up = instr & (1 << 23);
+    bool pre = instr & (1 << 24);
+    const char* sign = up ? "" : "-";
+    char offset[40];
+    if (instr & (1 << 25)) {
+        char operand[32];
+        format_shifted_register(instr, operand, sizeof(operand)); // Bit 4 clear: see the table
+        snprintf(offset, sizeof(offset), ", %s%s", sign, operand);
+    } else if (instr & 0xFFF) {
+        snprintf(offset, sizeof(offset), ", #%s0x%X", sign, instr & 0xFFF);
+    } else {
+        offset[0] = '\0';
+    }
+
+    int n = snprintf(out, size, "%s%s%s%s %s, ", load ? "LDR" : "STR", cond, byte ? "B" : "",
+                     !pre && writeback ? "T" : "", REG(instr, 12));
+    if (n < 0 || (size_t)n >= size) return;
+    if (pre) {
+        n += snprintf(out + n, size - n, "[%s%s]%s", REG(instr, 16), offset, writeback ? "!" : "");
+    } else {
+        n += snprintf(out + n, size - n, "[%s]%s", REG(instr, 16), offset);
+    }
+    // PC-relative literal: show the address it reads (pc reads as the instruction + 8)
+    if (((instr >> 16) & 0xF) == 15 && pre && !writeback && !(instr & (1 << 25)) && (size_t)n < size) {
+        uint32_t address = pc + 8 + (up ? (instr & 0xFFF) : -(instr & 0xFFF));
+        snprintf(out + n, size - n, "  ; 0x%08X", address & DISASM_ADDR_MASK);
+    }
+}
+
+static void format_block(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    int n = snprintf(out, size, "%s%s%s %s%s, {", (instr & (1 << 20)) ? "LDM" : "STM", cond,
+                     block_modes[(instr >> 23) & 3], REG(instr, 16), (instr & (1 << 21)) ? "!" : "");
+    bool first = true;
+    for (int reg = 0; reg < 16 && n >= 0 && (size_t)n < size; reg++) {
+        if (!(instr & (1u << reg))) continue;
+        int last = reg;
+        while (last < 15 && (instr & (1u << (last + 1)))) last++;
+        const char* separator = first ? "" : ", ";
+        if (last - reg >= 2) n += snprintf(out + n, size - n, "%s%s-%s", separator, registers[reg], registers[last]);
+        else if (last > reg) n += snprintf(out + n, size - n, "%s%s, %s", separator, registers[reg], registers[last]);
+        else n += snprintf(out + n, size - n, "%s%s", separator, registers[reg]);
+        first = false;
+        reg = last;
+    }
+    if (n >= 0 && (size_t)n < size) snprintf(out + n, size - n, "}%s", (instr & (1 << 22)) ? "^" : "");
+}
+
+static void format_branch(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    uint32_t offset = (instr & 0x00FFFFFF) << 2;
+    if (offset & 0x02000000) offset |= 0xFC000000;
+    uint32_t target = (pc + 8 + offset) & DISASM_ADDR_MASK;
+    snprintf(out, size, "B%s%s 0x%08X", (instr & (1 << 24)) ? "L" : "", cond, target);
+}
+
+static void format_swi(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    snprintf(out, size, "SWI%s 0x%X", cond, instr & 0x00FFFFFF);
+}
+
+static void format_coprocessor_data(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    snprintf(out, size, "CDP%s p%u, %u, c%u, c%u, c%u, %u", cond, (instr >> 8) & 0xF, (instr >> 20) & 0xF,
+             (instr >> 12) & 0xF, (instr >> 16) & 0xF, instr & 0xF, (instr >> 5) & 7);
+}
+
+static void format_coprocessor_register(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    snprintf(out, size, "%s%s p%u, %u, %s, c%u, c%u, %u", (instr & (1 << 20)) ? "MRC" : "MCR", cond,
+             (instr >> 8) & 0xF, (instr >> 21) & 7, REG(instr, 12), (instr >> 16) & 0xF, instr & 0xF, (instr >> 5) & 7);
+}
+
+static void format_coprocessor_transfer(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    uint32_t offset = (instr & 0xFF) * 4;
+    const char* sign = (instr & (1 << 23)) ? "" : "-";
+    int n = snprintf(out, size, "%s%s%s p%u, c%u, ", (instr & (1 << 20)) ? "LDC" : "STC", cond,
+                     (instr & (1 << 22)) ? "L" : "", (instr >> 8) & 0xF, (instr >> 12) & 0xF);
+    if (n < 0 || (size_t)n >= size) return;
+    if (instr & (1 << 24)) {
+        snprintf(out + n, size - n, "[%s, #%s0x%X]%s", REG(instr, 16), sign, offset, (instr & (1 << 21)) ? "!" : "");
+    } else {
+        snprintf(out + n, size - n, "[%s], #%s0x%X", REG(instr, 16), sign, offset);
+    }
+}
+
+static void format_undefined(uint32_t instr, uint32_t pc, const char* cond, char* out, size_t size) {
+    snprintf(out, size, "Undefined 0x%08X", instr);
+}
+
+// First match wins. The order follows cpu_step's decode, with one difference:
+// register-offset transfers with bit 4 set are undefined on the ARM and shown
+// as such here, but cpu_step still executes them as transfers
+static const disasm_entry_t table[] = {
+    { 0x0FC000F0, 0x00000090, format_multiply },
+    { 0x0FB00FF0, 0x01000090, format_swap },
+    { 0x0E000090, 0x00000090, format_undefined },  // Rest of the multiply space: no halfword transfers before ARMv4
+    { 0x0C000000, 0x00000000, format_data },
+    { 0x0E000010, 0x06000010, format_undefined },  // Register-offset transfer with bit 4 set
+    { 0x0C000000, 0x04000000, format_transfer },
+    { 0x0E000000, 0x08000000, format_block },
+    { 0x0E000000, 0x0A000000, format_branch },
+    { 0x0E000000, 0x0C000000, format_coprocessor_transfer },
+    { 0x0F000010, 0x0E000000, format_coprocessor_data },
+    { 0x0F000010, 0x0E000010, format_coprocessor_register },
+    { 0x0F000000, 0x0F000000, format_swi },
+};
+
+void disasm_arm(uint32_t instr, uint32_t pc, char* out, size_t size) {
+    if (size == 0) return;
+    const char* cond = conditions[instr >> 28];
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if ((instr & table[i].mask) == table[i].value) {
+            table[i].format(instr, pc, cond, out, size);
+            return;
+        }
+    }
+    format_undefined(instr, pc, cond, out, size); // Not reached: the table covers every encoding
+}
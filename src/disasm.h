@@ -0,0 +1,14 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <cstdint>
+#include <stddef.h>
+
+// ARM2/ARM3 disassembler: every instruction class (data processing, MUL/MLA,
+// SWP, single and block transfers, branches, SWI, coprocessor operations),
+// decoded through a mask/value table. pc is the instruction's own address,
+// used for branch targets and PC-relative loads. Has no emulator state, so
+// offline tools link it on its own.
+void disasm_arm(uint32_t instr, uint32_t pc, char* out, size_t size);
+
+#endif
@@ -0,0 +1,310 @@
+// Fuzzing harness for the CPU decoder and engines.
+//
+// An input is an ARM program: FUZZ_HEADER_SIZE bytes seed r0-r14 and the
+// NZCV flags, the rest are instruction words loaded at HLE_LOAD_ADDRESS and
+// followed by SWI OS_Exit. Each input runs from a fresh machine reset for at
+// most FUZZ_MAX_STEPS instructions under the lockstep harness (lockstep.h):
+// the reference interpreter against ACORNARC_FUZZ_ENGINE (default "interp").
+// Crashes and undefined behaviour are left to the sanitizers (make fuzz);
+// divergences abort, so libFuzzer keeps the input.
+//
+//   acornarc_fuzz [options]      Random instruction generator
+//     -n count   Programs to run (default 10000, 0 = forever)
+//     -s seed    Generator seed (default: time)
+//     -l words   Instructions per program (default 64)
+//     -d engine  Engine checked against the interpreter
+//     -k count   Instructions per lockstep comparison (default 1)
+//   acornarc_fuzz -r file        Replay one input with the emulator log shown
+//   acornarc_fuzz -t             Run the directed programs: known results that
+//                                engines agreeing with each other cannot prove
+//
+// The generator keeps the program it is running in fuzz-last.bin, so a crash
+// leaves its input behind; divergent programs are saved as fuzz-<seed>-<n>.bin.
+//
+// Built with -DFUZZ_LIBFUZZER (make libfuzzer) only LLVMFuzzerTestOneInput
+// is provided and libFuzzer supplies main.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "machine.h"
+#include "lockstep.h"
+#include "hostfs.h"
+#include "hle.h"
+
+#define FUZZ_HEADER_SIZE 64          // r0-r14 then the flags word
+#define FUZZ_MAX_WORDS 1024
+#define FUZZ_MAX_STEPS 4096
+#define FUZZ_SCRATCH 0x00010000      // Generated base registers point around here
+#define FUZZ_SWI_EXIT 0xEF000011     // SWI OS_Exit, appended to every program
+#define FUZZ_LAST_INPUT "fuzz-last.bin" // Generated program being run
+
+static machine_t* machine;
+static lockstep_t lockstep;
+static int log_fd = -1;              // The real stdout while the emulator log is discarded
+
+static bool fuzz_init(const char* engine_name, unsigned block) {
+    if (machine) return true;
+    const cpu_engine_t* engine = cpu_engine_find(engine_name ? engine_name : "interp");
+    if (!engine) {
+        fprintf(stderr, "Unknown CPU engine: %s\n", engine_name);
+        return false;
+    }
+    machine = machine_create(NULL, NULL, NULL);
+    if (!machine) return false;
+    hostfs_destroy(machine->cpu->hostfs); // Random SWIs must not touch host files
+    machine->cpu->hostfs = NULL;
+    machine->io->cmos.path[0] = '\0';     // Nor write cmos.ram
+    if (!lockstep_init(&lockstep, machine, cpu_engine_find("interp"), engine, block)) {
+        machine_destroy(machine);
+        machine = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Silence the emulator log; reports are replayed with -r
+static void quiet(bool on) {
+    fflush(stdout);
+    if (on) {
+        if (log_fd < 0) log_fd = dup(STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+    } else if (log_fd >= 0) {
+        dup2(log_fd, STDOUT_FILENO);
+    }
+}
+
+static void load_program(machine_t* m, const uint8_t* data, size_t size) {
+    arm3_cpu_t* cpu = m->cpu;
+    size_t words = (size - FUZZ_HEADER_SIZE) / 4;
+    if (words > FUZZ_MAX_WORDS) words = FUZZ_MAX_WORDS;
+    uint32_t flags;
+
+    m->mem->is_boot_mode = 0;
+    cpu->hle_os = true;
+    memcpy(m->mem->ram + HLE_LOAD_ADDRESS, data + FUZZ_HEADER_SIZE, words * 4);
+    uint32_t exit_swi = FUZZ_SWI_EXIT;
+    memcpy(m->mem->ram + HLE_LOAD_ADDRESS + words * 4, &exit_swi, 4);
+    memcpy(cpu->registers, data, 15 * 4);
+    memcpy(&flags, data + 15 * 4, 4);
+    cpu->registers[15] = HLE_LOAD_ADDRESS;
+    cpu->cpsr = (flags & (PSR_N | PSR_Z | PSR_C | PSR_V)) | PSR_I | PSR_F | MODE_SVC;
+}
+
+// Returns false when the engines diverged
+static bool run_input(const uint8_t* data, size_t size) {
+    if (size < FUZZ_HEADER_SIZE) return true;
+    for (int i = 0; i < 2; i++) {
+        machine_reset(lockstep.machine[i]);
+        load_program(lockstep.machine[i], data, size);
+    }
+    lockstep_restart(&lockstep);
+    lockstep_run(&lockstep, FUZZ_MAX_STEPS);
+    return !lockstep.diverged;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (!machine) {
+        quiet(true);
+        if (!fuzz_init(getenv("ACORNARC_FUZZ_ENGINE"), 1)) abort();
+    }
+    if (!run_input(data, size)) abort();
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// Mostly well-formed encodings from every ARM2/ARM3 instruction class, with
+// the odd condition code and raw word mixed in
+static uint32_t random_instruction(uint32_t* state) {
+    uint32_t r = next_random(state);
+    uint32_t cond = (r & 3) ? 0xE : (r >> 2) & 0xF;
+    uint32_t bits = next_random(state);
+    uint32_t instr;
+    switch ((r >> 8) % 10) {
+        case 0: case 1: case 2: // Data processing, immediate or shifted register
+            instr = bits & 0x03FFFFFF;
+            if (!(instr & (1 << 25)) && (instr & 0x10)) instr &= ~0x80u; // Shift by register, not MUL/SWP
+            break;
+        case 3: // MUL/MLA
+            instr = 0x00000090 | (bits & 0x003FFF0F);
+            break;
+        case 4: // SWP/SWPB
+            instr = 0x01000090 | (bits & 0x004FF00F);
+            break;
+        case 5: // LDR/STR
+            instr = 0x04000000 | (bits & 0x03FFFFFF); // Register offsets with bit 4 set are undefined
+            break;
+        case 6: // LDM/STM
+            instr = 0x08000000 | (bits & 0x01FFFFFF);
+            break;
+        case 7: { // B/BL within a few words either way
+            int32_t offset = (int32_t)(bits % 17) - 8;
+            instr = 0x0A000000 | (bits & 0x01000000) | ((uint32_t)offset & 0x00FFFFFF);
+            break;
+        }
+        case 8: // Coprocessor data, transfers and register moves
+            instr = 0x0C000000 | (bits & 0x02FFFFFF);
+            break;
+        default: // Raw word, including SWIs
+            instr = bits;
+            break;
+    }
+    return (cond << 28) | (instr & 0x0FFFFFFF);
+}
+
+static size_t generate(uint8_t* data, uint32_t* state, unsigned words) {
+    for (int i = 0; i < 15; i++) {
+        uint32_t value = next_random(state);
+        // Half the registers are addresses in RAM so loads and stores land
+        if (value & 1) value = FUZZ_SCRATCH + (value & 0xFFFC);
+        memcpy(data + i * 4, &value, 4);
+    }
+    uint32_t flags = next_random(state);
+    memcpy(data + 15 * 4, &flags, 4);
+    for (unsigned i = 0; i < words; i++) {
+        uint32_t instr = random_instruction(state);
+        memcpy(data + FUZZ_HEADER_SIZE + i * 4, &instr, 4);
+    }
+    return FUZZ_HEADER_SIZE + words * 4;
+}
+
+static bool save_input(const char* path, const uint8_t* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    bool saved = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && saved;
+}
+
+// Directed programs: r5 points at scratch RAM, the other registers start at 0
+typedef struct {
+    const char* name;
+    uint32_t words[4];
+    unsigned count;
+    unsigned reg;              // Checked once the program has exited
+    uint32_t expected;
+} directed_t;
+
+static const directed_t directed[] = {
+    { "LDR from a literal after PC", { 0xE59F1000, 0xEA000000, 0x12345678 }, 3, 1, 0x12345678 }, // LDR r1,[pc,#0]
+    { "MOV from PC", { 0xE1A0200F }, 1, 2, HLE_LOAD_ADDRESS + 8 },                               // MOV r2,pc
+    { "PC shifted by a register", { 0xE3A04000, 0xE1A0341F }, 2, 3, HLE_LOAD_ADDRESS + 4 + 12 }, // MOV r4,#0; MOV r3,pc,LSL r4
+    { "STR of PC", { 0xE585F000, 0xE5956000 }, 2, 6, HLE_LOAD_ADDRESS + 12 },                   // STR pc,[r5]; LDR r6,[r5]
+    { "STM of PC", { 0xE8858000, 0xE5957000 }, 2, 7, HLE_LOAD_ADDRESS + 12 },                   // STMIA r5,{pc}; LDR r7,[r5]
+};
+
+static int run_directed(void) {
+    int status = 0;
+    for (const directed_t& test : directed) {
+        uint8_t data[FUZZ_HEADER_SIZE + sizeof(test.words)] = { 0 };
+        uint32_t scratch = FUZZ_SCRATCH;
+        memcpy(data + 5 * 4, &scratch, 4);
+        memcpy(data + FUZZ_HEADER_SIZE, test.words, test.count * 4);
+        bool agreed = run_input(data, FUZZ_HEADER_SIZE + test.count * 4);
+        uint32_t value = lockstep.machine[0]->cpu->registers[test.reg];
+        if (!agreed || value != test.expected) {
+            fprintf(stderr, "%s: r%u = 0x%08X, expected 0x%08X%s\n", test.name, test.reg, value, test.expected,
+                    agreed ? "" : " (engines diverged)");
+            status = 1;
+        }
+    }
+    if (status == 0) fprintf(stderr, "%zu directed programs passed\n", sizeof(directed) / sizeof(directed[0]));
+    return status;
+}
+
+static int replay(const char* path) {
+    static uint8_t data[FUZZ_HEADER_SIZE + FUZZ_MAX_WORDS * 4];
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    return run_input(data, size) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    static uint8_t data[FUZZ_HEADER_SIZE + FUZZ_MAX_WORDS * 4];
+    unsigned count = 10000, words = 64, block = 1;
+    uint32_t seed = (uint32_t)time(NULL);
+    const char* engine = NULL;
+    const char* replay_path = NULL;
+    bool directed_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:l:d:k:r:t")) != -1) {
+        switch (opt) {
+        case 'n': count = (unsigned)atoi(optarg); break;
+        case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'l': words = (unsigned)atoi(optarg); break;
+        case 'd': engine = optarg; break;
+        case 'k': block = (unsigned)atoi(optarg); break;
+        case 'r': replay_path = optarg; break;
+        case 't': directed_only = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n count] [-s seed] [-l words] [-d engine] [-k count] | -r file | -t\n", argv[0]);
+            return 2;
+        }
+    }
+    if (words < 1) words = 1;
+    if (words > FUZZ_MAX_WORDS) words = FUZZ_MAX_WORDS;
+
+    if (replay_path) {
+        if (!fuzz_init(engine, block)) return 1;
+        machine->cpu->log_steps = true; // Not the clone: one instruction log is enough
+        int status = replay(replay_path);
+        lockstep_release(&lockstep);
+        machine_destroy(machine);
+        return status;
+    }
+
+    quiet(true);
+    if (!fuzz_init(engine, block)) return 1;
+    if (directed_only) {
+        int status = run_directed();
+        lockstep_release(&lockstep);
+        machine_destroy(machine);
+        quiet(false);
+        return status;
+    }
+    fprintf(stderr, "Fuzzing %s against interp, seed 0x%08X, %u instructions per program\n",
+            lockstep.engine[1]->name, seed, words);
+    uint32_t state = seed ? seed : 1;
+    int status = 0;
+    for (unsigned i = 0; count == 0 || i < count; i++) {
+        size_t size = generate(data, &state, words);
+        // Written before running, so a crash or sanitizer abort leaves the input behind
+        if (!save_input(FUZZ_LAST_INPUT, data, size)) break;
+        if (run_input(data, size)) continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "fuzz-%08X-%u.bin", seed, i);
+        save_input(path, data, size);
+        fprintf(stderr, "Program %u diverged after %llu instructions; saved as %s, replay with -r\n",
+                i, (unsigned long long)lockstep.steps, path);
+        status = 1;
+        break;
+    }
+    if (status == 0) fprintf(stderr, "%u programs agreed\n", count);
+    lockstep_release(&lockstep);
+    machine_destroy(machine);
+    quiet(false);
+    return status;
+}
+#endif
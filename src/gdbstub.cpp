@@ -0,0 +1,543 @@
+#include "gdbstub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define GDB_PACKET_SIZE 4096        // Advertised in qSupported
+#define GDB_MAX_MEMORY ((GDB_PACKET_SIZE - 8) / 2) // Bytes per m reply
+#define GDB_FPA_HEX (8 * 24 + 8)    // f0-f7 and fps in the default ARM layout: always zero
+#define GDB_REG_FPS 24
+#define GDB_REG_CPSR 25
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+#define GDB_SIGSEGV 11
+
+struct gdbstub {
+    machine_t* machine;
+    int listen_fd;
+    int client_fd;                 // -1 = no debugger attached
+    int stop_fd;                   // eventfd: the emulation thread has parked
+    char socket_path[108];         // Unix socket to remove on destroy, or empty
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t resumed;        // Signalled when the server lets the machine go
+    bool parked;                   // Emulation thread waits in park(): the server owns the machine
+    bool connected;
+    bool quit;
+    bool wait;                     // First frame parks even without a debugger
+    int stop_requested;            // Atomic: park at the next frame boundary
+    int signal;                    // Why the machine last parked, for S replies
+    char in[GDB_PACKET_SIZE];      // Buffered socket input
+    size_t in_pos;
+    size_t in_len;
+};
+
+// Emulation thread: hand the machine to the server until it is resumed.
+// Decided under the lock so a debugger detaching meanwhile cannot strand it.
+static bool park(gdbstub_t* stub, int signal, bool need_client) {
+    pthread_mutex_lock(&stub->lock);
+    __atomic_store_n(&stub->stop_requested, 0, __ATOMIC_RELAXED);
+    if (stub->quit || (need_client && !stub->connected)) {
+        pthread_mutex_unlock(&stub->lock);
+        return false;
+    }
+    stub->parked = true;
+    stub->signal = signal;
+    uint64_t one = 1;
+    if (write(stub->stop_fd, &one, sizeof(one)) != sizeof(one)) printf("GDB: failed to signal a stop\n");
+    while (stub->parked) pthread_cond_wait(&stub->resumed, &stub->lock);
+    pthread_mutex_unlock(&stub->lock);
+    return true;
+}
+
+static void unpark(gdbstub_t* stub) {
+    pthread_mutex_lock(&stub->lock);
+    stub->parked = false;
+    pthread_cond_signal(&stub->resumed);
+    pthread_mutex_unlock(&stub->lock);
+}
+
+static void request_stop(gdbstub_t* stub) {
+    __atomic_store_n(&stub->stop_requested, 1, __ATOMIC_RELEASE);
+}
+
+static int read_byte(gdbstub_t* stub) {
+    if (stub->in_pos == stub->in_len) {
+        ssize_t n;
+        do {
+            n = read(stub->client_fd, stub->in, sizeof(stub->in));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return -1;
+        stub->in_pos = 0;
+        stub->in_len = (size_t)n;
+    }
+    return (uint8_t)stub->in[stub->in_pos++];
+}
+
+static bool write_all(gdbstub_t* stub, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(stub->client_fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// Server thread: wait until the machine is parked. With watch_client, a
+// Ctrl-C (0x03) from the debugger asks it to stop. false = quitting or the
+// debugger went away.
+static bool wait_parked(gdbstub_t* stub, bool watch_client) {
+    for (;;) {
+        while (watch_client && stub->in_pos < stub->in_len) {
+            if (stub->in[stub->in_pos++] == 0x03) request_stop(stub);
+        }
+        struct pollfd fds[2] = { { stub->stop_fd, POLLIN, 0 }, { stub->client_fd, POLLIN, 0 } };
+        if (poll(fds, watch_client ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(stub->stop_fd, &count, sizeof(count)) != sizeof(count)) continue;
+            pthread_mutex_lock(&stub->lock);
+            bool parked = stub->parked, quit = stub->quit;
+            // A request made while it was already parked must not stop the next continue
+            if (parked) __atomic_store_n(&stub->stop_requested, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&stub->lock);
+            if (quit) return false;
+            if (parked) return true;
+        }
+        if (watch_client && fds[1].revents) {
+            int c = read_byte(stub);
+            if (c < 0) return false;
+            if (c == 0x03) request_stop(stub);
+        }
+    }
+}
+
+static int hex_digit(int c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Next command packet, acknowledged, into buf; false = debugger gone
+static bool read_packet(gdbstub_t* stub, char* buf, size_t size) {
+    for (;;) {
+        int c;
+        do {
+            c = read_byte(stub); // Skips acks, and Ctrl-C while already stopped
+            if (c < 0) return false;
+        } while (c != '$');
+        size_t len = 0;
+        uint8_t sum = 0;
+        while ((c = read_byte(stub)) != '#') {
+            if (c < 0) return false;
+            if (len + 1 < size) buf[len++] = (char)c;
+            sum += (uint8_t)c;
+        }
+        buf[len] = '\0';
+        int high = hex_digit(read_byte(stub));
+        int low = hex_digit(read_byte(stub));
+        bool valid = high >= 0 && low >= 0 && (uint8_t)(high << 4 | low) == sum;
+        if (!write_all(stub, valid ? "+" : "-", 1)) return false;
+        if (valid) return true;
+    }
+}
+
+static bool send_packet(gdbstub_t* stub, const char* data) {
+    char out[GDB_PACKET_SIZE + 4];
+    size_t len = strlen(data);
+    uint8_t sum = 0;
+    out[0] = '$';
+    for (size_t i = 0; i < len; i++) {
+        out[i + 1] = data[i];
+        sum += (uint8_t)data[i];
+    }
+    snprintf(out + len + 1, 4, "#%02x", sum);
+    return write_all(stub, out, len + 4);
+}
+
+// Register values travel in target (little-endian) byte order
+static char* put_hex32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out += sprintf(out, "%02x", (value >> (i * 8)) & 0xFF);
+    }
+    return out;
+}
+
+static bool get_hex32(const char** text, uint32_t* value) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        int high = hex_digit((*text)[0]);
+        int low = high >= 0 ? hex_digit((*text)[1]) : -1;
+        if (low < 0) return false;
+        result |= (uint32_t)(high << 4 | low) << (i * 8);
+        *text += 2;
+    }
+    *value = result;
+    return true;
+}
+
+// Addresses, lengths and register numbers are plain big-endian hex
+static uint32_t parse_hex(const char** text) {
+    uint32_t value = 0;
+    int digit;
+    while ((digit = hex_digit(**text)) >= 0) {
+        value = value << 4 | (uint32_t)digit;
+        (*text)++;
+    }
+    return value;
+}
+
+static uint32_t* register_slot(arm3_cpu_t* cpu, uint32_t n) {
+    if (n < 16) return &cpu->registers[n];
+    if (n == GDB_REG_CPSR) return &cpu->cpsr;
+    return NULL;
+}
+
+// RAM and ROM only: I/O reads have side effects and unmapped reads are logged
+static bool inspectable(memory_t* mem, uint32_t address) {
+    address &= ADDR_MASK;
+    if (mem->is_boot_mode && address < 0x00200000) return true;
+    if (address >= RAM_BASE && address < RAM_BASE + RAM_SIZE) return true;
+    return address >= mem->rom_base && address < mem->rom_base + mem->rom_size;
+}
+
+static void stop_reply(gdbstub_t* stub, char* out, size_t size) {
+    const arm3_cpu_t* cpu = stub->machine->cpu;
+    const debug_hit_t* hit = &machine_debug(stub->machine)->hit;
+    if (!cpu->halted) {
+        snprintf(out, size, "S%02x", stub->signal);
+        return;
+    }
+    switch (cpu->stop_reason) {
+    case CPU_STOP_EXIT: snprintf(out, size, "W%02x", cpu->exit_code & 0xFF); break;
+    case CPU_STOP_WATCHPOINT:
+        snprintf(out, size, "T%02x%s:%x;", GDB_SIGTRAP, hit->kind == DEBUG_WATCH_WRITE ? "watch" : "rwatch", hit->address);
+        break;
+    case CPU_STOP_INVALID_FETCH: snprintf(out, size, "S%02x", GDB_SIGSEGV); break;
+    default: snprintf(out, size, "S%02x", GDB_SIGTRAP); break; // Breakpoint or watchdog
+    }
+}
+
+static void read_registers(arm3_cpu_t* cpu, char* out) {
+    for (int i = 0; i < 16; i++) {
+        out = put_hex32(out, cpu->registers[i]);
+    }
+    memset(out, '0', GDB_FPA_HEX);
+    out = put_hex32(out + GDB_FPA_HEX, cpu->cpsr);
+    *out = '\0';
+}
+
+static bool write_registers(arm3_cpu_t* cpu, const char* text) {
+    uint32_t values[16];
+    for (int i = 0; i < 16; i++) {
+        if (!get_hex32(&text, &values[i])) return false;
+    }
+    memcpy(cpu->registers, values, sizeof(values));
+    if (strlen(text) >= GDB_FPA_HEX + 8) {
+        text += GDB_FPA_HEX;
+        get_hex32(&text, &cpu->cpsr);
+    }
+    return true;
+}
+
+static void read_memory(machine_t* m, const char* args, char* out) {
+    uint32_t address = parse_hex(&args);
+    uint32_t length = *args == ',' ? (args++, parse_hex(&args)) : 0;
+    if (length > GDB_MAX_MEMORY) length = GDB_MAX_MEMORY;
+    debug_t* debug = machine_debug(m);
+    char* p = out;
+    debug->inspecting = true;
+    for (uint32_t i = 0; i < length && inspectable(m->mem, address + i); i++) {
+        p += sprintf(p, "%02x", memory_read_byte(m->mem, address + i));
+    }
+    debug->inspecting = false;
+    if (p == out && length > 0) strcpy(out, "E14"); // EFAULT; a short read is fine
+    else *p = '\0';
+}
+
+static bool write_memory(machine_t* m, const char* args) {
+    uint32_t address = parse_hex(&args);
+    if (*args++ != ',') return false;
+    uint32_t length = parse_hex(&args);
+    if (*args++ != ':' || strlen(args) < length * 2) return false;
+    for (uint32_t i = 0; i < length; i++) {
+        if (!inspectable(m->mem, address + i)) return false;
+    }
+    debug_t* debug = machine_debug(m);
+    debug->inspecting = true;
+    for (uint32_t i = 0; i < length; i++) {
+        memory_write_byte(m->mem, address + i, (uint8_t)(hex_digit(args[i * 2]) << 4 | hex_digit(args[i * 2 + 1])));
+    }
+    debug->inspecting = false;
+    return true;
+}
+
+// Z/z packets: "type,address,kind". Returns the reply.
+static const char* set_point(machine_t* m, bool insert, const char* args) {
+    debug_t* debug = machine_debug(m);
+    int type = hex_digit(*args++);
+    if (*args++ != ',') return "E01";
+    uint32_t address = parse_hex(&args);
+    uint32_t length = *args == ',' ? (args++, parse_hex(&args)) : 4;
+    uint32_t kind;
+    switch (type) {
+    case 0: case 1: // Software and hardware breakpoints are the same thing here
+        if (insert) return debug_add_breakpoint(debug, address) ? "OK" : "E28";
+        debug_remove_breakpoint(debug, address);
+        return "OK";
+    case 2: kind = DEBUG_WATCH_WRITE; break;
+    case 3: kind = DEBUG_WATCH_READ; break;
+    case 4: kind = DEBUG_WATCH_READ | DEBUG_WATCH_WRITE; break;
+    default: return "";
+    }
+    if (insert) return debug_add_watchpoint(debug, address, length, kind) ? "OK" : "E28";
+    debug_remove_watchpoint(debug, address, length, kind);
+    return "OK";
+}
+
+static void query(const char* packet, char* reply, size_t size) {
+    if (strncmp(packet, "qSupported", 10) == 0) snprintf(reply, size, "PacketSize=%x", GDB_PACKET_SIZE);
+    else if (strcmp(packet, "qAttached") == 0) snprintf(reply, size, "1");
+    else if (strcmp(packet, "qC") == 0) snprintf(reply, size, "QC1");
+    else if (strcmp(packet, "qfThreadInfo") == 0) snprintf(reply, size, "m1");
+    else if (strcmp(packet, "qsThreadInfo") == 0) snprintf(reply, size, "l");
+    else reply[0] = '\0'; // Unsupported
+}
+
+// One debugger session, entered with the machine parked. Returns when the
+// debugger detaches, kills or disconnects.
+static void serve(gdbstub_t* stub) {
+    char packet[GDB_PACKET_SIZE], reply[GDB_PACKET_SIZE];
+    machine_t* m = stub->machine;
+    arm3_cpu_t* cpu = m->cpu;
+    debug_t* debug = machine_debug(m);
+
+    while (read_packet(stub, packet, sizeof(packet))) {
+        const char* args = packet + 1;
+        reply[0] = '\0';
+        switch (packet[0]) {
+        case '?': stop_reply(stub, reply, sizeof(reply)); break;
+        case 'g': read_registers(cpu, reply); break;
+        case 'G': strcpy(reply, write_registers(cpu, args) ? "OK" : "E01"); break;
+        case 'p': {
+            uint32_t n = parse_hex(&args);
+            uint32_t* slot = register_slot(cpu, n);
+            if (slot) {
+                put_hex32(reply, *slot);
+            } else if (n <= GDB_REG_FPS) { // Empty FPA registers: 12 bytes each, fps 4
+                size_t digits = n < GDB_REG_FPS ? 24 : 8;
+                memset(reply, '0', digits);
+                reply[digits] = '\0';
+            } else {
+                strcpy(reply, "E01");
+            }
+            break;
+        }
+        case 'P': {
+            uint32_t n = parse_hex(&args);
+            uint32_t* slot = register_slot(cpu, n);
+            uint32_t value;
+            bool valid = *args++ == '=' && get_hex32(&args, &value) && n <= GDB_REG_CPSR;
+            if (valid && slot) *slot = value; // FPA writes are dropped
+            strcpy(reply, valid ? "OK" : "E01");
+            break;
+        }
+        case 'm': read_memory(m, args, reply); break;
+        case 'M': strcpy(reply, write_memory(m, args) ? "OK" : "E01"); break;
+        case 'Z': case 'z': strcpy(reply, set_point(m, packet[0] == 'Z', args)); break;
+        case 'H': case 'T': strcpy(reply, "OK"); break; // One thread
+        case 'q': query(packet, reply, sizeof(reply)); break;
+        case 's':
+            // On this thread: the machine is parked, so no frame runs meanwhile
+            debug_resume(debug);
+            cpu_step(cpu);
+            stub->signal = GDB_SIGTRAP;
+            stop_reply(stub, reply, sizeof(reply));
+            break;
+        case 'c':
+            debug_resume(debug);
+            if (!cpu->halted) { // Exits and watchdog stops are final
+                unpark(stub);
+                if (!wait_parked(stub, true)) return;
+            }
+            stop_reply(stub, reply, sizeof(reply));
+            break;
+        case 'D':
+            send_packet(stub, "OK");
+            return;
+        case 'k':
+            return;
+        }
+        if (!send_packet(stub, reply)) return;
+    }
+}
+
+// The machine carries on without the debugger
+static void end_session(gdbstub_t* stub) {
+    pthread_mutex_lock(&stub->lock);
+    stub->connected = false;
+    __atomic_store_n(&stub->stop_requested, 0, __ATOMIC_RELAXED);
+    if (stub->parked) {
+        debug_resume(machine_debug(stub->machine));
+        stub->parked = false;
+        pthread_cond_signal(&stub->resumed);
+    }
+    close(stub->client_fd);
+    stub->client_fd = -1;
+    pthread_mutex_unlock(&stub->lock);
+}
+
+static void* server_main(void* arg) {
+    gdbstub_t* stub = (gdbstub_t*)arg;
+    for (;;) {
+        int fd = accept4(stub->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break; // Listener shut down by gdbstub_destroy
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix sockets
+
+        pthread_mutex_lock(&stub->lock);
+        bool quit = stub->quit;
+        if (!quit) {
+            stub->client_fd = fd;
+            stub->connected = true;
+        }
+        pthread_mutex_unlock(&stub->lock);
+        if (quit) {
+            close(fd);
+            break;
+        }
+        printf("GDB: debugger attached\n");
+        stub->in_pos = stub->in_len = 0;
+        request_stop(stub);
+        // The socket is left alone until the machine parks: it holds the first packets
+        if (wait_parked(stub, false)) serve(stub);
+        end_session(stub);
+        printf("GDB: debugger detached\n");
+    }
+    return NULL;
+}
+
+static int open_listener(const char* address, char* path, size_t path_size) {
+    char* end;
+    unsigned long port = strtoul(address, &end, 10);
+    int fd;
+    if (*address && !*end) {
+        if (port == 0 || port > 65535) {
+            printf("GDB: invalid port %s\n", address);
+            return -1;
+        }
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Never exposed beyond this host
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        struct sockaddr_un addr = {};
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            printf("GDB: socket path too long: %s\n", address);
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, address);
+        unlink(address); // Left behind by an earlier run
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) snprintf(path, path_size, "%s", address);
+    }
+    if (fd >= 0 && listen(fd, 1) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) printf("GDB: cannot listen on %s: %s\n", address, strerror(errno));
+    return fd;
+}
+
+gdbstub_t* gdbstub_create(machine_t* m, const char* address, bool wait) {
+    gdbstub_t* stub = (gdbstub_t*)calloc(1, sizeof(gdbstub_t));
+    if (!stub) return NULL;
+    stub->machine = m;
+    stub->client_fd = -1;
+    stub->wait = wait;
+    stub->stop_requested = wait;
+    stub->listen_fd = open_listener(address, stub->socket_path, sizeof(stub->socket_path));
+    if (stub->listen_fd < 0) {
+        free(stub);
+        return NULL;
+    }
+    stub->stop_fd = eventfd(0, EFD_CLOEXEC);
+    pthread_mutex_init(&stub->lock, NULL);
+    pthread_cond_init(&stub->resumed, NULL);
+    if (stub->stop_fd < 0 || pthread_create(&stub->thread, NULL, server_main, stub) != 0) {
+        printf("GDB: failed to start the server thread\n");
+        if (stub->stop_fd >= 0) close(stub->stop_fd);
+        close(stub->listen_fd);
+        if (stub->socket_path[0]) unlink(stub->socket_path);
+        pthread_mutex_destroy(&stub->lock);
+        pthread_cond_destroy(&stub->resumed);
+        free(stub);
+        return NULL;
+    }
+    printf("GDB: listening on %s%s%s\n", stub->socket_path[0] ? "" : "localhost:", address,
+           wait ? ", waiting for a debugger" : "");
+    return stub;
+}
+
+void gdbstub_destroy(gdbstub_t* stub) {
+    if (!stub) return;
+    pthread_mutex_lock(&stub->lock);
+    stub->quit = true;
+    if (stub->client_fd >= 0) shutdown(stub->client_fd, SHUT_RDWR);
+    pthread_mutex_unlock(&stub->lock);
+    shutdown(stub->listen_fd, SHUT_RDWR);
+    uint64_t one = 1;
+    if (write(stub->stop_fd, &one, sizeof(one)) != sizeof(one)) printf("GDB: failed to wake the server\n");
+    pthread_join(stub->thread, NULL);
+
+    close(stub->stop_fd);
+    close(stub->listen_fd);
+    if (stub->socket_path[0]) unlink(stub->socket_path);
+    pthread_mutex_destroy(&stub->lock);
+    pthread_cond_destroy(&stub->resumed);
+    free(stub);
+}
+
+bool gdbstub_run_frame(gdbstub_t* stub, retro_video_refresh_t video_cb) {
+    machine_t* m = stub->machine;
+    // All an undisturbed machine pays: one load per frame
+    if (__atomic_load_n(&stub->stop_requested, __ATOMIC_ACQUIRE)) {
+        park(stub, GDB_SIGINT, !stub->wait);
+        stub->wait = false;
+    }
+    if (machine_run_frame(m, video_cb)) return true;
+    // Stopped: a debugger gets to look first, and may resume a breakpoint stop
+    if (!park(stub, GDB_SIGTRAP, true)) return false;
+    return !m->cpu->halted;
+}
@@ -0,0 +1,24 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <libretro.h> // For retro_video_refresh_t
+#include "machine.h"
+
+// GDB remote serial protocol server for one machine, on a localhost TCP port
+// or a Unix socket ("target remote :1234" or "target remote /path").
+//
+// The server has its own thread and never touches the machine while it runs.
+// gdbstub_run_frame stands in for machine_run_frame: between frames it checks
+// one flag, and when the debugger wants the machine (attach, Ctrl-C, or a
+// breakpoint/watchpoint stop) the emulation thread parks there and hands the
+// machine to the server until the debugger continues. Registers follow GDB's
+// default ARM layout (r0-r15, eight empty FPA registers, fps, cpsr).
+typedef struct gdbstub gdbstub_t;
+
+// address: a port number, or a Unix socket path. wait = the first
+// gdbstub_run_frame blocks until a debugger attaches.
+gdbstub_t* gdbstub_create(machine_t* m, const char* address, bool wait);
+void gdbstub_destroy(gdbstub_t* stub); // Detaches any debugger and lets a parked machine go
+bool gdbstub_run_frame(gdbstub_t* stub, retro_video_refresh_t video_cb); // false = stopped
+
+#endif
@@ -0,0 +1,146 @@
+// Compare two state hash logs from acornarc_headless -H and report where the
+// runs first differ.
+//
+//   acornarc_hashdiff a.log b.log
+//
+// Both logs are scanned for the first frame whose hashes differ, so runs that
+// diverge and later converge again (a register difference that is
+// overwritten, say) still report the first difference. If both logs also
+// hash that frame per instruction (-I), its steps are scanned the same way;
+// otherwise the tool prints the -I option for rerunning both builds. Exit
+// status 0 = same, 1 = diverged.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+typedef struct {
+    unsigned frame;
+    unsigned step;
+    uint32_t pc;
+    uint64_t hash;
+} hash_entry_t;
+
+typedef struct {
+    hash_entry_t* frames;    // One per frame, in order
+    size_t frame_count;
+    hash_entry_t* steps;     // Per-instruction entries from -I, in order
+    size_t step_count;
+} hash_log_t;
+
+static bool append(hash_entry_t** entries, size_t* count, const hash_entry_t* entry) {
+    if (*count == 0 || (*count >= 1024 && (*count & (*count - 1)) == 0)) { // Full at 1024, 2048, ...
+        size_t capacity = *count ? *count * 2 : 1024;
+        hash_entry_t* grown = (hash_entry_t*)realloc(*entries, capacity * sizeof(hash_entry_t));
+        if (!grown) return false;
+        *entries = grown;
+    }
+    (*entries)[(*count)++] = *entry;
+    return true;
+}
+
+static bool load_log(const char* path, hash_log_t* log) {
+    memset(log, 0, sizeof(*log));
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    char line[128];
+    unsigned number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        number++;
+        hash_entry_t entry = {};
+        unsigned long long hash;
+        if (sscanf(line, "frame %u step %u pc %x hash %llx", &entry.frame, &entry.step, &entry.pc, &hash) == 4) {
+            entry.hash = hash;
+            ok = append(&log->steps, &log->step_count, &entry);
+        } else if (sscanf(line, "frame %u hash %llx", &entry.frame, &hash) == 2) {
+            entry.hash = hash;
+            ok = entry.frame == log->frame_count && append(&log->frames, &log->frame_count, &entry);
+        } else {
+            ok = false;
+        }
+        if (!ok) printf("%s:%u: not a hash log line\n", path, number);
+    }
+    fclose(file);
+    return ok;
+}
+
+static void free_log(hash_log_t* log) {
+    free(log->frames);
+    free(log->steps);
+}
+
+// First index where a and b differ, or count if none does
+static size_t first_difference(const hash_entry_t* a, const hash_entry_t* b, size_t count) {
+    size_t i = 0;
+    while (i < count && a[i].hash == b[i].hash) i++;
+    return i;
+}
+
+// The step entries of one frame
+static const hash_entry_t* frame_steps(const hash_log_t* log, unsigned frame, size_t* count) {
+    size_t first = 0;
+    while (first < log->step_count && log->steps[first].frame != frame) first++;
+    size_t last = first;
+    while (last < log->step_count && log->steps[last].frame == frame) last++;
+    *count = last - first;
+    return log->steps + first;
+}
+
+static int compare(const char* path_a, const hash_log_t* a, const char* path_b, const hash_log_t* b) {
+    size_t common = a->frame_count < b->frame_count ? a->frame_count : b->frame_count;
+    size_t frame = first_difference(a->frames, b->frames, common);
+    if (frame == common) {
+        if (a->frame_count == b->frame_count) {
+            printf("No divergence in %zu frames\n", common);
+            return 0;
+        }
+        printf("Same state for %zu frames, then %s stops\n", common, a->frame_count < b->frame_count ? path_a : path_b);
+        return 1;
+    }
+    printf("First divergent frame: %zu (%016llx vs %016llx)\n", frame,
+           (unsigned long long)a->frames[frame].hash, (unsigned long long)b->frames[frame].hash);
+
+    size_t count_a, count_b;
+    const hash_entry_t* steps_a = frame_steps(a, (unsigned)frame, &count_a);
+    const hash_entry_t* steps_b = frame_steps(b, (unsigned)frame, &count_b);
+    if (count_a == 0 || count_b == 0) {
+        printf("Rerun both with -I %zu to find the first divergent instruction\n", frame);
+        return 1;
+    }
+    size_t common_steps = count_a < count_b ? count_a : count_b;
+    size_t step = first_difference(steps_a, steps_b, common_steps);
+    if (step == common_steps) {
+        // Same state after every common step: the frame ended early in one run
+        printf("Same state for %zu instructions, then %s ends the frame\n", common_steps, count_a < count_b ? path_a : path_b);
+    } else {
+        // Step 0 can also mean the frame's timer and interrupt update differed
+        printf("First divergent instruction: step %u, at %08X vs %08X\n",
+               steps_a[step].step, steps_a[step].pc, steps_b[step].pc);
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s a.log b.log\n", argv[0]);
+        return 2;
+    }
+    hash_log_t a, b;
+    if (!load_log(argv[1], &a)) {
+        free_log(&a);
+        return 2;
+    }
+    if (!load_log(argv[2], &b)) {
+        free_log(&a);
+        free_log(&b);
+        return 2;
+    }
+    int status = compare(argv[1], &a, argv[2], &b);
+    free_log(&a);
+    free_log(&b);
+    return status;
+}
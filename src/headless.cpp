@@ -0,0 +1,443 @@
+// Headless runner: drives a machine without a libretro frontend, for batch
+// jobs and automated runs.
+//
+//   acornarc_headless [options] [image]
+//     -r rom     ROM to boot when no image is given (default riscos.rom)
+//     -f frames  Frame limit per run, 0 = until the guest exits (default 3000)
+//     -s         Fork server: read jobs from stdin, one forked child per job
+//     -b frames  Frames the template runs before serving jobs (default 0)
+//     -j count   Children running at once in fork-server mode (default 1)
+//     -m         Offer guest RAM to KSM for dedup across instances; each run
+//                reports how much of its RAM ended up merged
+//     -w seconds Watchdog: stop when the PC stays within 256 bytes without I/O,
+//                or (ROM boots) the screen stays blank, this long (default 10,
+//                0 = off). Repeated faults at one instruction always stop.
+//     -e         Export RAM and a status block for external tools (see
+//                machine_export); the paths are printed at startup
+//     -z seconds Fork server: whenever no job has arrived for a second, compress
+//                template RAM pages unwritten this long (0 = all pages); the
+//                next job expands them once before forking
+//     -d engine  Differential run: execute under the reference interpreter and
+//                the named engine in lockstep, stopping at the first divergence
+//                (see lockstep.h); "interp" checks the interpreter against itself
+//     -k count   Instructions per lockstep comparison (default 1)
+//     -B addr    Stop before executing addr (repeatable)
+//     -W addr[:len] Stop after a write to addr..addr+len-1 (default 4 bytes)
+//     -R addr[:len] Stop after a read from that range; both report the access
+//     -g port|path Serve GDB on a localhost port or Unix socket (gdbstub.h) and
+//                wait for a debugger before the first frame
+//     -c file    Record which guest instructions ran (coverage.h) and save the
+//                bitmap to file; fork-server jobs write file.<job>. Merge and
+//                annotate with acornarc_covtool.
+//     -t file    Write a binary trace of every executed instruction (trace.h);
+//                fork-server jobs write file.<job>. Read with acornarc_trace.
+//     -H file    Log a hash of the machine state after every frame (see
+//                machine_state_hash); compare two logs with acornarc_hashdiff
+//     -I frame   With -H, also log the hash after every instruction of that
+//                frame, to find the first instruction where two runs differ
+//     -L file    Restore a snapshot (snapshot.h) before running; the ROM or
+//                image must be the one it was taken with. Fork server: the
+//                template starts from it.
+//     -S file    Save a snapshot when the run ends; fork server: of the
+//                template, after the -b frames
+//     -P name    Use the named ROM profile (romprofile.h) even though the
+//                ROM's crc32 is not listed for it in romprofiles.txt
+//     -l         Log every instruction with its disassembly (slow)
+//     -M         Save -S snapshots uncompressed, with RAM laid out so -L maps
+//                it straight from the file: near-instant restores that share
+//                untouched pages through the page cache
+//
+// In fork-server mode the template machine is created (and optionally booted
+// for -b frames) once; each job then starts from that state in a fork()ed
+// child, so untouched guest RAM and ROM stay shared copy-on-write. A job line
+// is "<image|-> [frames]": the child loads the image under the HLE OS ("-"
+// keeps running the template as is) and its exit status is the guest's.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "machine.h"
+#include "hostfs.h"
+#include "hle.h"
+#include "lockstep.h"
+#include "gdbstub.h"
+#include "coverage.h"
+#include "snapshot.h"
+
+#define EXIT_BREAK 122       // Breakpoint or watchpoint hit; the report precedes it
+#define EXIT_DIVERGED 123    // Lockstep engines disagreed; the report precedes it
+#define EXIT_FRAME_LIMIT 124 // Same convention as timeout(1)
+#define EXIT_STOPPED 125     // Run loop stopped without the guest exiting
+#define EXIT_WATCHDOG 126    // Watchdog or invalid fetch; a JSON report precedes it
+#define MAX_PARALLEL_JOBS 256
+#define SERVER_IDLE_MS 1000  // Fork server: no job for this long and the template is suspended (-z)
+#define MAX_DEBUG_OPTIONS (DEBUG_MAX_BREAKPOINTS + DEBUG_MAX_WATCHPOINTS)
+
+typedef struct {
+    int option;              // 'B', 'W' or 'R'
+    const char* spec;        // addr[:len]
+} debug_option_t;
+
+typedef struct {
+    FILE* file;              // NULL = no hash log
+    unsigned step_frame;     // Frame hashed per instruction (UINT_MAX = none)
+} hash_log_t;
+
+typedef struct {
+    pid_t pid;               // 0 = free slot
+    unsigned job;
+    char image[256];
+    struct timespec start;
+} job_slot_t;
+
+static void null_video(const void* data, unsigned width, unsigned height, size_t pitch) {
+    // Frames are not displayed; rendering still runs so VSync interrupts fire
+}
+
+static double elapsed(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// machine_run_frame, logging the state hash after each instruction. Hashing
+// only touches the pages the instruction wrote, so a whole frame stays fast.
+static bool run_frame_hashed(machine_t* m, FILE* log, unsigned frame) {
+    arm3_cpu_t* cpu = m->cpu;
+    if (!machine_frame_begin(m)) return false;
+    uint32_t pc_low = 0xFFFFFFFF, pc_high = 0;
+    unsigned steps = 0;
+    for (; steps < MACHINE_FRAME_STEPS && !cpu->halted && !cpu->idle; steps++) {
+        uint32_t pc = cpu->registers[15] & ADDR_MASK;
+        if (pc < pc_low) pc_low = pc;
+        if (pc > pc_high) pc_high = pc;
+        cpu_step(cpu);
+        fprintf(log, "frame %u step %u pc %08X hash %016llx\n", frame, steps, pc,
+                (unsigned long long)machine_state_hash(m));
+    }
+    return machine_frame_end(m, null_video, pc_low, pc_high, steps);
+}
+
+static int run_machine(machine_t* m, unsigned frames, lockstep_t* lockstep, gdbstub_t* gdb, const hash_log_t* hash) {
+    int status = EXIT_FRAME_LIMIT;
+    for (unsigned frame = 0; frames == 0 || frame < frames; frame++) {
+        bool running;
+        if (lockstep) running = lockstep_run_frame(lockstep, null_video);
+        else if (gdb) running = gdbstub_run_frame(gdb, null_video);
+        else if (hash && frame == hash->step_frame) running = run_frame_hashed(m, hash->file, frame);
+        else running = machine_run_frame(m, null_video);
+        if (hash) {
+            // Also after the last frame: a run can diverge by stopping early
+            fprintf(hash->file, "frame %u hash %016llx\n", frame, (unsigned long long)machine_state_hash(m));
+        }
+        if (!running) {
+            if (lockstep && lockstep->diverged) status = EXIT_DIVERGED;
+            else if (!m->cpu->halted) status = EXIT_STOPPED;
+            else if (m->cpu->stop_reason == CPU_STOP_EXIT) status = (int)(m->cpu->exit_code & 0xFF);
+            else if (m->cpu->stop_reason == CPU_STOP_BREAKPOINT || m->cpu->stop_reason == CPU_STOP_WATCHPOINT) status = EXIT_BREAK;
+            else status = EXIT_WATCHDOG;
+            break;
+        }
+    }
+    if (status == EXIT_FRAME_LIMIT) machine_report(m, stdout);
+    if (m->mem->mergeable) {
+        printf("Page dedup: %zu KB of RAM merged\n", memory_merged_bytes(m->mem) / 1024);
+    }
+    return status;
+}
+
+static bool save_snapshot(machine_t* m, threadpool_t* pool, const char* path, bool mapped) {
+    bool saved = mapped ? snapshot_save_mapped(m, path) : snapshot_save_file(m, pool, path);
+    if (saved) printf("Snapshot saved to %s\n", path);
+    return saved;
+}
+
+// Child side of a job: start from the inherited template state, run, exit.
+// CMOS is deliberately not saved so concurrent jobs do not race on cmos.ram.
+static void run_job(machine_t* m, const char* image, unsigned frames, const char* coverage_path, const char* trace_path) {
+    int status = EXIT_STOPPED;
+    if (trace_path[0] && !machine_trace(m, trace_path)) _exit(status);
+    if (strcmp(image, "-") == 0 || hle_load_image(m->cpu, image, image)) {
+        m->mem->is_boot_mode = 0;
+        status = run_machine(m, frames, NULL, NULL, NULL);
+    }
+    if (coverage_path[0]) coverage_save(m->cpu->coverage, coverage_path); // Includes the template's boot
+    hostfs_destroy(m->cpu->hostfs); // Flushes files the job wrote
+    m->cpu->hostfs = NULL;
+    if (trace_path[0]) machine_trace(m, NULL); // _exit skips machine_destroy
+    fflush(stdout);
+    _exit(status);
+}
+
+static bool add_debug_point(debug_t* debug, const debug_option_t* option) {
+    char* end;
+    uint32_t address = (uint32_t)strtoul(option->spec, &end, 0);
+    uint32_t length = *end == ':' ? (uint32_t)strtoul(end + 1, NULL, 0) : 4;
+    bool added;
+    switch (option->option) {
+    case 'B': added = debug_add_breakpoint(debug, address); break;
+    case 'W': added = debug_add_watchpoint(debug, address, length, DEBUG_WATCH_WRITE); break;
+    default: added = debug_add_watchpoint(debug, address, length, DEBUG_WATCH_READ); break;
+    }
+    if (!added) fprintf(stderr, "Cannot add -%c %s\n", option->option, option->spec);
+    return added;
+}
+
+// Wait for a child; returns the job slots freed (0 for a process that was not a job)
+static unsigned reap_job(job_slot_t* slots, unsigned count) {
+    int status;
+    pid_t pid;
+    do {
+        pid = wait(&status);
+    } while (pid < 0 && errno == EINTR);
+    if (pid < 0) {
+        // ECHILD: every child has already gone (and cannot be reported), free their slots
+        unsigned freed = 0;
+        for (unsigned i = 0; i < count; i++) {
+            if (slots[i].pid) freed++;
+            slots[i].pid = 0;
+        }
+        perror("wait");
+        return freed;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        if (slots[i].pid != pid) continue;
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        printf("job %u %s: exit %d (%.3fs)\n", slots[i].job, slots[i].image, code, elapsed(&slots[i].start));
+        fflush(stdout);
+        slots[i].pid = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int fork_server(machine_t* m, unsigned default_frames, unsigned parallel, int suspend_age,
+                       const char* coverage_path, const char* trace_path) {
+    job_slot_t* slots = (job_slot_t*)calloc(parallel, sizeof(job_slot_t));
+    if (!slots) return 1;
+
+    char line[1024];
+    unsigned job = 0, running = 0;
+    setvbuf(stdin, NULL, _IONBF, 0); // Jobs still buffered in stdio would be invisible to poll
+    for (;;) {
+        // Compress the template's cold pages whenever the server runs out of jobs
+        struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+        if (suspend_age >= 0 && poll(&input, 1, SERVER_IDLE_MS) == 0) machine_suspend(m, (unsigned)suspend_age);
+        if (!fgets(line, sizeof(line), stdin)) break;
+        char image[256];
+        unsigned frames = default_frames;
+        if (sscanf(line, "%255s %u", image, &frames) < 1 || image[0] == '#') continue;
+
+        while (running >= parallel) running -= reap_job(slots, parallel);
+        unsigned slot = 0;
+        while (slots[slot].pid) slot++;
+
+        char job_coverage[MACHINE_PATH_MAX + 16] = "";
+        char job_trace[MACHINE_PATH_MAX + 16] = "";
+        if (coverage_path) snprintf(job_coverage, sizeof(job_coverage), "%s.%u", coverage_path, job);
+        if (trace_path) snprintf(job_trace, sizeof(job_trace), "%s.%u", trace_path, job);
+        // Expand suspended RAM once, here, so every job shares the resident
+        // template pages copy-on-write instead of inflating its own copy
+        if (!memory_resume(m->mem)) {
+            printf("Failed to resume the template's RAM\n");
+            break;
+        }
+        fflush(stdout); // Do not duplicate buffered output into the child
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            break;
+        }
+        if (pid == 0) run_job(m, image, frames, job_coverage, job_trace);
+
+        slots[slot].pid = pid;
+        slots[slot].job = job++;
+        snprintf(slots[slot].image, sizeof(slots[slot].image), "%s", image);
+        clock_gettime(CLOCK_MONOTONIC, &slots[slot].start);
+        running++;
+    }
+    while (running > 0) running -= reap_job(slots, parallel);
+    free(slots);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* rom_path = "riscos.rom";
+    unsigned frames = 3000, boot_frames = 0, parallel = 1;
+    bool server = false, dedup = false, export_state = false;
+    int suspend_age = -1;
+    unsigned watchdog_seconds = 10, block = 1;
+    const cpu_engine_t* engine = NULL;
+    const char* gdb_address = NULL;
+    const char* coverage_path = NULL;
+    const char* trace_path = NULL;
+    const char* hash_path = NULL;
+    hash_log_t hash = { NULL, UINT_MAX };
+    const char* load_path = NULL;
+    const char* save_path = NULL;
+    bool save_mapped = false;
+    const char* profile_name = NULL;
+    bool log_steps = false;
+    debug_option_t debug_options[MAX_DEBUG_OPTIONS];
+    unsigned debug_count = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:f:sb:j:mez:w:d:k:B:W:R:g:c:t:H:I:L:S:MP:l")) != -1) {
+        switch (opt) {
+        case 'r': rom_path = optarg; break;
+        case 'f': frames = (unsigned)atoi(optarg); break;
+        case 's': server = true; break;
+        case 'b': boot_frames = (unsigned)atoi(optarg); break;
+        case 'j': parallel = (unsigned)atoi(optarg); break;
+        case 'm': dedup = true; break;
+        case 'e': export_state = true; break;
+        case 'w': watchdog_seconds = (unsigned)atoi(optarg); break;
+        case 'z': suspend_age = atoi(optarg); break;
+        case 'd':
+            engine = cpu_engine_find(optarg);
+            if (!engine) {
+                fprintf(stderr, "Unknown CPU engine: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'k': block = (unsigned)atoi(optarg); break;
+        case 'g': gdb_address = optarg; break;
+        case 'c': coverage_path = optarg; break;
+        case 't': trace_path = optarg; break;
+        case 'H': hash_path = optarg; break;
+        case 'I': hash.step_frame = (unsigned)atoi(optarg); break;
+        case 'L': load_path = optarg; break;
+        case 'S': save_path = optarg; break;
+        case 'M': save_mapped = true; break;
+        case 'P': profile_name = optarg; break;
+        case 'l': log_steps = true; break;
+        case 'B': case 'W': case 'R':
+            if (debug_count < MAX_DEBUG_OPTIONS) debug_options[debug_count++] = { opt, optarg };
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r rom] [-f frames] [-w seconds] [-m] [-e] [-d engine [-k count]] [-B addr] [-W|-R addr[:len]] [-g port|path] [-c file] [-t file] [-H file [-I frame]] [-L file] [-S file [-M]] [-P name] [-l] [-s [-b frames] [-j count] [-z seconds]] [image]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (server && export_state) {
+        fprintf(stderr, "-e cannot be used with -s: forked jobs would all write the exported RAM\n");
+        return 2;
+    }
+    if (server && engine) {
+        fprintf(stderr, "-d cannot be used with -s\n");
+        return 2;
+    }
+    if (gdb_address && (server || engine)) {
+        fprintf(stderr, "-g cannot be used with -s or -d\n");
+        return 2;
+    }
+    if (hash_path && (server || engine || gdb_address)) {
+        fprintf(stderr, "-H cannot be used with -s, -d or -g\n");
+        return 2;
+    }
+    if (parallel < 1) parallel = 1;
+    if (parallel > MAX_PARALLEL_JOBS) parallel = MAX_PARALLEL_JOBS;
+    const char* image = optind < argc ? argv[optind] : NULL;
+
+    // The render thread pool is never enabled here: its workers would not
+    // survive fork()
+    machine_t* m = machine_create(rom_path, image, image);
+    if (!m) return 1;
+    memory_set_mergeable(m->mem, dedup); // Inherited by forked jobs
+    m->cpu->log_steps = log_steps;
+    if (profile_name && !machine_use_profile(m, profile_name)) {
+        machine_destroy(m);
+        return 2;
+    }
+
+    watchdog_config_t watchdog = {};
+    watchdog.stuck_frames = watchdog_seconds * 50;
+    watchdog.stuck_range = 256;
+    watchdog.fault_repeats = 1000;
+    watchdog.blank_frames = image ? 0 : watchdog_seconds * 50; // HLE images have no display
+    machine_set_watchdog(m, &watchdog);
+    for (unsigned i = 0; i < debug_count; i++) {
+        if (!add_debug_point(machine_debug(m), &debug_options[i])) {
+            machine_destroy(m);
+            return 2;
+        }
+    }
+    // Forked jobs open their own trace; the template's would be shared
+    if (trace_path && !server && !machine_trace(m, trace_path)) {
+        machine_destroy(m);
+        return 1;
+    }
+    if (coverage_path && !machine_coverage(m)) {
+        machine_destroy(m);
+        return 1;
+    }
+    if (hash_path) {
+        hash.file = fopen(hash_path, "w");
+        if (!hash.file) {
+            printf("Failed to open hash log %s\n", hash_path);
+            machine_destroy(m);
+            return 1;
+        }
+    }
+    if (export_state && !machine_export(m)) {
+        machine_destroy(m);
+        return 1;
+    }
+    // Snapshots use all CPUs, except in the fork server: workers would not
+    // survive fork()
+    threadpool_t* snapshot_pool = NULL;
+    if ((load_path || save_path) && !server) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        snapshot_pool = threadpool_create(cpus > 0 ? (unsigned)cpus : 1);
+    }
+    if (load_path && !snapshot_load_file(m, snapshot_pool, load_path)) {
+        threadpool_destroy(snapshot_pool);
+        machine_destroy(m);
+        return 1;
+    }
+
+    int status;
+    if (server) {
+        if (boot_frames) run_machine(m, boot_frames, NULL, NULL, NULL);
+        if (save_path && !save_snapshot(m, NULL, save_path, save_mapped)) {
+            machine_destroy(m);
+            return 1;
+        }
+        status = fork_server(m, frames, parallel, suspend_age, coverage_path, trace_path);
+    } else if (engine) {
+        lockstep_t lockstep;
+        if (!lockstep_init(&lockstep, m, cpu_engine_find("interp"), engine, block)) {
+            machine_destroy(m);
+            return 1;
+        }
+        status = run_machine(m, frames, &lockstep, NULL, NULL);
+        if (status != EXIT_DIVERGED) {
+            printf("Lockstep: %llu instructions agreed\n", (unsigned long long)lockstep.steps);
+        }
+        lockstep_release(&lockstep);
+    } else if (gdb_address) {
+        gdbstub_t* gdb = gdbstub_create(m, gdb_address, true);
+        if (!gdb) {
+            machine_destroy(m);
+            return 1;
+        }
+        status = run_machine(m, frames, NULL, gdb, NULL);
+        gdbstub_destroy(gdb);
+    } else {
+        status = run_machine(m, frames, NULL, NULL, hash.file ? &hash : NULL);
+    }
+    if (hash.file && fclose(hash.file) != 0) {
+        printf("Failed to write hash log %s\n", hash_path);
+        status = 1;
+    }
+    if (coverage_path && !server && !coverage_save(m->cpu->coverage, coverage_path)) status = 1;
+    if (save_path && !server && !save_snapshot(m, snapshot_pool, save_path, save_mapped)) status = 1;
+    threadpool_destroy(snapshot_pool);
+    machine_destroy(m);
+    return status;
+}
@@ -0,0 +1,154 @@
+#include "hle.h"
+#include "cpu.h"
+#include "io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// RISC OS SWI numbers serviced natively
+#define OS_WRITEC              0x00
+#define OS_WRITES              0x01
+#define OS_WRITE0              0x02
+#define OS_NEWLINE             0x03
+#define OS_GETENV              0x10
+#define OS_EXIT                0x11
+#define OS_GENERATEERROR       0x2B
+#define OS_READMONOTONICTIME   0x42
+#define OS_READMEMMAPINFO      0x51
+
+// AIF header word indices
+#define AIF_DECOMPRESS   0
+#define AIF_SELFRELOC    1
+#define AIF_ZEROINIT     2
+#define AIF_ENTRY        3
+#define AIF_EXIT         4
+#define AIF_RO_SIZE      5
+#define AIF_RW_SIZE      6
+#define AIF_ZEROINIT_SIZE 8
+#define AIF_IMAGE_BASE   10
+
+bool hle_load_image(arm3_cpu_t* cpu, const char* path, const char* command_line) {
+    memory_t* mem = cpu->mem;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Failed to open image: %s\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+
+    uint32_t header[AIF_HEADER_SIZE / 4] = { 0 };
+    size_t header_read = fread(header, 1, sizeof(header), file);
+    rewind(file);
+    bool aif = header_read == sizeof(header) && (header[AIF_EXIT] & ~SWI_X_BIT) == AIF_EXIT_SWI;
+    uint32_t base = aif ? (header[AIF_IMAGE_BASE] & ADDR_MASK) : HLE_LOAD_ADDRESS;
+    if (base >= HLE_MEMORY_LIMIT || size > HLE_MEMORY_LIMIT - base) {
+        printf("Image %s (%zu bytes at 0x%08X) does not fit below 0x%08X\n", path, size, base, HLE_MEMORY_LIMIT);
+        fclose(file);
+        return false;
+    }
+    size_t read = fread(mem->ram + base, 1, size, file);
+    fclose(file);
+    if (read != size) {
+        printf("Warning: Incomplete image read (%zu of %zu bytes)\n", read, size);
+    }
+    memset(mem->page_dirty, PAGE_DIRTY_ALL, sizeof(mem->page_dirty));
+
+    cpu_reset(cpu);
+    uint32_t entry = base;
+    if (aif && header[AIF_DECOMPRESS] == AIF_NOP && header[AIF_SELFRELOC] == AIF_NOP) {
+        // Do the header's zero-init natively and enter the program directly,
+        // returning to the header's OS_Exit
+        uint32_t zero_start = base + header[AIF_RO_SIZE] + header[AIF_RW_SIZE];
+        uint32_t zero_size = header[AIF_ZEROINIT_SIZE];
+        if (zero_start < HLE_MEMORY_LIMIT && zero_size <= HLE_MEMORY_LIMIT - zero_start) {
+            memset(mem->ram + zero_start, 0, zero_size);
+        }
+        uint32_t offset = (header[AIF_ENTRY] & 0x00FFFFFF) << 2; // Entry BL, decoded as cpu_step does
+        if (offset & 0x02000000) offset |= 0xFC000000;
+        entry = (base + AIF_ENTRY * 4 + 8 + offset) & ADDR_MASK;
+        cpu->registers[14] = base + AIF_EXIT * 4;
+    } else if (aif) {
+        printf("AIF %s is compressed or self-relocating, running its header code\n", path);
+    }
+
+    // Environment for OS_GetEnv: command line and start time (5 bytes)
+    snprintf((char*)mem->ram + HLE_ENV_BASE, 256, "%s", command_line ? command_line : path);
+    memset(mem->ram + HLE_ENV_BASE + 256, 0, 8);
+
+    cpu->registers[13] = HLE_MEMORY_LIMIT;
+    cpu->registers[15] = entry;
+    cpu->cpsr = MODE_USR | PSR_I | PSR_F; // No ROM, so no interrupt handlers
+    cpu->hle_os = true;
+    printf("Loaded %s %s: %zu bytes at 0x%08X, entry 0x%08X\n", aif ? "AIF" : "binary", path, size, base, entry);
+    return true;
+}
+
+static void halt(arm3_cpu_t* cpu, uint32_t exit_code) {
+    cpu_stop(cpu, CPU_STOP_EXIT);
+    cpu->exit_code = exit_code;
+    fflush(stdout);
+}
+
+// Print a NUL-terminated guest string, returning the address after the terminator
+static uint32_t write_string(arm3_cpu_t* cpu, uint32_t address) {
+    uint8_t c;
+    while ((c = memory_read_byte(cpu->mem, address++)) != 0) fputc(c, stdout);
+    return address;
+}
+
+int hle_os_swi(arm3_cpu_t* cpu, uint32_t swi, uint32_t swi_address) {
+    uint32_t* r = cpu->registers;
+    cpu->cpsr &= ~PSR_V;
+    switch (swi & ~SWI_X_BIT) {
+        case OS_WRITEC:
+            fputc(r[0] & 0xFF, stdout);
+            return 1;
+        case OS_WRITES:
+            // String follows the SWI; resume at the next word boundary
+            r[15] = (write_string(cpu, swi_address + 4) + 3) & ~3u;
+            return 1;
+        case OS_WRITE0:
+            r[0] = write_string(cpu, r[0]);
+            return 1;
+        case OS_NEWLINE:
+            fputc('\n', stdout);
+            return 1;
+        case OS_GETENV:
+            r[0] = HLE_ENV_BASE;
+            r[1] = HLE_MEMORY_LIMIT;
+            r[2] = HLE_ENV_BASE + 256;
+            return 1;
+        case OS_EXIT:
+            halt(cpu, r[1] == HLE_EXIT_ABEX ? r[2] : 0);
+            return 1;
+        case OS_GENERATEERROR:
+            if (swi & SWI_X_BIT) {
+                cpu->cpsr |= PSR_V; // XOS_GenerateError: hand the block in R0 back to the caller
+                return 1;
+            }
+            // No error handler without a ROM: report it and stop
+            printf("Guest error 0x%X: ", memory_read_word(cpu->mem, r[0]));
+            write_string(cpu, r[0] + 4);
+            fputc('\n', stdout);
+            halt(cpu, 1);
+            return 1;
+        case OS_READMONOTONICTIME:
+            r[0] = (uint32_t)(cpu->io->cycles / 80000); // Centiseconds at 8 MHz
+            return 1;
+        case OS_READMEMMAPINFO:
+            r[0] = PAGE_SIZE;
+            r[1] = RAM_SIZE / PAGE_SIZE;
+            return 1;
+        default:
+            printf("Unsupported SWI 0x%06X at 0x%08X in HLE mode, stopping\n", swi, swi_address);
+            halt(cpu, 0xFFFFFFFF);
+            return 1;
+    }
+}
+
+void hle_os_undefined(arm3_cpu_t* cpu, uint32_t instr, uint32_t address) {
+    printf("Undefined instruction 0x%08X at 0x%08X in HLE mode, stopping\n", instr, address);
+    halt(cpu, 0xFFFFFFFF);
+}
@@ -0,0 +1,25 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include <cstdint>
+
+struct arm3_cpu;
+
+// Minimal high-level OS environment for running plain ARM programs without a ROM
+#define HLE_LOAD_ADDRESS 0x00008000 // Application space start (raw binaries load here)
+#define HLE_ENV_BASE     0x00007000 // Command line and start time for OS_GetEnv
+#define HLE_MEMORY_LIMIT 0x00800000 // Top of application space, initial R13
+#define HLE_EXIT_ABEX    0x58454241 // "ABEX": OS_Exit R2 holds a return code
+
+// AIF header (128 bytes at the image base)
+#define AIF_HEADER_SIZE  128
+#define AIF_NOP          0xE1A00000 // MOV R0, R0
+#define AIF_EXIT_SWI     0xEF000011 // SWI OS_Exit in word 4 identifies an AIF
+
+// Load an AIF or raw binary and point the CPU at it; enables cpu->hle_os
+bool hle_load_image(struct arm3_cpu* cpu, const char* path, const char* command_line);
+int hle_os_swi(struct arm3_cpu* cpu, uint32_t swi, uint32_t swi_address); // 1 = handled
+// Undefined instruction trap: there is no handler to take it, so report and stop
+void hle_os_undefined(struct arm3_cpu* cpu, uint32_t instr, uint32_t address);
+
+#endif
@@ -0,0 +1,539 @@
+#include "hostfs.h"
+#include "cpu.h"
+#include "memory.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Module layout (see module_code): entry veneers, error block, strings
+#define MODULE_VENEERS 0x58
+#define MODULE_ERROR 0xC4
+#define MODULE_ERROR_SIZE 64
+#define MODULE_TITLE 0x104
+#define MODULE_HELP 0x10C
+#define MODULE_STARTUP 0x128
+#define MODULE_SIZE 0x14C
+
+// SWI offsets within the chunk, one per FS entry point
+enum {
+    HOSTFS_OPEN, HOSTFS_GETBYTES, HOSTFS_PUTBYTES, HOSTFS_ARGS,
+    HOSTFS_CLOSE, HOSTFS_FILE, HOSTFS_FUNC,
+};
+
+// FileSwitch error codes, reported as 0x10000 | FS number << 8 | code
+#define ERR_NOT_FOUND 0xD6
+#define ERR_TOO_MANY_OPEN 0xC0
+#define ERR_ACCESS 0xBD
+#define ERR_CHANNEL 0xDE
+
+#define FILETYPE_DATA 0xFFD
+#define OBJECT_FILE 1
+#define OBJECT_DIR 2
+#define ATTR_DEFAULT 0x03         // Owner read/write
+#define OPEN_READ (1u << 30)      // FSEntry_Open information word bits
+#define OPEN_WRITE (1u << 31)
+#define OPEN_BUFFER 1024          // FileSwitch buffer size (power of two): block GetBytes/PutBytes
+#define EPOCH_1900_TO_1970 2208988800ULL
+
+// resolve() results
+#define PATH_MISSING 0
+#define PATH_EXISTS 1
+#define PATH_INVALID 2
+
+// Relocatable module: FS information block plus one SWI veneer per entry point
+static const uint32_t module_code[] = {
+    0x00000000, // 0x00: Start code
+    0x00000090, // 0x04: Initialisation
+    0x000000AC, // 0x08: Finalisation
+    0x00000000, // 0x0C: Service call handler
+    0x00000104, // 0x10: Title string
+    0x0000010C, // 0x14: Help string
+    0x00000000, // 0x18: Command table
+    0x00000000, // 0x1C: SWI chunk
+    0x00000000, // 0x20: SWI handler
+    0x00000000, // 0x24: SWI decoding table
+    0x00000000, // 0x28: SWI decoding code
+    0x00000104, // 0x2C: FS name
+    0x00000128, // 0x30: Startup text
+    0x00000058, // 0x34: FSEntry_Open
+    0x00000060, // 0x38: FSEntry_GetBytes
+    0x00000068, // 0x3C: FSEntry_PutBytes
+    0x00000070, // 0x40: FSEntry_Args
+    0x00000078, // 0x44: FSEntry_Close
+    0x00000080, // 0x48: FSEntry_File
+    0x00000099, // 0x4C: Information word: FS number 0x99
+    0x00000088, // 0x50: FSEntry_Func
+    0x00000000, // 0x54: FSEntry_GBPB (not supported)
+    0xEF078EC0, // 0x58: SWI XHostFS_Open
+    0xE1A0F00E, // 0x5C: MOV PC, R14
+    0xEF078EC1, // 0x60: SWI XHostFS_GetBytes
+    0xE1A0F00E, // 0x64: MOV PC, R14
+    0xEF078EC2, // 0x68: SWI XHostFS_PutBytes
+    0xE1A0F00E, // 0x6C: MOV PC, R14
+    0xEF078EC3, // 0x70: SWI XHostFS_Args
+    0xE1A0F00E, // 0x74: MOV PC, R14
+    0xEF078EC4, // 0x78: SWI XHostFS_Close
+    0xE1A0F00E, // 0x7C: MOV PC, R14
+    0xEF078EC5, // 0x80: SWI XHostFS_File
+    0xE1A0F00E, // 0x84: MOV PC, R14
+    0xEF078EC6, // 0x88: SWI XHostFS_Func
+    0xE1A0F00E, // 0x8C: MOV PC, R14
+    0xE92D4000, // 0x90: STMFD R13!, {R14}
+    0xE3A0000C, // 0x94: MOV R0, #12 ; FSControl_AddFS
+    0xE24F10A0, // 0x98: SUB R1, PC, #0xA0 ; module base
+    0xE3A0202C, // 0x9C: MOV R2, #0x2C ; FS information block
+    0xE3A03000, // 0xA0: MOV R3, #0
+    0xEF020029, // 0xA4: SWI XOS_FSControl
+    0xE8BD8000, // 0xA8: LDMFD R13!, {PC}
+    0xE92D4000, // 0xAC: STMFD R13!, {R14}
+    0xE3A00010, // 0xB0: MOV R0, #16 ; FSControl_RemoveFS
+    0xE28F1048, // 0xB4: ADD R1, PC, #0x48 ; FS name
+    0xEF020029, // 0xB8: SWI XOS_FSControl
+    0xE1500000, // 0xBC: CMP R0, R0 ; clear V
+    0xE8BD8000, // 0xC0: LDMFD R13!, {PC}
+};
+
+size_t hostfs_module_image(uint8_t* out, size_t size) {
+    static const char title[] = "HostFS";
+    static const char help[] = "HostFS\t\t0.01 (18 Oct 2026)";
+    static const char startup[] = "Acorn Archimedes host filing system";
+    if (!out || size < MODULE_SIZE) return MODULE_SIZE;
+    memset(out, 0, MODULE_SIZE);
+    memcpy(out, module_code, sizeof(module_code));
+    memcpy(out + MODULE_TITLE, title, sizeof(title));
+    memcpy(out + MODULE_HELP, help, sizeof(help));
+    memcpy(out + MODULE_STARTUP, startup, sizeof(startup));
+    return MODULE_SIZE;
+}
+
+hostfs_t* hostfs_create(const char* root) {
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        printf("HostFS disabled: no directory %s\n", root);
+        return NULL;
+    }
+    hostfs_t* fs = (hostfs_t*)calloc(1, sizeof(hostfs_t));
+    if (!fs) {
+        printf("Failed to allocate HostFS\n");
+        return NULL;
+    }
+    char* real = realpath(root, NULL); // Canonical, for the containment check in resolve
+    snprintf(fs->root, sizeof(fs->root), "%s", real ? real : root);
+    free(real);
+
+    // Drop the guest module into the shared directory so it can be *RMLoaded
+    char module_path[HOSTFS_PATH_MAX];
+    snprintf(module_path, sizeof(module_path), "%s/HostFS,ffa", root);
+    if (access(module_path, F_OK) != 0) {
+        uint8_t image[MODULE_SIZE];
+        hostfs_module_image(image, sizeof(image));
+        FILE* file = fopen(module_path, "wb");
+        if (file) {
+            fwrite(image, 1, sizeof(image), file);
+            fclose(file);
+        }
+    }
+    printf("HostFS serving %s\n", root);
+    return fs;
+}
+
+void hostfs_close_all(hostfs_t* fs) {
+    if (!fs) return;
+    for (int i = 0; i < HOSTFS_MAX_FILES; i++) {
+        if (fs->files[i].file) fclose(fs->files[i].file);
+        fs->files[i].file = NULL;
+    }
+}
+
+void hostfs_destroy(hostfs_t* fs) {
+    if (!fs) return;
+    hostfs_close_all(fs);
+    free(fs);
+}
+
+// RISC OS timestamps are centiseconds since 1900, split over load and exec
+static void stamp(uint32_t type, time_t mtime, uint32_t* load, uint32_t* exec) {
+    uint64_t cs = ((uint64_t)mtime + EPOCH_1900_TO_1970) * 100;
+    *load = 0xFFF00000 | (type << 8) | (uint32_t)((cs >> 32) & 0xFF);
+    *exec = (uint32_t)cs;
+}
+
+// Host names carry the filetype as a ",xxx" suffix; returns -1 when absent
+static int name_filetype(const char* name, size_t* base_len) {
+    size_t len = strlen(name);
+    *base_len = len;
+    if (len < 5 || name[len - 4] != ',') return -1;
+    char* end;
+    long type = strtol(name + len - 3, &end, 16);
+    if (*end) return -1;
+    *base_len = len - 4;
+    return (int)type;
+}
+
+// Guest RAM is handed straight to stdio, so reads land without a bounce buffer
+static uint8_t* guest_ram(memory_t* mem, uint32_t address, uint32_t length, bool write) {
+    address &= ADDR_MASK;
+    if (address >= RAM_SIZE || length > RAM_SIZE - address) return NULL;
+    if (write && length) {
+        for (uint32_t page = address >> PAGE_SHIFT; page <= (address + length - 1) >> PAGE_SHIFT; page++) {
+            mem->page_dirty[page] = PAGE_DIRTY_ALL;
+        }
+    }
+    return mem->ram + address;
+}
+
+// Read a control-character terminated string from guest RAM
+static bool read_guest_string(memory_t* mem, uint32_t address, char* out, size_t size) {
+    address &= ADDR_MASK;
+    for (size_t i = 0; i < size && address + i < RAM_SIZE; i++) {
+        uint8_t c = mem->ram[address + i];
+        if (c < 32) {
+            out[i] = 0;
+            return true;
+        }
+        out[i] = (char)c;
+    }
+    out[size - 1] = 0;
+    return false;
+}
+
+// Find a host entry matching a RISC OS leaf name, ignoring case and type suffix
+static bool match_leaf(const char* dir, const char* leaf, char* out, size_t size) {
+    DIR* handle = opendir(dir);
+    if (!handle) return false;
+    bool found = false;
+    size_t leaf_len = strlen(leaf);
+    struct dirent* entry;
+    while (!found && (entry = readdir(handle)) != NULL) {
+        size_t len;
+        name_filetype(entry->d_name, &len);
+        if (len == leaf_len && strncasecmp(entry->d_name, leaf, len) == 0) {
+            snprintf(out, size, "%s", entry->d_name);
+            found = true;
+        }
+    }
+    closedir(handle);
+    return found;
+}
+
+// Whether a host path that exists resolves (through symlinks) inside the root
+static bool under_root(hostfs_t* fs, const char* path) {
+    char* real = realpath(path, NULL);
+    size_t len = strlen(fs->root);
+    bool inside = real && strncmp(real, fs->root, len) == 0 && (real[len] == '/' || real[len] == 0);
+    free(real);
+    return inside;
+}
+
+// Translate "$.dir.file/txt" into a host path under the root. Returns
+// PATH_MISSING if any component is missing (path then ends in the untranslated
+// leaf for creation), PATH_INVALID for names that would leave the root.
+static int resolve(hostfs_t* fs, const char* name, char* path, size_t size) {
+    if (name[0] == '$') name += (name[1] == '.') ? 2 : 1;
+    snprintf(path, size, "%s", fs->root);
+    bool exists = true;
+    size_t found = strlen(path); // Length of the deepest existing prefix
+    while (*name) {
+        char leaf[256];
+        size_t len = 0;
+        while (*name && *name != '.' && len < sizeof(leaf) - 1) {
+            leaf[len++] = (*name == '/') ? '.' : *name;
+            name++;
+        }
+        leaf[len] = 0;
+        if (*name == '.') name++;
+        // "/" maps to ".", so guest leaves "", "/" and "//" would name the host's own links
+        if (!leaf[0] || strcmp(leaf, ".") == 0 || strcmp(leaf, "..") == 0) return PATH_INVALID;
+        char match[256];
+        size_t used = strlen(path);
+        if (exists && match_leaf(path, leaf, match, sizeof(match))) {
+            snprintf(path + used, size - used, "/%s", match);
+            found = strlen(path);
+        } else {
+            snprintf(path + used, size - used, "/%s", leaf);
+            exists = false;
+        }
+    }
+    char existing[HOSTFS_PATH_MAX];
+    snprintf(existing, sizeof(existing), "%.*s", (int)found, path);
+    if (!under_root(fs, existing)) return PATH_INVALID;
+    return exists ? PATH_EXISTS : PATH_MISSING;
+}
+
+// Fill RISC OS catalogue information for a host object; returns the object type
+static uint32_t object_info(const char* path, uint32_t* load, uint32_t* exec,
+                            uint32_t* length, uint32_t* attr) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    const char* leaf = strrchr(path, '/');
+    size_t len;
+    int type = name_filetype(leaf ? leaf + 1 : path, &len);
+    stamp(type < 0 ? FILETYPE_DATA : (uint32_t)type, st.st_mtime, load, exec);
+    *length = S_ISDIR(st.st_mode) ? 0 : (uint32_t)st.st_size;
+    *attr = ATTR_DEFAULT;
+    return S_ISDIR(st.st_mode) ? OBJECT_DIR : OBJECT_FILE;
+}
+
+// Report an error through the module's error block with V set
+static int fail(arm3_cpu_t* cpu, uint32_t module, uint32_t code, const char* message) {
+    uint32_t block = module + MODULE_ERROR;
+    uint8_t* error = guest_ram(cpu->mem, block, MODULE_ERROR_SIZE, true);
+    if (error) {
+        uint32_t number = 0x10000 | (HOSTFS_FS_NUMBER << 8) | code;
+        memcpy(error, &number, sizeof(number));
+        snprintf((char*)error + 4, MODULE_ERROR_SIZE - 4, "%s", message);
+    }
+    cpu->registers[0] = block;
+    cpu->cpsr |= PSR_V;
+    return 1;
+}
+
+static hostfs_file_t* get_file(hostfs_t* fs, uint32_t handle) {
+    if (handle == 0 || handle > HOSTFS_MAX_FILES || !fs->files[handle - 1].file) return NULL;
+    return &fs->files[handle - 1];
+}
+
+static uint32_t file_extent(hostfs_file_t* f) {
+    struct stat st;
+    fflush(f->file);
+    return fstat(fileno(f->file), &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+static int fs_open(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module) {
+    uint32_t* r = cpu->registers;
+    char name[HOSTFS_PATH_MAX], path[HOSTFS_PATH_MAX];
+    read_guest_string(cpu->mem, r[1], name, sizeof(name));
+    int found = resolve(fs, name, path, sizeof(path));
+    bool exists = found == PATH_EXISTS;
+    struct stat st;
+    if (found == PATH_INVALID || (!exists && r[0] != 1) || (exists && stat(path, &st) == 0 && S_ISDIR(st.st_mode))) {
+        r[1] = 0; // Not found
+        return 1;
+    }
+    int slot = 0;
+    while (slot < HOSTFS_MAX_FILES && fs->files[slot].file) slot++;
+    if (slot == HOSTFS_MAX_FILES) return fail(cpu, module, ERR_TOO_MANY_OPEN, "Too many open files");
+
+    const char* mode = (r[0] == 0) ? "rb" : (r[0] == 1) ? "w+b" : "r+b";
+    FILE* file = fopen(path, mode);
+    if (!file) return fail(cpu, module, ERR_ACCESS, "Access violation");
+    setvbuf(file, NULL, _IOFBF, HOSTFS_IO_BUFFER);
+
+    hostfs_file_t* f = &fs->files[slot];
+    f->file = file;
+    f->ptr = 0;
+    snprintf(f->path, sizeof(f->path), "%s", path);
+    r[0] = OPEN_READ | (r[0] != 0 ? OPEN_WRITE : 0);
+    r[1] = (uint32_t)slot + 1;
+    r[2] = OPEN_BUFFER; // Buffered: transfers arrive as R2 address, R3 length, R4 offset
+    r[3] = file_extent(f);
+    r[4] = r[3];
+    return 1;
+}
+
+static int fs_transfer(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module, bool write) {
+    uint32_t* r = cpu->registers;
+    hostfs_file_t* f = get_file(fs, r[1]);
+    if (!f) return fail(cpu, module, ERR_CHANNEL, "Channel");
+    uint8_t* data = guest_ram(cpu->mem, r[2], r[3], !write);
+    if (!data) return fail(cpu, module, ERR_ACCESS, "Bad address");
+    fseek(f->file, r[4], SEEK_SET);
+    size_t done = write ? fwrite(data, 1, r[3], f->file) : fread(data, 1, r[3], f->file);
+    if (!write && done < r[3]) memset(data + done, 0, r[3] - done);
+    f->ptr = r[4] + (uint32_t)done;
+    return 1;
+}
+
+static int fs_args(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module) {
+    uint32_t* r = cpu->registers;
+    hostfs_file_t* f = get_file(fs, r[1]);
+    if (!f) return fail(cpu, module, ERR_CHANNEL, "Channel");
+    switch (r[0]) {
+        case 0: r[2] = f->ptr; break;                                    // Read PTR
+        case 1: f->ptr = r[2]; break;                                    // Write PTR
+        case 2: case 4: r[2] = file_extent(f); break;                    // Read EXT / allocation
+        case 3:                                                          // Write EXT
+            fflush(f->file);
+            if (ftruncate(fileno(f->file), r[2]) != 0) return fail(cpu, module, ERR_ACCESS, "Access violation");
+            break;
+        case 5: r[2] = (f->ptr >= file_extent(f)) ? 0xFFFFFFFF : 0; break; // EOF
+        case 6: fflush(f->file); break;                                  // Flush
+        case 7:                                                          // Ensure size
+            if (file_extent(f) < r[2] && ftruncate(fileno(f->file), r[2]) != 0) {
+                return fail(cpu, module, ERR_ACCESS, "Access violation");
+            }
+            r[2] = file_extent(f);
+            break;
+        case 8: {                                                        // Write zeros
+            static const uint8_t zeros[4096] = { 0 };
+            fseek(f->file, r[2], SEEK_SET);
+            for (uint32_t left = r[3]; left;) {
+                uint32_t chunk = left < sizeof(zeros) ? left : (uint32_t)sizeof(zeros);
+                fwrite(zeros, 1, chunk, f->file);
+                left -= chunk;
+            }
+            break;
+        }
+        case 9: {                                                        // Read datestamp
+            uint32_t length, attr;
+            object_info(f->path, &r[2], &r[3], &length, &attr);
+            break;
+        }
+    }
+    return 1;
+}
+
+static int fs_close(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module) {
+    hostfs_file_t* f = get_file(fs, cpu->registers[1]);
+    if (!f) return fail(cpu, module, ERR_CHANNEL, "Channel");
+    fclose(f->file);
+    f->file = NULL;
+    return 1;
+}
+
+static int fs_file(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module) {
+    uint32_t* r = cpu->registers;
+    char name[HOSTFS_PATH_MAX], path[HOSTFS_PATH_MAX];
+    read_guest_string(cpu->mem, r[1], name, sizeof(name));
+    int found = resolve(fs, name, path, sizeof(path));
+    if (found == PATH_INVALID) return fail(cpu, module, ERR_ACCESS, "Access violation");
+    bool exists = found == PATH_EXISTS;
+
+    switch (r[0]) {
+        case 0: case 7: {                                                // Save / create
+            if (!exists && (r[2] >> 20) == 0xFFF) {
+                size_t used = strlen(path);
+                snprintf(path + used, sizeof(path) - used, ",%03x", (r[2] >> 8) & 0xFFF);
+            }
+            uint32_t length = r[5] - r[4];
+            const uint8_t* data = (r[0] == 0) ? guest_ram(cpu->mem, r[4], length, false) : NULL;
+            if (r[0] == 0 && !data) return fail(cpu, module, ERR_ACCESS, "Bad address");
+            FILE* file = fopen(path, "wb");
+            if (!file) return fail(cpu, module, ERR_ACCESS, "Access violation");
+            bool ok = data ? fwrite(data, 1, length, file) == length : ftruncate(fileno(file), length) == 0;
+            fclose(file);
+            if (!ok) return fail(cpu, module, ERR_ACCESS, "Access violation");
+            r[6] = 0;
+            break;
+        }
+        case 5:                                                          // Read catalogue info
+            r[0] = exists ? object_info(path, &r[2], &r[3], &r[4], &r[5]) : 0;
+            break;
+        case 6:                                                          // Delete
+            r[0] = exists ? object_info(path, &r[2], &r[3], &r[4], &r[5]) : 0;
+            if (r[0] && (r[0] == OBJECT_DIR ? rmdir(path) : remove(path)) != 0) {
+                return fail(cpu, module, ERR_ACCESS, "Access violation");
+            }
+            break;
+        case 8:                                                          // Create directory
+            if (!exists && mkdir(path, 0777) != 0) return fail(cpu, module, ERR_ACCESS, "Access violation");
+            break;
+        case 255: {                                                      // Load
+            uint32_t address = r[2];
+            if (!exists || object_info(path, &r[2], &r[3], &r[4], &r[5]) != OBJECT_FILE) {
+                return fail(cpu, module, ERR_NOT_FOUND, "File not found");
+            }
+            uint8_t* data = guest_ram(cpu->mem, address, r[4], true);
+            if (!data) return fail(cpu, module, ERR_ACCESS, "Bad address");
+            FILE* file = fopen(path, "rb");
+            if (!file) return fail(cpu, module, ERR_ACCESS, "Access violation");
+            setvbuf(file, NULL, _IONBF, 0); // Single bulk read straight into guest RAM
+            size_t read = fread(data, 1, r[4], file);
+            fclose(file);
+            if (read != r[4]) return fail(cpu, module, ERR_ACCESS, "Read error");
+            r[6] = r[1];
+            break;
+        }
+        default:                                                         // Attributes live in the host name
+            break;
+    }
+    return 1;
+}
+
+// Func 14/15: enumerate a directory into a guest buffer
+static int fs_read_dir(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module, bool with_info) {
+    uint32_t* r = cpu->registers;
+    char name[HOSTFS_PATH_MAX], path[HOSTFS_PATH_MAX];
+    read_guest_string(cpu->mem, r[1], name, sizeof(name));
+    if (resolve(fs, name, path, sizeof(path)) != PATH_EXISTS) return fail(cpu, module, ERR_NOT_FOUND, "Directory not found");
+    uint8_t* buffer = guest_ram(cpu->mem, r[2], r[5], true);
+    if (!buffer) return fail(cpu, module, ERR_ACCESS, "Bad address");
+    DIR* dir = opendir(path);
+    if (!dir) return fail(cpu, module, ERR_NOT_FOUND, "Directory not found");
+
+    uint32_t index = 0, count = 0, used = 0, next = 0xFFFFFFFF;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' && (!entry->d_name[1] || (entry->d_name[1] == '.' && !entry->d_name[2]))) continue;
+        if (index++ < r[4]) continue;
+        if (count == r[3]) {
+            next = index - 1;
+            break;
+        }
+        size_t len;
+        name_filetype(entry->d_name, &len);
+        uint32_t record = with_info ? 20 : 0;
+        uint32_t size = record + (uint32_t)len + 1;
+        if (with_info) size = (size + 3) & ~3u;
+        if (used + size > r[5]) {
+            next = index - 1;
+            break;
+        }
+        if (with_info) {
+            char full[HOSTFS_PATH_MAX + 256];
+            uint32_t info[5];
+            snprintf(full, sizeof(full), "%s/%s", path, entry->d_name);
+            info[4] = object_info(full, &info[0], &info[1], &info[2], &info[3]);
+            memcpy(buffer + used, info, sizeof(info));
+        }
+        for (size_t i = 0; i < len; i++) {
+            buffer[used + record + i] = (entry->d_name[i] == '.') ? '/' : (uint8_t)entry->d_name[i];
+        }
+        buffer[used + record + len] = 0;
+        used += size;
+        count++;
+    }
+    closedir(dir);
+    r[3] = count;
+    r[4] = next;
+    return 1;
+}
+
+static int fs_func(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t module) {
+    uint32_t* r = cpu->registers;
+    switch (r[0]) {
+        case 8: {                                                        // Rename
+            char from[HOSTFS_PATH_MAX], to[HOSTFS_PATH_MAX], name[HOSTFS_PATH_MAX];
+            read_guest_string(cpu->mem, r[1], name, sizeof(name));
+            bool exists = resolve(fs, name, from, sizeof(from)) == PATH_EXISTS;
+            read_guest_string(cpu->mem, r[2], name, sizeof(name));
+            bool valid = resolve(fs, name, to, sizeof(to)) != PATH_INVALID;
+            r[1] = (exists && valid && rename(from, to) == 0) ? 0 : 1;
+            return 1;
+        }
+        case 14: return fs_read_dir(fs, cpu, module, false);
+        case 15: return fs_read_dir(fs, cpu, module, true);
+        default: return 1;                                               // No-op for this FS
+    }
+}
+
+int hostfs_swi(hostfs_t* fs, arm3_cpu_t* cpu, uint32_t swi, uint32_t swi_address) {
+    uint32_t entry = (swi & ~SWI_X_BIT) - HOSTFS_SWI_BASE;
+    if (!fs || entry >= HOSTFS_SWI_COUNT) return 0;
+    uint32_t module = swi_address - (MODULE_VENEERS + entry * 8);
+    cpu->cpsr &= ~PSR_V;
+    switch (entry) {
+        case HOSTFS_OPEN: return fs_open(fs, cpu, module);
+        case HOSTFS_GETBYTES: return fs_transfer(fs, cpu, module, false);
+        case HOSTFS_PUTBYTES: return fs_transfer(fs, cpu, module, true);
+        case HOSTFS_ARGS: return fs_args(fs, cpu, module);
+        case HOSTFS_CLOSE: return fs_close(fs, cpu, module);
+        case HOSTFS_FILE: return fs_file(fs, cpu, module);
+        case HOSTFS_FUNC: return fs_func(fs, cpu, module);
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef HOSTFS_H
+#define HOSTFS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <stdio.h>
+
+struct arm3_cpu;
+
+// HostFS: a RISC OS filing system backed by a host directory. The guest side is
+// a tiny module (hostfs_module_image) whose FS entry points are single SWIs;
+// cpu_step hands those SWIs to hostfs_swi, which services them on the host.
+#define HOSTFS_SWI_BASE 0x58EC0   // SWI chunk used by the module's entry veneers
+#define HOSTFS_SWI_COUNT 7        // Open, GetBytes, PutBytes, Args, Close, File, Func
+#define HOSTFS_FS_NUMBER 0x99
+#define HOSTFS_MAX_FILES 64
+#define HOSTFS_PATH_MAX 1024
+#define HOSTFS_IO_BUFFER (64 * 1024) // Host stdio buffer per open file
+
+typedef struct {
+    FILE* file;                // NULL = free slot
+    uint32_t ptr;              // Sequential pointer (Args 0/1)
+    char path[HOSTFS_PATH_MAX];
+} hostfs_file_t;
+
+typedef struct hostfs {
+    char root[HOSTFS_PATH_MAX]; // Host directory mapped to $
+    hostfs_file_t files[HOSTFS_MAX_FILES]; // Guest handle = index + 1
+} hostfs_t;
+
+hostfs_t* hostfs_create(const char* root);
+void hostfs_destroy(hostfs_t* fs);
+void hostfs_close_all(hostfs_t* fs); // Guest handles do not survive a machine reset
+size_t hostfs_module_image(uint8_t* out, size_t size); // Returns bytes needed
+int hostfs_swi(hostfs_t* fs, struct arm3_cpu* cpu, uint32_t swi, uint32_t swi_address); // 1 = handled
+
+#endif
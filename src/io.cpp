@@ -1,40 +1,36 @@
 #include "io.h"
 #include "memory.h"
+#include "threadpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <libretro.h>
 
 // Use RAM_BASE from memory.h, no need to redefine
 // #define RAM_BASE 0x00000000 // Removed, already in memory.h
 
-io_t* io_create(uint32_t width, uint32_t height) {
-    io_t* io = (io_t*)malloc(sizeof(io_t));
-    if (!io) {
-        printf("Failed to allocate I/O struct\n");
-        return NULL;
-    }
-
-    // Initialize VIDC
-    io->vidc.control = 0;
-    memset(io->vidc.palette, 0, sizeof(io->vidc.palette));
-    io->vidc.palette[0] = 0x000; // Black
-    io->vidc.palette[1] = 0xF00; // Red
-    io->vidc.palette[2] = 0x0F0; // Green
-    io->vidc.palette[3] = 0x00F; // Blue
-    io->vidc.palette[4] = 0xFFF; // White
+bool io_init(io_t* io, uint32_t width, uint32_t height) {
+    // Initialize VIDC (raw register values for 640x480 at 50 Hz, 8 bpp, 24 MHz)
+    memset(&io->vidc, 0, sizeof(io->vidc));
+    io->vidc.control = 0x0F;        // 24 MHz pixel clock, 8 bpp
+    io->vidc.palette[0] = 0x000;    // Black
+    io->vidc.palette[1] = 0x00F;    // Red
+    io->vidc.palette[2] = 0x0F0;    // Green
+    io->vidc.palette[3] = 0xF00;    // Blue
+    io->vidc.palette[4] = 0xFFF;    // White
     io->vidc.border_color = 0;
     io->vidc.cursor_palette[0] = 0xFFF; // White cursor default
-    io->vidc.cursor_palette[1] = 0xF00; // Red
+    io->vidc.cursor_palette[1] = 0x00F; // Red
     io->vidc.cursor_palette[2] = 0x000; // Black
-    io->vidc.h_cycle = 832;         // Default: 832 cycles (e.g., 640 + borders)
-    io->vidc.h_sync_width = 64;
-    io->vidc.h_border_start = 64;
-    io->vidc.h_display_start = 128;
-    io->vidc.h_display_end = 768;   // 640 pixels display
-    io->vidc.h_border_end = 768;
+    io->vidc.h_cycle = 383;         // 768 pixels per line
+    io->vidc.h_sync_width = 35;
+    io->vidc.h_border_start = 52;
+    io->vidc.h_display_start = 59;
+    io->vidc.h_display_end = 379;   // 640 pixels display
+    io->vidc.h_border_end = 379;
     io->vidc.h_cursor_start = 0;
-    io->vidc.v_cycle = 625;         // Default: 625 lines (e.g., 480 + borders)
+    io->vidc.v_cycle = 624;         // 625 lines per frame
     io->vidc.v_sync_width = 2;
     io->vidc.v_border_start = 35;
     io->vidc.v_display_start = 70;
@@ -42,9 +38,14 @@ io_t* io_create(uint32_t width, uint32_t height) {
     io->vidc.v_border_end = 590;
     io->vidc.v_cursor_end = 0;
     io->vidc.sound_freq = 24;       // Default 24 µs (~41.67 kHz)
-    io->vidc.sound_control = 0;
-    io->vidc.video_base = 0x00000000;
     io->vidc.ext_latch_c = 0;       // Default 24 MHz, +ve sync
+    io->vidc.dirty = VIDC_DIRTY_PALETTE | VIDC_DIRTY_GEOMETRY | VIDC_DIRTY_TIMING;
+
+    // Initialize MEMC (640x480 8 bpp screen at the bottom of physical RAM)
+    memset(&io->memc, 0, sizeof(io->memc));
+    io->memc.vinit = 0;
+    io->memc.vstart = 0;
+    io->memc.vend = 640 * 480 - 16;
 
     // Initialize IOC
     io->ioc.control = 0;
@@ -65,100 +66,284 @@ io_t* io_create(uint32_t width, uint32_t height) {
     io->ioc.fiq_mask = 0;
     io->ioc.podule_irq_mask = 0;
     io->ioc.podule_irq_request = 0;
+    pcf8583_init(&io->cmos);
 
     // Frame buffer
     io->frame_width = width;
     io->frame_height = height;
+    io->frame_capacity = width * height;
     io->frame_buffer = (uint32_t*)malloc(width * height * sizeof(uint32_t));
     if (!io->frame_buffer) {
         printf("Failed to allocate frame buffer\n");
-        free(io);
-        return NULL;
+        return false;
     }
     memset(io->frame_buffer, 0, width * height * sizeof(uint32_t));
+    io->video_buffer = (uint16_t*)calloc(width * height, sizeof(uint16_t));
+    if (!io->video_buffer) {
+        printf("Failed to allocate video buffer\n");
+        free(io->frame_buffer);
+        return false;
+    }
+    io->render_full = 3;
+    io->render_pool = NULL;
 
     // Interrupts and timing
     io->irq_pending = false;
     io->fiq_pending = false;
     io->cycles = 0;
+    io->frame_count = 0;
+    io->accesses = 0;
 
     printf("I/O module initialized\n");
+    return true;
+}
+
+void io_release(io_t* io) {
+    pcf8583_save(&io->cmos);
+    threadpool_destroy(io->render_pool);
+    if (io->frame_buffer) free(io->frame_buffer);
+    if (io->video_buffer) free(io->video_buffer);
+    io->render_pool = NULL;
+    io->frame_buffer = NULL;
+    io->video_buffer = NULL;
+}
+
+io_t* io_create(uint32_t width, uint32_t height) {
+    io_t* io = (io_t*)malloc(sizeof(io_t));
+    if (!io) {
+        printf("Failed to allocate I/O struct\n");
+        return NULL;
+    }
+    if (!io_init(io, width, height)) {
+        free(io);
+        return NULL;
+    }
     return io;
 }
 
 void io_destroy(io_t* io) {
     if (io) {
-        if (io->frame_buffer) free(io->frame_buffer);
+        io_release(io);
         free(io);
     }
 }
 
+bool io_clone(io_t* io, const io_t* src) {
+    *io = *src;
+    io->frame_buffer = (uint32_t*)calloc(io->frame_capacity, sizeof(uint32_t));
+    io->video_buffer = (uint16_t*)calloc(io->frame_capacity, sizeof(uint16_t));
+    if (!io->frame_buffer || !io->video_buffer) {
+        printf("Failed to allocate frame buffers\n");
+        free(io->frame_buffer);
+        free(io->video_buffer);
+        return false;
+    }
+    io->render_full = 3;       // Fresh buffers, redraw everything
+    io->render_pool = NULL;    // Clones render on their own thread
+    io->cmos.path[0] = '\0';   // Only the original persists CMOS RAM
+    return true;
+}
+
+// VIDC register descriptor: where the data field lives and what it invalidates
+typedef struct {
+    const char* name;          // Register name (NULL = unused address)
+    uint16_t field;            // Offset of the target field in vidc_t
+    uint8_t shift;             // Position of the field in the data word
+    uint32_t mask;             // Field mask, applied after the shift
+    uint32_t dirty;            // VIDC_DIRTY_* caches depending on the field
+} vidc_reg_t;
+
+#define VIDC_FIELD(f) static_cast<uint16_t>(offsetof(vidc_t, f))
+#define VIDC_PAL(n) { "PAL" #n, VIDC_FIELD(palette[n]), 0, 0x1FFF, VIDC_DIRTY_PALETTE }
+#define VIDC_SIR(n) { "SIR" #n, VIDC_FIELD(stereo_image[n]), 0, 0x7, 0 }
+#define VIDC_TIMING(name, f, shift, mask, dirty) { name, VIDC_FIELD(f), shift, mask, dirty }
+#define VIDC_UNUSED { NULL, 0, 0, 0, 0 }
+
+// Decode table indexed by bits 31:26 of the data word written to VIDC
+static const vidc_reg_t vidc_regs[VIDC_REG_COUNT] = {
+    VIDC_PAL(0), VIDC_PAL(1), VIDC_PAL(2), VIDC_PAL(3),                   // 0x00
+    VIDC_PAL(4), VIDC_PAL(5), VIDC_PAL(6), VIDC_PAL(7),
+    VIDC_PAL(8), VIDC_PAL(9), VIDC_PAL(10), VIDC_PAL(11),
+    VIDC_PAL(12), VIDC_PAL(13), VIDC_PAL(14), VIDC_PAL(15),
+    { "BORDER", VIDC_FIELD(border_color), 0, 0x1FFF, 0 },                 // 0x10
+    { "CURSOR1", VIDC_FIELD(cursor_palette[0]), 0, 0x1FFF, 0 },
+    { "CURSOR2", VIDC_FIELD(cursor_palette[1]), 0, 0x1FFF, 0 },
+    { "CURSOR3", VIDC_FIELD(cursor_palette[2]), 0, 0x1FFF, 0 },
+    VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED,
+    VIDC_SIR(7), VIDC_SIR(0), VIDC_SIR(1), VIDC_SIR(2),                   // 0x18
+    VIDC_SIR(3), VIDC_SIR(4), VIDC_SIR(5), VIDC_SIR(6),
+    VIDC_TIMING("HCR", h_cycle, 14, 0x3FF, VIDC_DIRTY_TIMING),            // 0x20
+    VIDC_TIMING("HSWR", h_sync_width, 14, 0x3FF, 0),
+    VIDC_TIMING("HBSR", h_border_start, 14, 0x3FF, 0),
+    VIDC_TIMING("HDSR", h_display_start, 14, 0x3FF, VIDC_DIRTY_GEOMETRY),
+    VIDC_TIMING("HDER", h_display_end, 14, 0x3FF, VIDC_DIRTY_GEOMETRY),
+    VIDC_TIMING("HBER", h_border_end, 14, 0x3FF, 0),
+    VIDC_TIMING("HCSR", h_cursor_start, 13, 0x7FF, 0),
+    VIDC_TIMING("HIR", h_interlace, 14, 0x3FF, 0),
+    VIDC_TIMING("VCR", v_cycle, 14, 0x3FF, VIDC_DIRTY_TIMING),            // 0x28
+    VIDC_TIMING("VSWR", v_sync_width, 14, 0x3FF, 0),
+    VIDC_TIMING("VBSR", v_border_start, 14, 0x3FF, 0),
+    VIDC_TIMING("VDSR", v_display_start, 14, 0x3FF, VIDC_DIRTY_GEOMETRY),
+    VIDC_TIMING("VDER", v_display_end, 14, 0x3FF, VIDC_DIRTY_GEOMETRY),
+    VIDC_TIMING("VBER", v_border_end, 14, 0x3FF, 0),
+    VIDC_TIMING("VCSR", v_cursor_start, 14, 0x3FF, 0),
+    VIDC_TIMING("VCER", v_cursor_end, 14, 0x3FF, 0),
+    { "SFR", VIDC_FIELD(sound_freq), 0, 0xFF, 0 },                        // 0x30
+    VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED,
+    VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED,
+    { "CONTROL", VIDC_FIELD(control), 0, 0xFF, VIDC_DIRTY_PALETTE | VIDC_DIRTY_GEOMETRY | VIDC_DIRTY_TIMING }, // 0x38
+    VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED,
+    VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED, VIDC_UNUSED,
+};
+
+// Real VIDC ignores the address and takes the register from the data word
+static void vidc_write(io_t* io, uint32_t value) {
+    const vidc_reg_t* reg = &vidc_regs[value >> 26];
+    if (!reg->name) {
+        printf("VIDC write to unused register 0x%02X with value 0x%08X\n", (value >> 24) & 0xFC, value);
+        return;
+    }
+    uint32_t* field = (uint32_t*)((uint8_t*)&io->vidc + reg->field);
+    uint32_t data = (value >> reg->shift) & reg->mask;
+    if (*field != data) {
+        *field = data;
+        io->vidc.dirty |= reg->dirty;
+    }
+}
+
+// Rebuild whichever VIDC-derived caches were invalidated since the last call
+static void vidc_update(io_t* io) {
+    vidc_t* vidc = &io->vidc;
+    if (!vidc->dirty) return;
+
+    if (vidc->dirty & VIDC_DIRTY_PALETTE) {
+        uint32_t bpp = (vidc->control >> 2) & 3;
+        for (uint32_t c = 0; c < 256; c++) {
+            uint32_t rgb;
+            if (bpp == 3) {
+                // 8 bpp: the top four pixel bits drive R3, G2, G3 and B3 directly
+                rgb = (vidc->palette[c & 0xF] & 0x1737) | ((c & 0x10) ? 0x008 : 0) |
+                      ((c & 0x60) << 1) | ((c & 0x80) ? 0x800 : 0);
+            } else {
+                rgb = vidc->palette[c & ((1 << (1 << bpp)) - 1)];
+            }
+            uint32_t r = rgb & 0xF, g = (rgb >> 4) & 0xF, b = (rgb >> 8) & 0xF;
+            vidc->palette_lut32[c] = 0xFF000000 | ((r * 0x11) << 16) | ((g * 0x11) << 8) | (b * 0x11);
+            vidc->palette_lut[c] = (uint16_t)(((r << 1 | r >> 3) << 11) | ((g << 2 | g >> 2) << 5) | (b << 1 | b >> 3));
+        }
+    }
+
+    if (vidc->dirty & VIDC_DIRTY_GEOMETRY) {
+        uint32_t width = (vidc->h_display_end > vidc->h_display_start) ?
+                         (vidc->h_display_end - vidc->h_display_start) * 2 : 0;
+        uint32_t height = (vidc->v_display_end > vidc->v_display_start) ?
+                          vidc->v_display_end - vidc->v_display_start : 0;
+        // Low resolution modes are doubled and interlaced fields woven so the
+        // frontend sees a stable output size
+        bool interlaced = (vidc->control >> 6) & 1;
+        uint32_t x_scale = (width <= VIDC_DOUBLE_MAX_WIDTH) ? 2 : 1;
+        uint32_t y_scale = (!interlaced && height <= VIDC_DOUBLE_MAX_HEIGHT) ? 2 : 1;
+        uint32_t out_width = width * x_scale;
+        uint32_t out_height = height * (interlaced ? 2 : y_scale);
+        if (out_width && out_height && out_width * out_height > io->frame_capacity) {
+            uint32_t* buffer = (uint32_t*)realloc(io->frame_buffer, out_width * out_height * sizeof(uint32_t));
+            if (buffer) io->frame_buffer = buffer;
+            uint16_t* video = buffer ? (uint16_t*)realloc(io->video_buffer, out_width * out_height * sizeof(uint16_t)) : NULL;
+            if (video) io->video_buffer = video;
+            if (buffer && video) {
+                io->frame_capacity = out_width * out_height;
+            } else {
+                printf("Failed to grow frame buffer to %ux%u\n", out_width, out_height);
+            }
+        }
+        // The mode and the frame buffer change together: an empty display area,
+        // or one the buffer could not grow to, keeps the previous mode
+        if (out_width && out_height && out_width * out_height <= io->frame_capacity) {
+            vidc->display_width = width;
+            vidc->display_height = height;
+            vidc->interlaced = interlaced;
+            vidc->x_scale = x_scale;
+            vidc->y_scale = y_scale;
+            io->frame_width = out_width;
+            io->frame_height = out_height;
+        }
+    }
+
+    if (vidc->dirty & VIDC_DIRTY_TIMING) {
+        static const uint32_t pixel_clocks[4] = { 8000000, 12000000, 16000000, 24000000 };
+        uint64_t frame_pixels = (uint64_t)(vidc->h_cycle * 2 + 2) * (vidc->v_cycle + 1);
+        vidc->frame_cycles = (uint32_t)(8000000ULL * frame_pixels / pixel_clocks[vidc->control & 3]);
+        if (vidc->frame_cycles == 0) vidc->frame_cycles = 8000000 / 50;
+    }
+
+    if (vidc->dirty & (VIDC_DIRTY_PALETTE | VIDC_DIRTY_GEOMETRY)) io->render_full = 3;
+    vidc->dirty = 0;
+}
+
+// MEMC is programmed through the address alone; the data bus is ignored
+static void memc_write(io_t* io, uint32_t address) {
+    uint32_t reg = (address >> 17) & 7;
+    uint32_t value = ((address >> 2) & 0x7FFF) << 4;
+    switch (reg) {
+        case MEMC_REG_VINIT: io->memc.vinit = value; io->render_full = 3; break;
+        case MEMC_REG_VSTART: io->memc.vstart = value; io->render_full = 3; break;
+        case MEMC_REG_VEND: io->memc.vend = value; io->render_full = 3; break;
+        case MEMC_REG_CINIT: io->memc.cinit = value; break;
+        case MEMC_REG_SSTART: io->memc.sstart = value; break;
+        case MEMC_REG_SENDN: io->memc.sendn = value; break;
+        case MEMC_REG_SPTR: io->memc.sptr = value; break;
+        case MEMC_REG_CONTROL: io->memc.control = (address >> 2) & 0x1FFF; break;
+    }
+    printf("MEMC write at 0x%08X (register %u = 0x%05X)\n", address, reg, value);
+}
+
+// Convert a contiguous run of screen memory to output pixels for the current bpp,
+// writing each guest pixel x_scale times
+static void vidc_convert_span(io_t* io, const uint8_t* src, uint32_t bytes,
+                              uint16_t* dst565, uint32_t* dst32) {
+    const uint16_t* lut = io->vidc.palette_lut;
+    const uint32_t* lut32 = io->vidc.palette_lut32;
+    uint32_t bpp_bits = 1u << ((io->vidc.control >> 2) & 3);
+    uint32_t repeat = io->vidc.x_scale;
+    if (bpp_bits == 8 && repeat == 1) {
+        for (uint32_t i = 0; i < bytes; i++) {
+            dst565[i] = lut[src[i]];
+            dst32[i] = lut32[src[i]];
+        }
+        return;
+    }
+    // Packed modes: pixels fill each byte from the least significant bits up
+    uint32_t per_byte = 8 / bpp_bits;
+    uint32_t mask = (1u << bpp_bits) - 1;
+    for (uint32_t i = 0; i < bytes; i++) {
+        uint32_t byte = src[i];
+        for (uint32_t p = 0; p < per_byte; p++) {
+            uint32_t pixel = (byte >> (p * bpp_bits)) & mask;
+            uint16_t c565 = lut[pixel];
+            uint32_t c32 = lut32[pixel];
+            for (uint32_t r = 0; r < repeat; r++) {
+                *dst565++ = c565;
+                *dst32++ = c32;
+            }
+        }
+    }
+}
+
 uint32_t io_read_word(io_t* io, memory_t* mem, uint32_t address) {
+    io->accesses++;
     if (address >= VIDC_BASE && address < VIDC_BASE + VIDC_SIZE) {
-        uint32_t offset = (address - VIDC_BASE) >> 2;
-        switch (offset) {
-            case 0: return io->vidc.control | (io->ioc.irq_request_a & (1 << 3) ? 0x8 : 0);
-            case 1: case 2: case 3: case 4: case 5: case 6: case 7: case 8:
-            case 9: case 10: case 11: case 12: case 13: case 14: case 15: case 16:
-            case 17: case 18: case 19: case 20: case 21: case 22: case 23: case 24:
-            case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32:
-            case 33: case 34: case 35: case 36: case 37: case 38: case 39: case 40:
-            case 41: case 42: case 43: case 44: case 45: case 46: case 47: case 48:
-            case 49: case 50: case 51: case 52: case 53: case 54: case 55: case 56:
-            case 57: case 58: case 59: case 60: case 61: case 62: case 63: case 64:
-            case 65: case 66: case 67: case 68: case 69: case 70: case 71: case 72:
-            case 73: case 74: case 75: case 76: case 77: case 78: case 79: case 80:
-            case 81: case 82: case 83: case 84: case 85: case 86: case 87: case 88:
-            case 89: case 90: case 91: case 92: case 93: case 94: case 95: case 96:
-            case 97: case 98: case 99: case 100: case 101: case 102: case 103: case 104:
-            case 105: case 106: case 107: case 108: case 109: case 110: case 111: case 112:
-            case 113: case 114: case 115: case 116: case 117: case 118: case 119: case 120:
-            case 121: case 122: case 123: case 124: case 125: case 126: case 127: case 128:
-            case 129: case 130: case 131: case 132: case 133: case 134: case 135: case 136:
-            case 137: case 138: case 139: case 140: case 141: case 142: case 143: case 144:
-            case 145: case 146: case 147: case 148: case 149: case 150: case 151: case 152:
-            case 153: case 154: case 155: case 156: case 157: case 158: case 159: case 160:
-            case 161: case 162: case 163: case 164: case 165: case 166: case 167: case 168:
-            case 169: case 170: case 171: case 172: case 173: case 174: case 175: case 176:
-            case 177: case 178: case 179: case 180: case 181: case 182: case 183: case 184:
-            case 185: case 186: case 187: case 188: case 189: case 190: case 191: case 192:
-            case 193: case 194: case 195: case 196: case 197: case 198: case 199: case 200:
-            case 201: case 202: case 203: case 204: case 205: case 206: case 207: case 208:
-            case 209: case 210: case 211: case 212: case 213: case 214: case 215: case 216:
-            case 217: case 218: case 219: case 220: case 221: case 222: case 223: case 224:
-            case 225: case 226: case 227: case 228: case 229: case 230: case 231: case 232:
-            case 233: case 234: case 235: case 236: case 237: case 238: case 239: case 240:
-            case 241: case 242: case 243: case 244: case 245: case 246: case 247: case 248:
-            case 249: case 250: case 251: case 252: case 253: case 254: case 255:
-                return io->vidc.palette[offset - 1];
-            case 256: return io->vidc.border_color;
-            case 257: case 258: case 259: return io->vidc.cursor_palette[offset - 257];
-            case 260: return io->vidc.h_cycle;
-            case 261: return io->vidc.h_sync_width;
-            case 262: return io->vidc.h_border_start;
-            case 263: return io->vidc.h_display_start;
-            case 264: return io->vidc.h_display_end;
-            case 265: return io->vidc.h_border_end;
-            case 266: return io->vidc.h_cursor_start;
-            case 267: return io->vidc.v_cycle;
-            case 268: return io->vidc.v_sync_width;
-            case 269: return io->vidc.v_border_start;
-            case 270: return io->vidc.v_display_start;
-            case 271: return io->vidc.v_display_end;
-            case 272: return io->vidc.v_border_end;
-            case 273: return io->vidc.v_cursor_end;
-            case 274: return io->vidc.sound_freq;
-            case 275: return io->vidc.sound_control;
-            case 276: return io->vidc.video_base;
-            case 277: return io->vidc.ext_latch_c;
-            default:
-                printf("VIDC read at 0x%08X (offset 0x%08X) (unimplemented)\n", address, offset);
-                return 0;
-        }
+        // VIDC is write-only; the data bus floats on reads
+        printf("VIDC read at 0x%08X (write-only)\n", address);
+        return 0;
     } else if (address >= IOC_BASE && address < IOC_BASE + IOC_SIZE) {
         uint32_t offset = (address - IOC_BASE) >> 2;
         switch (offset) {
-            case 0: return io->ioc.control;
+            case 0: {
+                // SDA reads back the wired-AND of our output and the CMOS chip's
+                bool sda = pcf8583_lines(&io->cmos, io->ioc.control & IOC_CONTROL_SCL,
+                                         io->ioc.control & IOC_CONTROL_SDA);
+                return (io->ioc.control & ~IOC_CONTROL_SDA) | (sda ? IOC_CONTROL_SDA : 0);
+            }
             case 1: return io->ioc.timer0_low;
             case 2: return io->ioc.timer0_high;
             case 3: return io->ioc.timer1_low;
@@ -182,7 +367,7 @@ uint32_t io_read_word(io_t* io, memory_t* mem, uint32_t address) {
         }
     } else if (address == 0x0363D8BC) {
         // Simulate IRQ status polling (e.g., VSYNC or timer)
-        static int read_count = 0;
+        static thread_local int read_count = 0;
         read_count++;
         if (read_count > 100) { // Delay to mimic hardware response
             io->ioc.irq_request_a |= (1 << 1); // Bit 1: General IRQ (e.g., VSYNC)
@@ -200,92 +385,22 @@ uint32_t io_read_word(io_t* io, memory_t* mem, uint32_t address) {
 }
 
 void io_write_word(io_t* io, memory_t* mem, uint32_t address, uint32_t value) {
-    if (address >= 0x03600000 && address < 0x03600100) {
-        printf("MEMC write at 0x%08X with value 0x%08X\n", address, value);
+    io->accesses++;
+    if (address >= MEMC_BASE && address < MEMC_BASE + MEMC_SIZE) {
+        memc_write(io, address);
         mem->is_boot_mode = 0;
         return;
     }
 
     if (address >= VIDC_BASE && address < VIDC_BASE + VIDC_SIZE) {
-        uint32_t offset = (address - VIDC_BASE) >> 2;
-        switch (offset) {
-            case 0: io->vidc.control = value; break;
-            case 1: case 2: case 3: case 4: case 5: case 6: case 7: case 8:
-            case 9: case 10: case 11: case 12: case 13: case 14: case 15: case 16:
-            case 17: case 18: case 19: case 20: case 21: case 22: case 23: case 24:
-            case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32:
-            case 33: case 34: case 35: case 36: case 37: case 38: case 39: case 40:
-            case 41: case 42: case 43: case 44: case 45: case 46: case 47: case 48:
-            case 49: case 50: case 51: case 52: case 53: case 54: case 55: case 56:
-            case 57: case 58: case 59: case 60: case 61: case 62: case 63: case 64:
-            case 65: case 66: case 67: case 68: case 69: case 70: case 71: case 72:
-            case 73: case 74: case 75: case 76: case 77: case 78: case 79: case 80:
-            case 81: case 82: case 83: case 84: case 85: case 86: case 87: case 88:
-            case 89: case 90: case 91: case 92: case 93: case 94: case 95: case 96:
-            case 97: case 98: case 99: case 100: case 101: case 102: case 103: case 104:
-            case 105: case 106: case 107: case 108: case 109: case 110: case 111: case 112:
-            case 113: case 114: case 115: case 116: case 117: case 118: case 119: case 120:
-            case 121: case 122: case 123: case 124: case 125: case 126: case 127: case 128:
-            case 129: case 130: case 131: case 132: case 133: case 134: case 135: case 136:
-            case 137: case 138: case 139: case 140: case 141: case 142: case 143: case 144:
-            case 145: case 146: case 147: case 148: case 149: case 150: case 151: case 152:
-            case 153: case 154: case 155: case 156: case 157: case 158: case 159: case 160:
-            case 161: case 162: case 163: case 164: case 165: case 166: case 167: case 168:
-            case 169: case 170: case 171: case 172: case 173: case 174: case 175: case 176:
-            case 177: case 178: case 179: case 180: case 181: case 182: case 183: case 184:
-            case 185: case 186: case 187: case 188: case 189: case 190: case 191: case 192:
-            case 193: case 194: case 195: case 196: case 197: case 198: case 199: case 200:
-            case 201: case 202: case 203: case 204: case 205: case 206: case 207: case 208:
-            case 209: case 210: case 211: case 212: case 213: case 214: case 215: case 216:
-            case 217: case 218: case 219: case 220: case 221: case 222: case 223: case 224:
-            case 225: case 226: case 227: case 228: case 229: case 230: case 231: case 232:
-            case 233: case 234: case 235: case 236: case 237: case 238: case 239: case 240:
-            case 241: case 242: case 243: case 244: case 245: case 246: case 247: case 248:
-            case 249: case 250: case 251: case 252: case 253: case 254: case 255:
-                io->vidc.palette[offset - 1] = value & 0x1FFF;
-                break;
-            case 256: io->vidc.border_color = value & 0x1FFF; break;
-            case 257: case 258: case 259:
-                io->vidc.cursor_palette[offset - 257] = value & 0x1FFF;
-                break;
-            case 260: io->vidc.h_cycle = value; break;
-            case 261: io->vidc.h_sync_width = value; break;
-            case 262: io->vidc.h_border_start = value; break;
-            case 263:
-                io->vidc.h_display_start = value;
-                io->frame_width = io->vidc.h_display_end - io->vidc.h_display_start;
-                break;
-            case 264:
-                io->vidc.h_display_end = value;
-                io->frame_width = io->vidc.h_display_end - io->vidc.h_display_start;
-                break;
-            case 265: io->vidc.h_border_end = value; break;
-            case 266: io->vidc.h_cursor_start = value; break;
-            case 267: io->vidc.v_cycle = value; break;
-            case 268: io->vidc.v_sync_width = value; break;
-            case 269: io->vidc.v_border_start = value; break;
-            case 270:
-                io->vidc.v_display_start = value;
-                io->frame_height = io->vidc.v_display_end - io->vidc.v_display_start;
-                break;
-            case 271:
-                io->vidc.v_display_end = value;
-                io->frame_height = io->vidc.v_display_end - io->vidc.v_display_start;
-                break;
-            case 272: io->vidc.v_border_end = value; break;
-            case 273: io->vidc.v_cursor_end = value; break;
-            case 274: io->vidc.sound_freq = value & 0xFF; break;
-            case 275: io->vidc.sound_control = value; break;
-            case 276: io->vidc.video_base = value & ADDR_MASK; break;
-            case 277: io->vidc.ext_latch_c = value & 0xFF; break;
-            default:
-                printf("VIDC write at 0x%08X (offset 0x%08X) with value 0x%08X (unimplemented)\n", address, offset, value);
-                break;
-        }
+        vidc_write(io, value);
     } else if (address >= IOC_BASE && address < IOC_BASE + IOC_SIZE) {
         uint32_t offset = (address - IOC_BASE) >> 2;
         switch (offset) {
-            case 0: io->ioc.control = value; break;
+            case 0:
+                io->ioc.control = value;
+                pcf8583_lines(&io->cmos, value & IOC_CONTROL_SCL, value & IOC_CONTROL_SDA);
+                break;
             case 1: io->ioc.timer0_low = value & 0xFFFF; break;
             case 2: io->ioc.timer0_high = value & 0xFFFF; break;
             case 3: io->ioc.timer1_low = value & 0xFFFF; break;
@@ -317,8 +432,7 @@ void io_write_word(io_t* io, memory_t* mem, uint32_t address, uint32_t value) {
                 break;
         }
     } else if (address == 0x02FF5500) {
-        io->vidc.control = value;
-        printf("Mapped write to VIDC control at 0x%08X with value 0x%08X\n", address, value);
+        vidc_write(io, ((uint32_t)VIDC_REG_CONTROL << 24) | (value & 0xFF)); // Control alias: value is the bare register
     } else {
         printf("Unhandled I/O write at 0x%08X with value 0x%08X\n", address, value);
     }
@@ -337,47 +451,138 @@ void io_write_byte(io_t* io, memory_t* mem, uint32_t address, uint8_t value) {
     io_write_word(io, mem, word_addr, word);
 }
 
+// One frame's view of the circular video buffer, shared by the band workers
+typedef struct {
+    io_t* io;
+    memory_t* mem;
+    uint32_t buf_start;        // Physical start of the circular buffer
+    uint32_t buf_len;          // Circular buffer length in bytes
+    uint32_t first;            // Offset of Vinit within the buffer
+    uint32_t line_bytes;       // Screen memory per guest line
+    uint32_t out_per_byte;     // Output pixels per byte of screen memory
+    uint8_t dirty_bit;         // PAGE_DIRTY_VIDEO* bit for the field being drawn
+    uint32_t line_count;       // Entries in io->dirty_lines
+    unsigned bands;            // Tasks the dirty lines are split into
+} render_job_t;
+
+// Visit the (at most two) contiguous runs of screen memory behind guest line y
+template <typename F>
+static void render_line_spans(const render_job_t* job, uint32_t y, F visit) {
+    uint32_t pos = (uint32_t)((job->first + (uint64_t)y * job->line_bytes) % job->buf_len);
+    uint32_t done = 0;
+    while (done < job->line_bytes) {
+        uint32_t span = job->buf_len - pos;
+        if (span > job->line_bytes - done) span = job->line_bytes - done;
+        visit(job->buf_start + pos, span, done);
+        done += span;
+        pos = 0;
+    }
+}
+
+static bool render_line_dirty(const render_job_t* job, uint32_t y) {
+    bool dirty = false;
+    render_line_spans(job, y, [&](uint32_t addr, uint32_t span, uint32_t) {
+        for (uint32_t page = addr >> PAGE_SHIFT; page <= (addr + span - 1) >> PAGE_SHIFT; page++) {
+            if (job->mem->page_dirty[page] & job->dirty_bit) dirty = true;
+        }
+    });
+    return dirty;
+}
+
+// Each guest line is converted once; line-doubled modes copy it to the next output row
+static void render_band(void* ctx, unsigned band) {
+    const render_job_t* job = (const render_job_t*)ctx;
+    io_t* io = job->io;
+    uint32_t width = io->frame_width;
+    uint32_t height = io->frame_height;
+    uint32_t y_scale = io->vidc.y_scale;
+    uint32_t begin = (uint32_t)((uint64_t)job->line_count * band / job->bands);
+    uint32_t end = (uint32_t)((uint64_t)job->line_count * (band + 1) / job->bands);
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t y = io->dirty_lines[i];
+        if (y * y_scale >= height) continue;
+        uint32_t row = y * y_scale * width;
+        render_line_spans(job, y, [&](uint32_t addr, uint32_t span, uint32_t offset) {
+            uint32_t out = row + offset * job->out_per_byte;
+            vidc_convert_span(io, job->mem->ram + addr, span, io->video_buffer + out, io->frame_buffer + out);
+        });
+        for (uint32_t r = 1; r < y_scale && y * y_scale + r < height; r++) {
+            memcpy(io->video_buffer + row + r * width, io->video_buffer + row, width * sizeof(uint16_t));
+            memcpy(io->frame_buffer + row + r * width, io->frame_buffer + row, width * sizeof(uint32_t));
+        }
+    }
+}
+
+void io_set_render_threads(io_t* io, unsigned threads) {
+    if (threadpool_size(io->render_pool) == (threads ? threads : 1)) return;
+    threadpool_destroy(io->render_pool);
+    io->render_pool = (threads > 1) ? threadpool_create(threads) : NULL;
+    printf("Render threads: %u\n", threadpool_size(io->render_pool));
+}
+
 void io_render_frame(io_t* io, memory_t* mem, retro_video_refresh_t video_cb) {
     if (!io->frame_buffer || !video_cb) return;
+    vidc_update(io);
 
-    uint16_t* rgb565_buffer = (uint16_t*)malloc(io->frame_width * io->frame_height * sizeof(uint16_t));
-    if (!rgb565_buffer) {
-        printf("Failed to allocate RGB565 buffer\n");
-        return;
+    // Walk MEMC's circular video buffer from Vinit, wrapping from Vend to Vstart
+    uint32_t bpp_bits = 1u << ((io->vidc.control >> 2) & 3);
+    render_job_t job;
+    job.io = io;
+    job.mem = mem;
+    job.buf_start = io->memc.vstart;
+    job.buf_len = io->memc.vend + 16 - io->memc.vstart;
+    if (io->memc.vend + 16 <= io->memc.vstart || io->memc.vinit < io->memc.vstart ||
+        io->memc.vinit >= io->memc.vend + 16) {
+        job.buf_start = 0; // Inconsistent pointers: read linearly from Vinit
+        job.buf_len = RAM_SIZE;
     }
+    job.first = io->memc.vinit - job.buf_start;
+    job.line_bytes = io->vidc.display_width * bpp_bits / 8;
+    job.out_per_byte = 8 / bpp_bits * io->vidc.x_scale;
 
-    // Assume 8 bits per pixel (256 colors) for simplicity, adjust based on VIDC control
-    uint8_t* video_mem = mem->ram + (io->vidc.video_base - RAM_BASE);
-    uint32_t display_width = io->vidc.h_display_end - io->vidc.h_display_start;
-    uint32_t display_height = io->vidc.v_display_end - io->vidc.v_display_start;
-
-    for (uint32_t y = 0; y < io->frame_height && y < display_height; y++) {
-        for (uint32_t x = 0; x < io->frame_width && x < display_width; x++) {
-            uint32_t pixel_idx = y * io->frame_width + x;
-            uint8_t pixel = video_mem[pixel_idx];
-            uint32_t rgb = io->vidc.palette[pixel & 0xFF]; // 13-bit RGB
-
-            uint8_t r = ((rgb >> 9) & 0xF) * 255 / 15; // 4-bit R
-            uint8_t g = ((rgb >> 4) & 0x1F) * 255 / 31; // 5-bit G
-            uint8_t b = (rgb & 0xF) * 255 / 15;        // 4-bit B
-            io->frame_buffer[pixel_idx] = (0xFF << 24) | (r << 16) | (g << 8) | b;
-
-            uint16_t r5 = (r >> 3) & 0x1F;
-            uint16_t g6 = (g >> 2) & 0x3F;
-            uint16_t b5 = (b >> 3) & 0x1F;
-            rgb565_buffer[pixel_idx] = (r5 << 11) | (g6 << 5) | b5;
-        }
+    // Interlaced modes convert one field per frame; the other field's lines are
+    // kept from the previous frame and woven into the output
+    uint32_t lines = io->vidc.display_height;
+    uint32_t first_line = 0, line_step = 1;
+    uint8_t field_mask = 3;
+    if (io->vidc.interlaced) {
+        first_line = io->frame_count & 1;
+        line_step = 2;
+        lines *= 2;
+        field_mask = 1 << first_line;
+    }
+    job.dirty_bit = (field_mask == 2) ? PAGE_DIRTY_VIDEO_ODD : PAGE_DIRTY_VIDEO;
+
+    // Only lines whose screen memory was written since they were last drawn are reconverted
+    job.line_count = 0;
+    bool full = (io->render_full & field_mask) != 0;
+    for (uint32_t y = first_line; y < lines && y < 2 * VIDC_MAX_LINES; y += line_step) {
+        if (full || render_line_dirty(&job, y)) io->dirty_lines[job.line_count++] = y;
+    }
+    uint32_t max_bands = threadpool_size(io->render_pool);
+    job.bands = job.line_count * io->frame_width * io->vidc.y_scale / RENDER_BAND_MIN_PIXELS;
+    if (job.bands > max_bands) job.bands = max_bands;
+    if (job.bands < 1) job.bands = 1;
+    threadpool_run(io->render_pool, job.line_count ? job.bands : 0, render_band, &job);
+
+    // Screen memory is now in sync with the output buffers for the drawn field(s)
+    uint8_t clear = (field_mask & 1 ? PAGE_DIRTY_VIDEO : 0) | (field_mask & 2 ? PAGE_DIRTY_VIDEO_ODD : 0);
+    uint32_t last_page = (job.buf_start + job.buf_len - 1) >> PAGE_SHIFT;
+    for (uint32_t page = job.buf_start >> PAGE_SHIFT; page <= last_page; page++) {
+        mem->page_dirty[page] &= ~clear;
     }
+    io->render_full &= ~field_mask;
+    io->frame_count++;
 
-    video_cb(rgb565_buffer, io->frame_width, io->frame_height, io->frame_width * sizeof(uint16_t));
-    free(rgb565_buffer);
+    video_cb(io->video_buffer, io->frame_width, io->frame_height, io->frame_width * sizeof(uint16_t));
 
     // Trigger VFLY interrupt
     io->ioc.irq_request_a |= (1 << 3); // Vertical Flyback
 }
 
 void io_update_timers(io_t* io) {
-    const uint32_t cycles_per_frame = 8000000 / 50; // 8 MHz / 50 Hz
+    vidc_update(io);
+    const uint32_t cycles_per_frame = io->vidc.frame_cycles; // 8 MHz / VIDC frame rate
     io->cycles += cycles_per_frame;
 
     // Update timers (16-bit, wrap at latch value)
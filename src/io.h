@@ -3,45 +3,88 @@
 
 #include <cstdint>
 #include <libretro.h> // For retro_video_refresh_t
+#include "pcf8583.h"
 
-// Forward declaration of struct memory
+// Forward declarations
 struct memory;
+struct threadpool;
 
 // Memory-mapped base addresses and sizes
 #define VIDC_BASE 0x03400000
 #define VIDC_SIZE 0x00200000
 #define IOC_BASE  0x03200000
 #define IOC_SIZE  0x00200000
+#define MEMC_BASE 0x03600000
+#define MEMC_SIZE 0x00200000
 
-// VIDC registers
+// VIDC register addresses (selected by bits 31:26 of the written data word)
+#define VIDC_REG_COUNT 64
+#define VIDC_REG_PALETTE   0x00 // 0x00-0x0F: logical palette 0-15
+#define VIDC_REG_BORDER    0x10
+#define VIDC_REG_CURSOR    0x11 // 0x11-0x13: cursor colours 1-3
+#define VIDC_REG_STEREO    0x18 // 0x18-0x1F: stereo image 7, 0-6
+#define VIDC_REG_HCR       0x20 // 0x20-0x27: horizontal timing
+#define VIDC_REG_VCR       0x28 // 0x28-0x2F: vertical timing
+#define VIDC_REG_SOUND_FREQ 0x30
+#define VIDC_REG_CONTROL   0x38
+
+// Caches derived from VIDC registers, rebuilt lazily when their inputs change
+#define VIDC_DIRTY_PALETTE  (1 << 0) // Palette LUTs (palette, border, bpp)
+#define VIDC_DIRTY_GEOMETRY (1 << 1) // Display width/height
+#define VIDC_DIRTY_TIMING   (1 << 2) // Frame rate and CPU cycles per frame
+
+#define VIDC_MAX_LINES 1024          // VDER/VDSR are 10-bit line counts
+#define VIDC_MAX_OUTPUT_WIDTH 2048   // 10-bit HDER/HDSR count two pixels; wider than doubled modes
+#define VIDC_MAX_OUTPUT_HEIGHT (2 * VIDC_MAX_LINES) // Woven interlaced fields
+#define VIDC_DOUBLE_MAX_WIDTH 400    // Narrower modes are pixel-doubled on output
+#define VIDC_DOUBLE_MAX_HEIGHT 300   // Shorter modes are line-doubled on output
+#define RENDER_BAND_MIN_PIXELS 131072 // Dirty pixels per band before splitting across threads
+
+// VIDC registers (raw values as written, field bits already extracted)
 typedef struct {
-    uint32_t control;          // VIDC control register (simplified)
-    uint32_t palette[256];     // 256 palette entries (13-bit RGB: 4R, 5G, 4B)
-    uint32_t border_color;     // Border color (13-bit RGB)
-    uint32_t cursor_palette[3]; // Cursor palette (3 colors, 13-bit RGB)
-    uint32_t h_cycle;          // Horizontal total cycle
-    uint32_t h_sync_width;     // Horizontal sync width
-    uint32_t h_border_start;   // Horizontal border start
-    uint32_t h_display_start;  // Horizontal display start
-    uint32_t h_display_end;    // Horizontal display end
-    uint32_t h_border_end;     // Horizontal border end
-    uint32_t h_cursor_start;   // Horizontal cursor start
-    uint32_t v_cycle;          // Vertical total cycle
-    uint32_t v_sync_width;     // Vertical sync width
-    uint32_t v_border_start;   // Vertical border start
-    uint32_t v_display_start;  // Vertical display start
-    uint32_t v_display_end;    // Vertical display end
-    uint32_t v_border_end;     // Vertical border end
-    uint32_t v_cursor_end;     // Vertical cursor end (end of cursor data)
+    uint32_t control;          // Control: bits 1:0 pixel clock, 3:2 bpp, 6 interlace
+    uint32_t palette[16];      // Logical palette (13-bit: 4R, 4G, 4B, supremacy)
+    uint32_t border_color;     // Border color (13-bit)
+    uint32_t cursor_palette[3]; // Cursor palette (3 colors, 13-bit)
+    uint32_t stereo_image[8];  // Stereo image position per sound channel (3-bit)
+    uint32_t h_cycle;          // Horizontal total cycle (HCR)
+    uint32_t h_sync_width;     // Horizontal sync width (HSWR)
+    uint32_t h_border_start;   // Horizontal border start (HBSR)
+    uint32_t h_display_start;  // Horizontal display start (HDSR)
+    uint32_t h_display_end;    // Horizontal display end (HDER)
+    uint32_t h_border_end;     // Horizontal border end (HBER)
+    uint32_t h_cursor_start;   // Horizontal cursor start (HCSR)
+    uint32_t h_interlace;      // Horizontal interlace (HIR)
+    uint32_t v_cycle;          // Vertical total cycle (VCR)
+    uint32_t v_sync_width;     // Vertical sync width (VSWR)
+    uint32_t v_border_start;   // Vertical border start (VBSR)
+    uint32_t v_display_start;  // Vertical display start (VDSR)
+    uint32_t v_display_end;    // Vertical display end (VDER)
+    uint32_t v_border_end;     // Vertical border end (VBER)
+    uint32_t v_cursor_start;   // Vertical cursor start (VCSR)
+    uint32_t v_cursor_end;     // Vertical cursor end (VCER)
     uint32_t sound_freq;       // Sound frequency (8-bit, 3-255 µs intervals)
-    uint32_t sound_control;    // Sound control (e.g., stereo positions)
-    uint32_t video_base;       // Video memory base address
     uint32_t ext_latch_c;      // External Latch C (clock speed, sync polarity)
+
+    // Derived state, see VIDC_DIRTY_*
+    uint32_t dirty;            // Pending cache rebuilds
+    uint16_t palette_lut[256]; // Pixel value -> RGB565 for the current bpp
+    uint32_t palette_lut32[256]; // Pixel value -> XRGB8888 for the current bpp
+    uint32_t display_width;    // Display area width in pixels
+    uint32_t display_height;   // Display area height in lines (per field if interlaced)
+    uint32_t x_scale;          // Output pixels per guest pixel
+    uint32_t y_scale;          // Output lines per guest line (1 when interlaced)
+    bool interlaced;           // Two fields woven into one frame
+    uint32_t frame_cycles;     // CPU cycles (8 MHz) per frame
 } vidc_t;
 
+// IOC control register lines
+#define IOC_CONTROL_SDA (1 << 0) // I2C data (open drain, 1 = released)
+#define IOC_CONTROL_SCL (1 << 1) // I2C clock
+
 // IOC registers
 typedef struct {
-    uint32_t control;          // Control register (general I/O control)
+    uint32_t control;          // Control register (I2C lines, general I/O)
     uint32_t timer0_low;       // Timer 0 low word
     uint32_t timer0_high;      // Timer 0 high word (latched)
     uint32_t timer1_low;       // Timer 1 low word
@@ -61,26 +104,64 @@ typedef struct {
     uint32_t podule_irq_request; // Podule IRQ request
 } ioc_t;
 
+// MEMC registers (selected by address bits 19:17, value in address bits 16:2)
+#define MEMC_REG_VINIT   0
+#define MEMC_REG_VSTART  1
+#define MEMC_REG_VEND    2
+#define MEMC_REG_CINIT   3
+#define MEMC_REG_SSTART  4
+#define MEMC_REG_SENDN   5
+#define MEMC_REG_SPTR    6
+#define MEMC_REG_CONTROL 7
+
+// DMA pointers are stored as physical byte offsets into RAM (16-byte units)
+typedef struct {
+    uint32_t vinit;            // Video DMA pointer at start of frame
+    uint32_t vstart;           // Start of circular video buffer
+    uint32_t vend;             // Last 16-byte block of circular video buffer
+    uint32_t cinit;            // Cursor DMA pointer
+    uint32_t sstart;           // Sound DMA start
+    uint32_t sendn;            // Sound DMA end
+    uint32_t sptr;             // Sound DMA pointer
+    uint32_t control;          // MEMC control register
+} memc_t;
+
 typedef struct io {
-    uint32_t memc_control;     // MEMC control (existing)
-    vidc_t vidc;               // VIDC state
+    // Hot: checked on every CPU step
+    bool irq_pending;          // IRQ pending flag
+    bool fiq_pending;          // FIQ pending flag
+    uint64_t cycles;           // Cycle counter for timing
+    uint64_t frame_count;      // Frames rendered (selects the interlaced field)
+    uint64_t accesses;         // I/O reads/writes and host SWIs, for the watchdog
+    // Device registers
     ioc_t ioc;                 // IOC state
+    memc_t memc;               // MEMC state
+    vidc_t vidc;               // VIDC state
+    pcf8583_t cmos;            // CMOS RAM / real-time clock on the I2C bus
+    // Renderer
     uint32_t* frame_buffer;    // Frame buffer for video output
     uint32_t frame_width;      // Frame buffer width
     uint32_t frame_height;     // Frame buffer height
-    bool irq_pending;          // IRQ pending flag
-    bool fiq_pending;          // FIQ pending flag
-    uint64_t cycles;           // Cycle counter for timing
+    uint32_t frame_capacity;   // Frame buffer size in pixels
+    uint16_t* video_buffer;    // RGB565 frame handed to the frontend, kept between frames
+    uint8_t render_full;       // Fields (bit 0 even/progressive, bit 1 odd) to reconvert completely
+    uint32_t dirty_lines[2 * VIDC_MAX_LINES]; // Guest lines to reconvert this frame
+    struct threadpool* render_pool; // Band workers (NULL = single-threaded)
 } io_t;
 
 // Function declarations
 io_t* io_create(uint32_t width, uint32_t height);
 void io_destroy(io_t* io);
+// In-place variants for callers that own the storage (see machine.cpp)
+bool io_init(io_t* io, uint32_t width, uint32_t height);
+void io_release(io_t* io);
+bool io_clone(io_t* io, const io_t* src); // Device state copy with its own frame buffers
 uint32_t io_read_word(io_t* io, struct memory* mem, uint32_t address);
 void io_write_word(io_t* io, struct memory* mem, uint32_t address, uint32_t value);
 uint8_t io_read_byte(io_t* io, struct memory* mem, uint32_t address);
 void io_write_byte(io_t* io, struct memory* mem, uint32_t address, uint8_t value);
 void io_render_frame(io_t* io, struct memory* mem, retro_video_refresh_t video_cb);
+void io_set_render_threads(io_t* io, unsigned threads); // 1 disables banded rendering
 void io_update_timers(io_t* io); // Update timers and interrupts
 bool io_get_irq(io_t* io);       // Get IRQ status
 bool io_get_fiq(io_t* io);       // Get FIQ status
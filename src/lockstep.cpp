@@ -0,0 +1,256 @@
+#include "lockstep.h"
+#include "disasm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What a block changes besides RAM (undone from the write log) when it does
+// no I/O: the CPU and the interrupt lines cpu_step consumes
+typedef struct {
+    arm3_cpu_t cpu;
+    bool irq_pending;
+    bool fiq_pending;
+    uint64_t accesses;
+} entry_state_t;
+
+static void null_video(const void* data, unsigned width, unsigned height, size_t pitch) {
+    // The clone renders so its VSync timing matches, but nothing is shown
+}
+
+static void save_entry(entry_state_t* entry, machine_t* m) {
+    entry->cpu = *m->cpu;
+    entry->irq_pending = m->io->irq_pending;
+    entry->fiq_pending = m->io->fiq_pending;
+    entry->accesses = m->io->accesses;
+}
+
+static void restore_entry(const entry_state_t* entry, machine_t* m, const memory_write_log_t* log) {
+    memory_undo_writes(m->mem, log);
+    *m->cpu = entry->cpu;
+    m->io->irq_pending = entry->irq_pending;
+    m->io->fiq_pending = entry->fiq_pending;
+}
+
+// Instruction words for reports, without the side effects of reading I/O
+static uint32_t peek_word(memory_t* mem, uint32_t address) {
+    if (!mem->is_boot_mode && address >= IO_BASE && address < IO_BASE + IO_SIZE) return 0xFFFFFFFF;
+    return memory_read_word(mem, address);
+}
+
+static bool same_write(const memory_write_t* a, const memory_write_t* b) {
+    return a->address == b->address && a->value == b->value && a->size == b->size;
+}
+
+static bool same_state(lockstep_t* ls) {
+    const arm3_cpu_t* a = ls->machine[0]->cpu;
+    const arm3_cpu_t* b = ls->machine[1]->cpu;
+    if (memcmp(a->registers, b->registers, sizeof(a->registers)) != 0) return false;
+    if (a->cpsr != b->cpsr || a->spsr != b->spsr || a->spsr_irq != b->spsr_irq || a->spsr_fiq != b->spsr_fiq) return false;
+    if (a->halted != b->halted) return false;
+    if (a->halted && (a->stop_reason != b->stop_reason || a->exit_code != b->exit_code)) return false;
+    if (ls->log[0].count != ls->log[1].count) return false;
+    for (size_t i = 0; i < ls->log[0].count; i++) {
+        if (!same_write(&ls->log[0].writes[i], &ls->log[1].writes[i])) return false;
+    }
+    return true;
+}
+
+// Runs up to n instructions on both sides with their writes logged. The
+// reference steps one instruction at a time so the history holds every fetch
+// PC of a block, including blocks that cannot be replayed.
+static void run_block(lockstep_t* ls, unsigned n, unsigned* done) {
+    for (int i = 0; i < 2; i++) {
+        arm3_cpu_t* cpu = ls->machine[i]->cpu;
+        memory_t* mem = ls->machine[i]->mem;
+        ls->log[i].count = 0;
+        mem->write_log = &ls->log[i];
+        if (i == 0) {
+            done[0] = 0;
+            while (done[0] < n) {
+                uint32_t pc = cpu->registers[15] & ADDR_MASK;
+                if (!ls->engine[0]->run(cpu, 1)) break;
+                ls->trace[ls->trace_pos++ % LOCKSTEP_TRACE] = pc;
+                done[0]++;
+            }
+        } else {
+            done[1] = ls->engine[1]->run(cpu, n);
+        }
+        mem->write_log = NULL;
+    }
+}
+
+static void print_psr_diff(const char* name, uint32_t a, uint32_t b) {
+    if (a != b) printf("  %s: 0x%08X != 0x%08X\n", name, a, b);
+}
+
+static void report(lockstep_t* ls, const entry_state_t* entry, unsigned block, const unsigned* done) {
+    const arm3_cpu_t* a = ls->machine[0]->cpu;
+    const arm3_cpu_t* b = ls->machine[1]->cpu;
+    const arm3_cpu_t* before = &entry->cpu;
+    uint32_t pc = before->registers[15] & ADDR_MASK;
+    uint32_t instr = peek_word(ls->machine[0]->mem, pc);
+    char text[64];
+
+    printf("Lockstep divergence at step %llu, frame %llu: %s vs %s\n", (unsigned long long)ls->steps,
+           (unsigned long long)ls->machine[0]->io->frame_count, ls->engine[0]->name, ls->engine[1]->name);
+    if (block == 1) {
+        disasm_arm(instr, pc, text, sizeof(text));
+        printf("  0x%08X: 0x%08X  ; %s\n", pc, instr, text);
+    } else {
+        printf("  Within %u instructions from 0x%08X (the block did I/O, so it was not replayed; the\n"
+               "  reference's instructions are the last %u below)\n", block, pc, done[0] < LOCKSTEP_TRACE ? done[0] : LOCKSTEP_TRACE);
+    }
+    if (done[0] != done[1]) printf("  instructions run: %u != %u\n", done[0], done[1]);
+    for (int i = 0; i < 16; i++) {
+        if (a->registers[i] != b->registers[i]) {
+            printf("  r%d: 0x%08X != 0x%08X (was 0x%08X)\n", i, a->registers[i], b->registers[i], before->registers[i]);
+        }
+    }
+    print_psr_diff("cpsr", a->cpsr, b->cpsr);
+    print_psr_diff("spsr", a->spsr, b->spsr);
+    print_psr_diff("spsr_irq", a->spsr_irq, b->spsr_irq);
+    print_psr_diff("spsr_fiq", a->spsr_fiq, b->spsr_fiq);
+    if (a->halted != b->halted || a->stop_reason != b->stop_reason || a->exit_code != b->exit_code) {
+        printf("  halted: %d/%u/%u != %d/%u/%u (halted/reason/exit code)\n", a->halted, a->stop_reason, a->exit_code,
+               b->halted, b->stop_reason, b->exit_code);
+    }
+    size_t writes = ls->log[0].count > ls->log[1].count ? ls->log[0].count : ls->log[1].count;
+    for (size_t i = 0; i < writes; i++) {
+        const memory_write_t* wa = i < ls->log[0].count ? &ls->log[0].writes[i] : NULL;
+        const memory_write_t* wb = i < ls->log[1].count ? &ls->log[1].writes[i] : NULL;
+        if (wa && wb && same_write(wa, wb)) continue;
+        printf("  write %zu: ", i);
+        if (wa) printf("[0x%08X] = 0x%08X/%u", wa->address, wa->value, wa->size);
+        else printf("none");
+        printf(" != ");
+        if (wb) printf("[0x%08X] = 0x%08X/%u\n", wb->address, wb->value, wb->size);
+        else printf("none\n");
+    }
+
+    // Entry state of the instruction (or block), enough to rerun it in isolation
+    printf("Repro: {\"pc\":%u,\"instr\":%u,\"cpsr\":%u,\"spsr\":%u,\"registers\":[", pc, instr, before->cpsr, before->spsr);
+    for (int i = 0; i < 16; i++) {
+        printf("%s%u", i ? "," : "", before->registers[i]);
+    }
+    printf("]}\n");
+
+    printf("  Recent instructions:\n");
+    for (unsigned i = 0; i < LOCKSTEP_TRACE; i++) {
+        uint32_t trace_pc = ls->trace[(ls->trace_pos + i) % LOCKSTEP_TRACE];
+        if (trace_pc == 0xFFFFFFFF) continue;
+        uint32_t word = peek_word(ls->machine[0]->mem, trace_pc);
+        disasm_arm(word, trace_pc, text, sizeof(text));
+        printf("    0x%08X: 0x%08X  ; %s\n", trace_pc, word, text);
+    }
+    fflush(stdout);
+}
+
+// A block disagreed: roll it back and step it one instruction at a time to
+// find the first differing instruction, when nothing in it was I/O
+static void find_divergence(lockstep_t* ls, const entry_state_t* entry, unsigned block, const unsigned* done) {
+    machine_t** m = ls->machine;
+    bool no_io = m[0]->io->accesses == entry[0].accesses && m[1]->io->accesses == entry[1].accesses;
+    if (block == 1 || !no_io) {
+        report(ls, entry, block, done);
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        restore_entry(&entry[i], m[i], &ls->log[i]);
+    }
+    for (unsigned i = 0; i < block; i++) {
+        entry_state_t step_entry[2];
+        unsigned step_done[2];
+        save_entry(&step_entry[0], m[0]);
+        save_entry(&step_entry[1], m[1]);
+        run_block(ls, 1, step_done);
+        if (step_done[0] != step_done[1] || !same_state(ls)) {
+            report(ls, step_entry, 1, step_done);
+            return;
+        }
+        ls->steps += step_done[0];
+    }
+    printf("Lockstep: a %u instruction block from 0x%08X diverged but each instruction alone agrees\n",
+           block, entry[0].cpu.registers[15] & ADDR_MASK);
+}
+
+bool lockstep_init(lockstep_t* ls, machine_t* m, const cpu_engine_t* reference, const cpu_engine_t* engine, unsigned block) {
+    memset(ls, 0, sizeof(*ls));
+    ls->machine[0] = m;
+    ls->machine[1] = machine_clone(m);
+    if (!ls->machine[1]) return false;
+    ls->machine[1]->cpu->log_steps = false; // One instruction log is enough
+    ls->engine[0] = reference;
+    ls->engine[1] = engine;
+    ls->block = block ? block : 1;
+    lockstep_restart(ls);
+    printf("Lockstep: %s against %s, compared every %u instruction(s)\n", engine->name, reference->name, ls->block);
+    return true;
+}
+
+void lockstep_release(lockstep_t* ls) {
+    machine_destroy(ls->machine[1]);
+    ls->machine[1] = NULL;
+    for (int i = 0; i < 2; i++) {
+        free(ls->log[i].writes);
+        ls->log[i].writes = NULL;
+        ls->log[i].count = ls->log[i].capacity = 0;
+    }
+}
+
+// Steps both machines until max instructions, a halt or a divergence
+static bool run_steps(lockstep_t* ls, unsigned max, unsigned* steps, uint32_t* pc_low, uint32_t* pc_high) {
+    machine_t* a = ls->machine[0];
+    machine_t* b = ls->machine[1];
+    while (*steps < max && !a->cpu->halted && !b->cpu->halted) {
+        unsigned n = max - *steps < ls->block ? max - *steps : ls->block;
+        uint32_t pc = a->cpu->registers[15] & ADDR_MASK;
+        if (pc < *pc_low) *pc_low = pc;
+        if (pc > *pc_high) *pc_high = pc;
+
+        entry_state_t entry[2];
+        unsigned done[2];
+        save_entry(&entry[0], a);
+        save_entry(&entry[1], b);
+        run_block(ls, n, done);
+        if (done[0] != done[1] || !same_state(ls)) {
+            find_divergence(ls, entry, n, done);
+            ls->diverged = true;
+            return false;
+        }
+        *steps += done[0];
+        ls->steps += done[0];
+    }
+    return true;
+}
+
+void lockstep_restart(lockstep_t* ls) {
+    ls->steps = 0;
+    ls->diverged = false;
+    for (unsigned i = 0; i < LOCKSTEP_TRACE; i++) {
+        ls->trace[i] = 0xFFFFFFFF;
+    }
+}
+
+bool lockstep_run(lockstep_t* ls, unsigned steps) {
+    uint32_t pc_low = 0xFFFFFFFF, pc_high = 0;
+    unsigned done = 0;
+    if (ls->diverged) return false;
+    return run_steps(ls, steps, &done, &pc_low, &pc_high) && !ls->machine[0]->cpu->halted;
+}
+
+bool lockstep_run_frame(lockstep_t* ls, retro_video_refresh_t video_cb) {
+    machine_t* a = ls->machine[0];
+    machine_t* b = ls->machine[1];
+    if (ls->diverged) return false;
+    bool begun_a = machine_frame_begin(a);
+    bool begun_b = machine_frame_begin(b);
+    if (!begun_a || !begun_b) return false;
+
+    uint32_t pc_low = 0xFFFFFFFF, pc_high = 0;
+    unsigned steps = 0;
+    if (!run_steps(ls, MACHINE_FRAME_STEPS, &steps, &pc_low, &pc_high)) return false;
+
+    bool running_a = machine_frame_end(a, video_cb, pc_low, pc_high, steps);
+    bool running_b = machine_frame_end(b, video_cb ? null_video : NULL, pc_low, pc_high, steps);
+    return running_a && running_b;
+}
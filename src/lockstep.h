@@ -0,0 +1,35 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <cstdint>
+#include "machine.h"
+
+// Differential execution: a machine and a copy-on-write clone of it run the
+// same frames under two CPU engines, compared every `block` instructions on
+// registers, PSRs, halt state and the guest writes of that block. The first
+// divergence stops the run with a report: the instruction, its entry state
+// (enough to replay it alone), both sides' differences and recent history.
+// Blocks longer than one instruction are rolled back and replayed one step at
+// a time to find the instruction, unless the block did I/O (not undoable); the
+// history then still lists every instruction the reference ran in the block.
+#define LOCKSTEP_TRACE 16         // Instructions of history in a report
+
+typedef struct {
+    machine_t* machine[2];        // [0] is the caller's machine, [1] its clone
+    const cpu_engine_t* engine[2];
+    unsigned block;               // Instructions per comparison
+    uint64_t steps;               // Instructions compared so far
+    bool diverged;
+    memory_write_log_t log[2];
+    uint32_t trace[LOCKSTEP_TRACE]; // Recent fetch PCs of machine[0]
+    unsigned trace_pos;
+} lockstep_t;
+
+bool lockstep_init(lockstep_t* ls, machine_t* m, const cpu_engine_t* reference, const cpu_engine_t* engine, unsigned block);
+void lockstep_release(lockstep_t* ls); // Destroys the clone; the caller's machine stays
+bool lockstep_run_frame(lockstep_t* ls, retro_video_refresh_t video_cb); // false = stopped or diverged
+// CPU only, no timers, interrupts or rendering (see fuzz.cpp); false = halted or diverged
+bool lockstep_run(lockstep_t* ls, unsigned steps);
+void lockstep_restart(lockstep_t* ls); // After resetting both machines: clears divergence and history
+
+#endif
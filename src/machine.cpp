@@ -0,0 +1,384 @@
+#include "machine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "hostfs.h"
+#include "hle.h"
+#include "coverage.h"
+#include "trace.h"
+#include "statehash.h"
+#include "romprofile.h"
+
+static const unsigned DEFAULT_WIDTH = 640;  // Match VIDC default
+static const unsigned DEFAULT_HEIGHT = 480; // Match VIDC default
+
+// Power-on device registers and content, restored by machine_reset
+typedef struct {
+    ioc_t ioc;
+    memc_t memc;
+    vidc_t vidc;
+    char image_path[MACHINE_PATH_MAX]; // Empty = ROM boot
+    char command_line[MACHINE_PATH_MAX];
+} machine_template_t;
+
+// Each machine is one allocation, laid out hot to cold in cache-line aligned
+// blocks: CPU registers and flags, then device state led by the pending
+// interrupts and cycle counter cpu_step polls, then memory state whose page
+// maps trail it. Guest RAM/ROM is its own page-aligned mapping (see
+// memory_init); frame buffers follow the mode and are resized separately.
+typedef struct {
+    machine_t machine;         // Must stay first: machine_t* is the arena pointer
+    alignas(64) arm3_cpu_t cpu;
+    alignas(64) io_t io;
+    alignas(64) memory_t mem;
+    alignas(64) machine_template_t reset; // Cold, only read on reset
+    watchdog_t watchdog;
+    debug_t debug;
+    machine_status_t* status;  // Exported status block (NULL = not exported)
+    int status_fd;
+    uint8_t* coverage;         // Owned bitmap behind cpu.coverage (NULL = off)
+    trace_t* trace;            // Owned trace behind cpu.trace (NULL = off)
+    statehash_t* hash;         // Running state hash (NULL = not started)
+    rom_profile_t profile;     // Behind cpu.profile while name is set
+} machine_arena_t;
+
+static machine_arena_t* arena_alloc(void) {
+    size_t size = (sizeof(machine_arena_t) + 63) & ~(size_t)63;
+    machine_arena_t* arena = (machine_arena_t*)aligned_alloc(64, size);
+    if (!arena) {
+        printf("Failed to allocate machine\n");
+        return NULL;
+    }
+    arena->machine.cpu = &arena->cpu;
+    arena->machine.mem = &arena->mem;
+    arena->machine.io = &arena->io;
+    arena->status = NULL;
+    arena->status_fd = -1;
+    arena->coverage = NULL;
+    arena->trace = NULL;
+    arena->hash = NULL;
+    arena->profile.name[0] = '\0';
+    watchdog_init(&arena->watchdog, NULL);
+    return arena;
+}
+
+// ROM shortcuts from the profile database: the one for this ROM image, or
+// with name the one called that. A ROM without a profile runs without any.
+static bool select_profile(machine_arena_t* arena, const char* name) {
+    machine_t* m = &arena->machine;
+    uint32_t crc = rom_profile_crc(m->mem->rom, m->mem->rom_size);
+    bool found = rom_profile_find(ROM_PROFILE_DB, crc, name, &arena->profile);
+    if (found) {
+        printf("ROM crc32 %08X: profile %s, %u hooks%s\n", crc, arena->profile.name, arena->profile.hook_count,
+               arena->profile.hle_cmos_read ? ", native CMOS reads" : "");
+    } else if (name) {
+        printf("No profile %s in %s\n", name, ROM_PROFILE_DB);
+    } else {
+        printf("ROM crc32 %08X: no profile in %s, running without shortcuts\n", crc, ROM_PROFILE_DB);
+    }
+    m->cpu->profile = found ? &arena->profile : NULL;
+    memset(m->cpu->loop_counts, 0, sizeof(m->cpu->loop_counts)); // Counts belong to the old profile's hooks
+    m->io->cmos.hle = found && arena->profile.hle_cmos_read;
+    return found;
+}
+
+// Initial content: the HLE image, or the ROM boot test pattern
+static bool power_on(machine_arena_t* arena) {
+    machine_t* m = &arena->machine;
+    if (arena->reset.image_path[0]) {
+        m->mem->is_boot_mode = 0; // No ROM to alias at 0
+        if (!hle_load_image(m->cpu, arena->reset.image_path, arena->reset.command_line)) {
+            printf("Failed to load image: %s\n", arena->reset.image_path);
+            return false;
+        }
+        return true;
+    }
+
+    // Write test data to video memory (assuming 4 bits per pixel)
+    uint8_t* video_mem = m->mem->ram + m->io->memc.vinit;
+    for (uint32_t i = 0; i < m->io->frame_width * m->io->frame_height; i++) {
+        video_mem[i] = (i % 16); // Cycle through palette entries 0-15
+    }
+    return true;
+}
+
+machine_t* machine_create(const char* rom_path, const char* image_path, const char* command_line) {
+    machine_arena_t* arena = arena_alloc();
+    if (!arena) return NULL;
+    machine_t* m = &arena->machine;
+
+    if (!io_init(m->io, DEFAULT_WIDTH, DEFAULT_HEIGHT)) {
+        printf("Failed to initialize I/O module\n");
+        free(arena);
+        return NULL;
+    }
+    pcf8583_load(&m->io->cmos, "cmos.ram");
+    arena->reset.ioc = m->io->ioc;
+    arena->reset.memc = m->io->memc;
+    arena->reset.vidc = m->io->vidc;
+    snprintf(arena->reset.image_path, MACHINE_PATH_MAX, "%s", image_path ? image_path : "");
+    snprintf(arena->reset.command_line, MACHINE_PATH_MAX, "%s", command_line ? command_line : arena->reset.image_path);
+
+    if (!memory_init(m->mem, image_path ? NULL : rom_path, MACHINE_ROM_BASE, m->io)) {
+        printf("Failed to create memory system with ROM: %s\n", rom_path ? rom_path : "(none)");
+        io_release(m->io);
+        free(arena);
+        return NULL;
+    }
+
+    cpu_init(m->cpu, m->mem);
+    m->cpu->hostfs = hostfs_create("hostfs");
+    debug_init(&arena->debug, m->cpu, m->mem);
+    if (!image_path) select_profile(arena, NULL);
+
+    if (!power_on(arena)) {
+        machine_destroy(m);
+        return NULL;
+    }
+    return m;
+}
+
+void machine_destroy(machine_t* m) {
+    if (!m) return;
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (arena->status) munmap(arena->status, sizeof(machine_status_t));
+    if (arena->status_fd >= 0) close(arena->status_fd);
+    coverage_destroy(arena->coverage);
+    trace_close(arena->trace);
+    free(arena->hash);
+    hostfs_destroy(m->cpu->hostfs);
+    memory_release(m->mem);
+    io_release(m->io);
+    free(m); // The arena
+}
+
+machine_t* machine_clone(machine_t* src) {
+    machine_arena_t* arena = arena_alloc();
+    if (!arena) return NULL;
+    machine_t* m = &arena->machine;
+
+    if (!io_clone(m->io, src->io)) {
+        free(arena);
+        return NULL;
+    }
+    if (!memory_clone(m->mem, src->mem, m->io)) {
+        printf("Failed to clone machine\n");
+        io_release(m->io);
+        free(arena);
+        return NULL;
+    }
+    *m->cpu = *src->cpu;
+    m->cpu->mem = m->mem;
+    m->cpu->io = m->io;
+    m->cpu->hostfs = src->cpu->hostfs ? hostfs_create(src->cpu->hostfs->root) : NULL;
+    m->cpu->coverage = NULL; // The bitmap and trace stay with src
+    m->cpu->trace = NULL;
+    arena->profile = ((machine_arena_t*)src)->profile;
+    m->cpu->profile = src->cpu->profile ? &arena->profile : NULL;
+    arena->reset = ((machine_arena_t*)src)->reset;
+    arena->watchdog = ((machine_arena_t*)src)->watchdog;
+    debug_init(&arena->debug, m->cpu, m->mem);
+    return m;
+}
+
+bool machine_reset(machine_t* m) {
+    machine_arena_t* arena = (machine_arena_t*)m;
+    io_t* io = m->io;
+    io->ioc = arena->reset.ioc;
+    io->memc = arena->reset.memc;
+    io->vidc = arena->reset.vidc; // Dirty flags included, so caches rebuild
+    io->irq_pending = false;
+    io->fiq_pending = false;
+    io->cycles = 0;
+    io->frame_count = 0;
+    io->render_full = 3;
+    // CMOS RAM is battery backed and survives
+
+    if (!memory_reset(m->mem)) return false;
+
+    struct hostfs* hostfs = m->cpu->hostfs;
+    bool log_steps = m->cpu->log_steps;
+    hostfs_close_all(hostfs);
+    cpu_init(m->cpu, m->mem);
+    m->cpu->hostfs = hostfs;
+    m->cpu->log_steps = log_steps;
+    m->cpu->coverage = arena->coverage; // Accumulates across resets
+    m->cpu->trace = arena->trace;
+    m->cpu->profile = arena->profile.name[0] ? &arena->profile : NULL;
+    watchdog_init(&arena->watchdog, &arena->watchdog.config);
+    return power_on(arena);
+}
+
+bool machine_export(machine_t* m) {
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (arena->status) return true;
+    int ram_fd = memory_export(m->mem);
+    if (ram_fd < 0) return false;
+
+    // Sealed against new writable mappings, so readers can only map it read-only
+    int fd = memfd_create("acornarc-status", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, sizeof(machine_status_t)) != 0) {
+        printf("Failed to create status block\n");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* status = mmap(NULL, sizeof(machine_status_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (status == MAP_FAILED) {
+        printf("Failed to map status block\n");
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL);
+    arena->status = (machine_status_t*)status;
+    arena->status_fd = fd;
+    memset(arena->status, 0, sizeof(machine_status_t));
+    arena->status->magic = MACHINE_STATUS_MAGIC;
+    arena->status->version = MACHINE_STATUS_VERSION;
+    printf("Exported RAM at /proc/%d/fd/%d, status at /proc/%d/fd/%d\n", (int)getpid(), ram_fd, (int)getpid(), fd);
+    return true;
+}
+
+static void publish_status(machine_t* m, machine_status_t* status) {
+    uint32_t sequence = status->sequence;
+    __atomic_store_n(&status->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    status->halted = m->cpu->halted;
+    status->exit_code = m->cpu->exit_code;
+    memcpy(status->registers, m->cpu->registers, sizeof(status->registers));
+    status->cpsr = m->cpu->cpsr;
+    status->cycles = m->io->cycles;
+    status->frame = m->io->frame_count;
+    __atomic_store_n(&status->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+bool machine_frame_begin(machine_t* m) {
+    arm3_cpu_t* cpu = m->cpu;
+    io_t* io = m->io;
+
+    // Bring back pages compressed by memory_suspend before anything reads RAM
+    if (m->mem->store && !memory_resume(m->mem)) return false;
+
+    cpu->idle = false; // A new slice: the idle loop may now see an interrupt
+    // Update timers and check for interrupts
+    io_update_timers(io);
+
+    // Check for interrupts and handle them
+    if (io_get_irq(io) && !(cpu->cpsr & PSR_I)) {
+        // IRQ: Save CPSR, switch to IRQ mode, disable IRQs, jump to vector
+        cpu->spsr = cpu->spsr_irq = cpu->cpsr; // Save CPSR to IRQ mode SPSR
+        cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_IRQ | PSR_I;
+        cpu->registers[14] = cpu->registers[15] + 4; // Save return address (PC + 4)
+        cpu->registers[15] = 0x00000018 & ADDR_MASK; // IRQ vector
+        printf("IRQ triggered\n");
+    }
+    if (io_get_fiq(io) && !(cpu->cpsr & PSR_F)) {
+        // FIQ: Save CPSR, switch to FIQ mode, disable FIQs, jump to vector
+        cpu->spsr = cpu->spsr_fiq = cpu->cpsr; // Save CPSR to FIQ mode SPSR
+        cpu->cpsr = (cpu->cpsr & ~PSR_MODE_MASK) | MODE_FIQ | PSR_F;
+        cpu->registers[14] = cpu->registers[15] + 4; // Save return address (PC + 4)
+        cpu->registers[15] = 0x0000001C & ADDR_MASK; // FIQ vector
+        printf("FIQ triggered\n");
+    }
+    return true;
+}
+
+static bool frame_end(machine_t* m, retro_video_refresh_t video_cb, uint32_t pc_low, uint32_t pc_high, unsigned steps) {
+    arm3_cpu_t* cpu = m->cpu;
+    io_t* io = m->io;
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (!cpu->halted) watchdog_frame(&arena->watchdog, m, pc_low, pc_high, steps);
+    if (cpu->halted) {
+        if (cpu->stop_reason == CPU_STOP_EXIT) {
+            printf("Guest exited with code %u\n", cpu->exit_code);
+        } else {
+            printf("Stopped: %s\n", watchdog_status_name(m));
+            debug_report(&arena->debug, stdout);
+            watchdog_report(&arena->watchdog, m, stdout);
+        }
+        return false;
+    }
+
+    // Render the frame using the VIDC implementation
+    if (video_cb) {
+        io_render_frame(io, m->mem, video_cb);
+    }
+    if (io->frame_count % MEMORY_AGE_TICK_FRAMES == 0) {
+        memory_age_pages(m->mem);
+    }
+    return true;
+}
+
+bool machine_frame_end(machine_t* m, retro_video_refresh_t video_cb, uint32_t pc_low, uint32_t pc_high, unsigned steps) {
+    bool running = frame_end(m, video_cb, pc_low, pc_high, steps);
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (arena->status) publish_status(m, arena->status);
+    return running;
+}
+
+bool machine_run_frame(machine_t* m, retro_video_refresh_t video_cb) {
+    arm3_cpu_t* cpu = m->cpu;
+    if (!machine_frame_begin(m)) return false;
+
+    // Execute CPU cycles (160,000 cycles per frame at 8MHz, 50Hz)
+    uint32_t pc_low = 0xFFFFFFFF, pc_high = 0;
+    unsigned steps = 0;
+    for (; steps < MACHINE_FRAME_STEPS && !cpu->halted && !cpu->idle; steps++) {
+        uint32_t pc = cpu->registers[15] & ADDR_MASK;
+        if (pc < pc_low) pc_low = pc;
+        if (pc > pc_high) pc_high = pc;
+        cpu_step(cpu);
+    }
+    return machine_frame_end(m, video_cb, pc_low, pc_high, steps);
+}
+
+void machine_set_watchdog(machine_t* m, const watchdog_config_t* config) {
+    watchdog_init(&((machine_arena_t*)m)->watchdog, config);
+}
+
+uint8_t* machine_coverage(machine_t* m) {
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (!arena->coverage) arena->coverage = coverage_create();
+    m->cpu->coverage = arena->coverage;
+    return arena->coverage;
+}
+
+bool machine_trace(machine_t* m, const char* path) {
+    machine_arena_t* arena = (machine_arena_t*)m;
+    trace_close(arena->trace);
+    arena->trace = path ? trace_open(path) : NULL;
+    m->cpu->trace = arena->trace;
+    return !path || arena->trace;
+}
+
+bool machine_use_profile(machine_t* m, const char* name) {
+    if (!m->mem->rom_size) return false; // HLE images run no ROM code
+    return select_profile((machine_arena_t*)m, name);
+}
+
+bool machine_suspend(machine_t* m, unsigned min_age) {
+    return memory_suspend(m->mem, min_age);
+}
+
+uint64_t machine_state_hash(machine_t* m) {
+    machine_arena_t* arena = (machine_arena_t*)m;
+    if (!arena->hash) {
+        arena->hash = (statehash_t*)malloc(sizeof(statehash_t));
+        if (!arena->hash) {
+            printf("Failed to allocate state hash\n");
+            return 0;
+        }
+        statehash_init(arena->hash, m->mem);
+    }
+    return statehash_update(arena->hash, m->cpu, m->mem, m->io);
+}
+
+debug_t* machine_debug(machine_t* m) {
+    return &((machine_arena_t*)m)->debug;
+}
+
+void machine_report(machine_t* m, FILE* out) {
+    watchdog_report(&((machine_arena_t*)m)->watchdog, m, out);
+}
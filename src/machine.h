@@ -0,0 +1,89 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <cstdint>
+#include <libretro.h> // For retro_video_refresh_t
+#include "cpu.h"
+#include "memory.h"
+#include "io.h"
+#include "watchdog.h"
+#include "debug.h"
+
+// One emulated Archimedes: CPU, memory and I/O plus the per-frame run loop.
+// Shared by the libretro core and the headless runner.
+#define MACHINE_FRAME_STEPS 160000  // CPU steps per 50Hz frame (8MHz)
+#define MACHINE_ROM_BASE 0x03800000
+#define MACHINE_PATH_MAX 1024
+
+// Read-only status block published by machine_export, updated once per frame.
+// Readers retry while sequence is odd or changed during the read (seqlock).
+#define MACHINE_STATUS_MAGIC 0x53435241 // "ARCS"
+#define MACHINE_STATUS_VERSION 1
+
+typedef struct {
+    uint32_t magic;            // MACHINE_STATUS_MAGIC
+    uint32_t version;          // MACHINE_STATUS_VERSION
+    uint32_t sequence;         // Odd while an update is in progress
+    uint32_t halted;           // Guest has exited
+    uint32_t exit_code;
+    uint32_t registers[16];
+    uint32_t cpsr;
+    uint64_t cycles;
+    uint64_t frame;
+} machine_status_t;
+
+typedef struct machine {
+    arm3_cpu_t* cpu;
+    memory_t* mem;
+    io_t* io;
+} machine_t;
+
+// rom_path boots the ROM; image_path instead runs an AIF/raw binary under the HLE OS
+machine_t* machine_create(const char* rom_path, const char* image_path, const char* command_line);
+void machine_destroy(machine_t* m);
+// Duplicate a stopped machine: device state is copied, RAM and ROM pages are
+// shared copy-on-write. Call from the thread that runs src; the clone can then
+// run on any thread independently of src.
+machine_t* machine_clone(machine_t* src);
+// Full power-on reset: device registers from a template captured at creation,
+// RAM dropped in bulk, then the ROM boot or HLE image starts again
+bool machine_reset(machine_t* m);
+// Share RAM/ROM and a status block with external tools through memfds; logs
+// the /proc paths to mmap. Clones are not exported.
+bool machine_export(machine_t* m);
+bool machine_run_frame(machine_t* m, retro_video_refresh_t video_cb); // false = stopped
+// The two halves of machine_run_frame, for callers that step the CPU
+// themselves (see lockstep.h): begin runs timers and interrupt entry; end
+// takes the fetch PC range and step count, then runs the watchdog, renders
+// and publishes status.
+bool machine_frame_begin(machine_t* m);
+bool machine_frame_end(machine_t* m, retro_video_refresh_t video_cb, uint32_t pc_low, uint32_t pc_high, unsigned steps);
+void machine_set_watchdog(machine_t* m, const watchdog_config_t* config); // NULL = off
+void machine_report(machine_t* m, FILE* out); // Structured status and state dump
+// Breakpoints and watchpoints; a hit makes machine_run_frame return false with
+// the CPU stopped, and debug_resume continues from there
+debug_t* machine_debug(machine_t* m);
+// Start recording executed instructions (coverage.h); the bitmap is kept
+// across resets and freed with the machine. NULL = out of memory. Clones
+// do not record.
+uint8_t* machine_coverage(machine_t* m);
+// Write every executed instruction to a binary trace file (trace.h), replacing
+// any trace already open; NULL completes the open trace. Otherwise the file is
+// completed when the machine is destroyed.
+bool machine_trace(machine_t* m, const char* path);
+// Use the named ROM profile (romprofile.h) whatever the ROM's crc32, e.g.
+// to try one on a ROM dump not yet in the database; NULL selects by crc32 as
+// machine_create does. false = no such profile.
+bool machine_use_profile(machine_t* m, const char* name);
+// Compress RAM pages unwritten for at least min_age seconds of emulated time
+// (0 = all pages) while the machine is not running, e.g. paused or waiting as
+// a fork-server template (memory_suspend). The next frame brings them back;
+// anything else reading RAM must call memory_resume first.
+bool machine_suspend(machine_t* m, unsigned min_age);
+// Hash of guest-visible machine state (statehash.h). The first call hashes
+// all of RAM; later ones rehash only pages written since, so it is cheap
+// enough to take every frame or, when narrowing down a divergence, every
+// instruction. Equal runs give equal hashes whatever the host. 0 = out of memory.
+uint64_t machine_state_hash(machine_t* m);
+
+#endif
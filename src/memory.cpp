@@ -1,31 +1,45 @@
 #include "memory.h"
 #include "io.h" // Include io.h to get the full definition of io_t
+#include "debug.h"
 #include <cstdint>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <zlib.h>
 
-memory_t* memory_create(const char* jfd_path, uint32_t rom_base, io_t* io) {    
-    memory_t* mem = (memory_t*)malloc(sizeof(memory_t));
-    if (!mem) {
-        printf("Failed to allocate memory struct\n");
-        return NULL;
-    }
-    
-    mem->ram = (uint8_t*)calloc(RAM_SIZE, 1); 
-    mem->rom = (uint8_t*)calloc(ROM_SIZE, 1); 
+#define ROM_RAM_COPY 0x00E00000 // Where the loader also places a copy of the ROM
+
+// Let KSM merge identical pages with other instances (see memory_set_mergeable)
+static void merge_hint(memory_t* mem) {
+    if (mem->mergeable) madvise(mem->ram, MEMORY_IMAGE_SIZE, MADV_MERGEABLE);
+}
+
+bool memory_init(memory_t* mem, const char* jfd_path, uint32_t rom_base, io_t* io) {
+    // Anonymous mapping: zero-filled and only backed once touched
+    void* image = mmap(NULL, MEMORY_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    mem->ram = image == MAP_FAILED ? NULL : (uint8_t*)image;
+    mem->rom = mem->ram ? mem->ram + RAM_SIZE : NULL;
     mem->rom_size = 0;
     mem->rom_base = rom_base ? rom_base : ROM_DEFAULT_BASE;
     mem->floppy_offset = 0;
     mem->io = io;
     mem->is_boot_mode = 1;
+    mem->image_fd = -1;
+    mem->mergeable = false;
+    mem->export_fd = -1;
+    mem->store = NULL;
+    mem->write_log = NULL;
+    mem->debug = NULL;
+    memset(mem->page_dirty, PAGE_DIRTY_ALL, sizeof(mem->page_dirty));
+    memset(mem->page_age, 0, sizeof(mem->page_age));
+    memset(mem->page_debug, 0, sizeof(mem->page_debug));
 
-    if (!mem->ram || !mem->rom) {
+    if (!mem->ram) {
         printf("Failed to allocate RAM or ROM\n");
-        free(mem->ram);
-        free(mem->rom);
-        free(mem);
-        return NULL;
+        return false;
     }
 
     if (jfd_path) {
@@ -44,8 +58,8 @@ memory_t* memory_create(const char* jfd_path, uint32_t rom_base, io_t* io) {
             } else {
                 printf("Loaded ROM: %zu bytes into ROM at 0x%08X\n", mem->rom_size, mem->rom_base);
                 // Copy ROM to RAM at 0x00E00000 directly
-                if (mem->rom_size <= RAM_SIZE - 0x00E00000) {
-                    memcpy(mem->ram + 0x00E00000, mem->rom, mem->rom_size);
+                if (mem->rom_size <= RAM_SIZE - ROM_RAM_COPY) {
+                    memcpy(mem->ram + ROM_RAM_COPY, mem->rom, mem->rom_size);
                     printf("Initialized RAM at 0x00E00000 with ROM contents\n");
                 } else {
                     printf("Error: ROM size (%zu) exceeds available RAM space at 0x00E00000\n", mem->rom_size);
@@ -55,22 +69,344 @@ memory_t* memory_create(const char* jfd_path, uint32_t rom_base, io_t* io) {
         }
     }
 
+    return true;
+}
+
+static void store_free(memory_t* mem);
+
+bool memory_reset(memory_t* mem) {
+    store_free(mem); // Suspended content is discarded with the rest of RAM
+    // Map fresh zero pages over RAM: the old pages are dropped in bulk, so the
+    // cost follows the mapping count rather than 16MB of clearing. Exported RAM
+    // has to stay on its file, where punching a hole does the same.
+    if (mem->export_fd >= 0) {
+        if (fallocate(mem->export_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, RAM_SIZE) != 0) {
+            printf("Failed to clear exported RAM for reset\n");
+            return false;
+        }
+    } else if (mmap(mem->ram, RAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        printf("Failed to remap RAM for reset\n");
+        return false;
+    }
+    merge_hint(mem); // New mappings start unmergeable
+    if (mem->rom_size && mem->rom_size <= RAM_SIZE - ROM_RAM_COPY) {
+        memcpy(mem->ram + ROM_RAM_COPY, mem->rom, mem->rom_size);
+    }
+    mem->is_boot_mode = 1;
+    memset(mem->page_dirty, PAGE_DIRTY_ALL, sizeof(mem->page_dirty));
+    memset(mem->page_age, 0, sizeof(mem->page_age));
+    return true;
+}
+
+void memory_release(memory_t* mem) {
+    store_free(mem);
+    if (mem->ram) munmap(mem->ram, MEMORY_IMAGE_SIZE);
+    if (mem->image_fd >= 0) close(mem->image_fd);
+    if (mem->export_fd >= 0) close(mem->export_fd);
+    mem->ram = mem->rom = NULL;
+    mem->image_fd = -1;
+    mem->export_fd = -1;
+}
+
+memory_t* memory_create(const char* jfd_path, uint32_t rom_base, io_t* io) {
+    memory_t* mem = (memory_t*)malloc(sizeof(memory_t));
+    if (!mem) {
+        printf("Failed to allocate memory struct\n");
+        return NULL;
+    }
+    if (!memory_init(mem, jfd_path, rom_base, io)) {
+        free(mem);
+        return NULL;
+    }
     return mem;
 }
 
 void memory_destroy(memory_t* mem) {
     if (mem) {
-        free(mem->ram);
-        free(mem->rom);
+        memory_release(mem);
         free(mem);
     }
 }
 
-uint32_t memory_read_word(memory_t* mem, uint32_t address) {
-    static uint32_t last_logged_address = 0xFFFFFFFF;
-    static int log_counter = 0;
+bool memory_page_is_zero(const uint8_t* page) {
+    const uint64_t* words = (const uint64_t*)page;
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i]) return false;
+    }
+    return true;
+}
 
-    address &= ADDR_MASK;
+// Copy the RAM/ROM image into a new memfd; zero pages are left as holes
+static int write_image(memory_t* mem, const char* name) {
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, MEMORY_IMAGE_SIZE) != 0) {
+        printf("Failed to create %s\n", name);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    for (size_t offset = 0; offset < MEMORY_IMAGE_SIZE; offset += PAGE_SIZE) {
+        if (memory_page_is_zero(mem->ram + offset)) continue;
+        if (pwrite(fd, mem->ram + offset, PAGE_SIZE, offset) != (ssize_t)PAGE_SIZE) {
+            printf("Failed to write %s\n", name);
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// Make the RAM/ROM image shareable: write it to a memfd and remap our own view
+// MAP_PRIVATE onto it, so this machine and its clones share every page until
+// one of them writes. The memfd is reused for further clones while no page has
+// changed; otherwise a new one is made, as existing clones still map the old.
+static int memory_share(memory_t* mem) {
+    bool changed = mem->image_fd < 0;
+    for (size_t page = 0; page < RAM_PAGES && !changed; page++) {
+        changed = mem->page_dirty[page] & PAGE_DIRTY_CLONE;
+    }
+    if (!changed) return mem->image_fd;
+
+    int fd = write_image(mem, "acornarc-ram");
+    if (fd < 0) return -1;
+    // Exported RAM must stay on its own shared file; clones still share the
+    // snapshot with each other, just not with the source
+    if (mem->export_fd < 0) {
+        if (mmap(mem->ram, MEMORY_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            printf("Failed to remap RAM onto shared image\n");
+            close(fd);
+            return -1;
+        }
+        merge_hint(mem);
+    }
+    if (mem->image_fd >= 0) close(mem->image_fd);
+    mem->image_fd = fd;
+    for (size_t page = 0; page < RAM_PAGES; page++) {
+        mem->page_dirty[page] &= ~PAGE_DIRTY_CLONE;
+    }
+    return fd;
+}
+
+int memory_export(memory_t* mem) {
+    if (mem->export_fd >= 0) return mem->export_fd;
+    if (mem->store && !memory_resume(mem)) return -1;
+    int fd = write_image(mem, "acornarc-export");
+    if (fd < 0) return -1;
+    if (mmap(mem->ram, MEMORY_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        printf("Failed to remap RAM onto exported image\n");
+        close(fd);
+        return -1;
+    }
+    mem->export_fd = fd;
+    return fd;
+}
+
+bool memory_map_ram(memory_t* mem, int fd, off_t offset) {
+    if (mem->export_fd >= 0) return false; // Has to stay on the exported file
+    if (mmap(mem->ram, RAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        printf("Failed to map RAM from file\n");
+        return false;
+    }
+    store_free(mem); // Suspended pages belonged to the replaced contents
+    merge_hint(mem);
+    memset(mem->page_dirty, PAGE_DIRTY_ALL, sizeof(mem->page_dirty));
+    memset(mem->page_age, 0, sizeof(mem->page_age));
+    return true;
+}
+
+// Give a page's memory back; it reads as zero afterwards unless it falls back
+// to a clone's shared image
+static void drop_pages(memory_t* mem, size_t offset, size_t length) {
+    if (mem->export_fd >= 0) {
+        fallocate(mem->export_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length);
+    } else {
+        madvise(mem->ram + offset, length, MADV_DONTNEED);
+    }
+}
+
+bool memory_clone(memory_t* mem, memory_t* src, io_t* io) {
+    if (src->store && !memory_resume(src)) return false;
+    int fd = memory_share(src);
+    if (fd < 0) return false;
+    void* image = mmap(NULL, MEMORY_IMAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (image == MAP_FAILED) {
+        printf("Failed to map shared RAM image\n");
+        return false;
+    }
+    *mem = *src;
+    mem->ram = (uint8_t*)image;
+    mem->rom = mem->ram + RAM_SIZE;
+    mem->io = io;
+    mem->image_fd = -1; // The mapping keeps the file alive
+    mem->export_fd = -1;
+    mem->store = NULL;
+    mem->write_log = NULL;
+    mem->debug = NULL; // Breakpoints and watchpoints stay with src
+    memset(mem->page_dirty, PAGE_DIRTY_ALL, sizeof(mem->page_dirty));
+    memset(mem->page_debug, 0, sizeof(mem->page_debug));
+    merge_hint(mem);
+    return true;
+}
+
+void memory_set_mergeable(memory_t* mem, bool mergeable) {
+    if (mergeable == mem->mergeable) return;
+    mem->mergeable = mergeable;
+    if (!mergeable) {
+        madvise(mem->ram, MEMORY_IMAGE_SIZE, MADV_UNMERGEABLE);
+        return;
+    }
+    merge_hint(mem);
+    FILE* file = fopen("/sys/kernel/mm/ksm/run", "r");
+    if (file) {
+        if (fgetc(file) != '1') printf("Page dedup: KSM is not running (/sys/kernel/mm/ksm/run), no pages will merge\n");
+        fclose(file);
+    }
+}
+
+// Sum the KSM column of /proc/self/smaps over the mappings that make up RAM/ROM
+size_t memory_merged_bytes(memory_t* mem) {
+    FILE* file = fopen("/proc/self/smaps", "r");
+    if (!file) return 0;
+    uintptr_t low = (uintptr_t)mem->ram;
+    uintptr_t high = low + MEMORY_IMAGE_SIZE;
+    bool inside = false;
+    size_t total_kb = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long start, end;
+        size_t kb;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            inside = start < high && end > low;
+        } else if (inside && sscanf(line, "KSM: %zu kB", &kb) == 1) {
+            total_kb += kb;
+        }
+    }
+    fclose(file);
+    return total_kb * 1024;
+}
+
+// Compressed cold pages. Page data is packed back to back in one buffer;
+// all-zero pages take no space.
+#define PAGE_RESIDENT 0
+#define PAGE_ZERO 1
+#define PAGE_PACKED 2
+
+typedef struct page_store {
+    uint8_t state[RAM_PAGES];  // PAGE_RESIDENT / PAGE_ZERO / PAGE_PACKED
+    uint32_t offset[RAM_PAGES]; // Into data, PAGE_PACKED only
+    uint16_t size[RAM_PAGES];
+    uint8_t* data;
+    size_t used;
+    size_t capacity;
+} page_store_t;
+
+static void store_free(memory_t* mem) {
+    if (!mem->store) return;
+    free(mem->store->data);
+    free(mem->store);
+    mem->store = NULL;
+}
+
+void memory_age_pages(memory_t* mem) {
+    for (size_t page = 0; page < RAM_PAGES; page++) {
+        if (mem->page_dirty[page] & PAGE_DIRTY_AGE) {
+            mem->page_dirty[page] &= ~PAGE_DIRTY_AGE;
+            mem->page_age[page] = 0;
+        } else if (mem->page_age[page] < 255) {
+            mem->page_age[page]++;
+        }
+    }
+}
+
+bool memory_suspend(memory_t* mem, unsigned min_age) {
+    if (mem->store) return true;
+    page_store_t* store = (page_store_t*)calloc(1, sizeof(page_store_t));
+    if (!store) return false;
+
+    // One deflate stream reset per page, with a window and hash table sized for
+    // a single page: resetting the default 64KB hash table costs more than a page
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, PAGE_SHIFT, 4, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(store);
+        return false;
+    }
+    uint8_t packed[PAGE_SIZE];
+    size_t pages = 0;
+    for (size_t page = 0; page < RAM_PAGES; page++) {
+        if (min_age && (mem->page_age[page] < min_age || (mem->page_dirty[page] & PAGE_DIRTY_AGE))) continue;
+        uint8_t* data = mem->ram + (page << PAGE_SHIFT);
+        if (memory_page_is_zero(data)) {
+            store->state[page] = PAGE_ZERO;
+        } else {
+            deflateReset(&zs);
+            zs.next_in = data;
+            zs.avail_in = PAGE_SIZE;
+            zs.next_out = packed;
+            zs.avail_out = sizeof(packed);
+            if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+                continue; // Incompressible, stays resident
+            }
+            size_t size = sizeof(packed) - zs.avail_out;
+            if (store->used + size > store->capacity) {
+                size_t capacity = store->capacity ? store->capacity * 2 : 256 * 1024;
+                uint8_t* grown = (uint8_t*)realloc(store->data, capacity);
+                if (!grown) break;
+                store->data = grown;
+                store->capacity = capacity;
+            }
+            memcpy(store->data + store->used, packed, size);
+            store->state[page] = PAGE_PACKED;
+            store->offset[page] = (uint32_t)store->used;
+            store->size[page] = (uint16_t)size;
+            store->used += size;
+        }
+        // The page's contents are now in the store; give the memory back
+        drop_pages(mem, page << PAGE_SHIFT, PAGE_SIZE);
+        pages++;
+    }
+    deflateEnd(&zs);
+    if (store->used) {
+        uint8_t* trimmed = (uint8_t*)realloc(store->data, store->used);
+        if (trimmed) store->data = trimmed;
+        store->capacity = store->used;
+    }
+    mem->store = store;
+    printf("Suspended %zu RAM pages (%zu KB) into %zu KB\n", pages, pages * PAGE_SIZE / 1024, store->used / 1024);
+    return true;
+}
+
+bool memory_resume(memory_t* mem) {
+    page_store_t* store = mem->store;
+    if (!store) return true;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK) return false;
+    bool ok = true;
+    for (size_t page = 0; page < RAM_PAGES; page++) {
+        uint8_t* data = mem->ram + (page << PAGE_SHIFT);
+        if (store->state[page] == PAGE_ZERO) {
+            // Dropped anonymous pages read back as zero; private file pages
+            // (clones) fall back to the shared image and need clearing
+            if (!memory_page_is_zero(data)) memset(data, 0, PAGE_SIZE);
+        } else if (store->state[page] == PAGE_PACKED) {
+            inflateReset(&zs);
+            zs.next_in = store->data + store->offset[page];
+            zs.avail_in = store->size[page];
+            zs.next_out = data;
+            zs.avail_out = PAGE_SIZE;
+            if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0) {
+                printf("Failed to restore RAM page 0x%08zX\n", page << PAGE_SHIFT);
+                ok = false;
+            }
+        }
+    }
+    inflateEnd(&zs);
+    store_free(mem);
+    return ok;
+}
+
+static uint32_t read_word(memory_t* mem, uint32_t address) {
+    address &= ADDR_MASK & ~3u; // Word accesses ignore A0/A1, as on the real bus
 
     if (mem->is_boot_mode) {
         // During boot mode, alias ROM at 0x00000000 and 0x02000000, and allow direct ROM access at rom_base
@@ -80,13 +416,6 @@ uint32_t memory_read_word(memory_t* mem, uint32_t address) {
             uint32_t rom_offset = (address < mem->rom_base) ? (address & (mem->rom_size - 1)) : (address - mem->rom_base);
             if (rom_offset <= mem->rom_size - 4) {
                 uint32_t* ptr = (uint32_t*)(mem->rom + rom_offset);
-                if (address < 0x0380A588 || address > 0x0380A594) {
-                    if (address != last_logged_address || log_counter % 1000 == 0) {
-                        printf("ROM read at 0x%08X (offset 0x%08X): 0x%08X\n", address, rom_offset, *ptr);
-                        last_logged_address = address;
-                    }
-                }
-                log_counter++;
                 return *ptr;
             }
         }
@@ -98,18 +427,9 @@ uint32_t memory_read_word(memory_t* mem, uint32_t address) {
         } else if (address >= mem->rom_base && address < mem->rom_base + mem->rom_size - 3) {
             uint32_t offset = address - mem->rom_base;
             uint32_t* ptr = (uint32_t*)(mem->rom + offset);
-            if (address < 0x0380A588 || address > 0x0380A594) {
-                if (address != last_logged_address || log_counter % 1000 == 0) {
-                    printf("ROM read at 0x%08X (offset 0x%08X): 0x%08X\n", address, offset, *ptr);
-                    last_logged_address = address;
-                }
-            }
-            log_counter++;
             return *ptr;
         } else if (address >= IO_BASE && address < IO_BASE + IO_SIZE - 3) {
-            uint32_t value = io_read_word(mem->io, mem, address);
-            printf("IO read at 0x%08X: 0x%08X\n", address, value);
-            return value;
+            return io_read_word(mem->io, mem, address);
         }
     }
 
@@ -118,8 +438,39 @@ uint32_t memory_read_word(memory_t* mem, uint32_t address) {
     return 0xFFFFFFFF; // Indicate invalid read
 }
 
+static void log_write(memory_t* mem, uint32_t address, uint32_t value, uint32_t size) {
+    memory_write_log_t* log = mem->write_log;
+    if (log->count == log->capacity) {
+        size_t capacity = log->capacity ? log->capacity * 2 : 64;
+        memory_write_t* writes = (memory_write_t*)realloc(log->writes, capacity * sizeof(memory_write_t));
+        if (!writes) return;
+        log->writes = writes;
+        log->capacity = capacity;
+    }
+    memory_write_t* write = &log->writes[log->count++];
+    write->address = address;
+    write->value = value;
+    write->size = size;
+    write->old = 0;
+    if (address + size <= RAM_BASE + RAM_SIZE) {
+        memcpy(&write->old, mem->ram + (address - RAM_BASE), size);
+    }
+}
+
+void memory_undo_writes(memory_t* mem, const memory_write_log_t* log) {
+    for (size_t i = log->count; i-- > 0;) {
+        const memory_write_t* write = &log->writes[i];
+        if (write->address + write->size <= RAM_BASE + RAM_SIZE) {
+            memcpy(mem->ram + (write->address - RAM_BASE), &write->old, write->size);
+            mem->page_dirty[(write->address - RAM_BASE) >> PAGE_SHIFT] = PAGE_DIRTY_ALL;
+        }
+    }
+}
+
 void memory_write_word(memory_t* mem, uint32_t address, uint32_t value) {
-    address &= ADDR_MASK;
+    address &= ADDR_MASK & ~3u; // Word accesses ignore A0/A1, as on the real bus
+    if (mem->write_log) log_write(mem, address, value, 4);
+    if (mem->page_debug[address >> PAGE_SHIFT] & PAGE_DEBUG_WRITE) debug_access(mem->debug, address, 4, value, DEBUG_WATCH_WRITE);
     if ((address >= mem->rom_base && address < mem->rom_base + mem->rom_size) ||
         (mem->is_boot_mode && (address >= 0x00000000 && address < 0x00200000))) {
         printf("Attempted write to ROM at 0x%08X ignored (boot mode: %d)\n", address, mem->is_boot_mode);
@@ -127,6 +478,7 @@ void memory_write_word(memory_t* mem, uint32_t address, uint32_t value) {
     } else if (address >= RAM_BASE && address < RAM_BASE + RAM_SIZE - 3) {
         uint32_t* ptr = (uint32_t*)(mem->ram + (address - RAM_BASE));
         *ptr = value;
+        mem->page_dirty[(address - RAM_BASE) >> PAGE_SHIFT] = PAGE_DIRTY_ALL;
     } else if (address >= IO_BASE && address < IO_BASE + IO_SIZE) {
         io_write_word(mem->io, mem, address, value);
     } else {
@@ -134,10 +486,11 @@ void memory_write_word(memory_t* mem, uint32_t address, uint32_t value) {
     }
 }
 
-uint8_t memory_read_byte(memory_t* mem, uint32_t address) {
+static uint8_t read_byte(memory_t* mem, uint32_t address) {
     address &= ADDR_MASK;
-    if ((address >= 0x02000000 && address < 0x02200000) || 
-        (address >= 0x00000000 && address < 0x00200000)) {
+    if (mem->is_boot_mode && mem->rom_size &&
+        ((address >= 0x02000000 && address < 0x02200000) ||
+         (address >= 0x00000000 && address < 0x00200000))) {
         uint32_t rom_offset = (address & 0x001FFFFF) % mem->rom_size;
         if (rom_offset < mem->rom_size) {
             return mem->rom[rom_offset];
@@ -162,15 +515,33 @@ uint8_t memory_read_byte(memory_t* mem, uint32_t address) {
     }
 }
 
+uint32_t memory_read_word(memory_t* mem, uint32_t address) {
+    uint32_t value = read_word(mem, address);
+    address &= ADDR_MASK & ~3u;
+    if (mem->page_debug[address >> PAGE_SHIFT] & PAGE_DEBUG_READ) debug_access(mem->debug, address, 4, value, DEBUG_WATCH_READ);
+    return value;
+}
+
+uint8_t memory_read_byte(memory_t* mem, uint32_t address) {
+    uint8_t value = read_byte(mem, address);
+    address &= ADDR_MASK;
+    if (mem->page_debug[address >> PAGE_SHIFT] & PAGE_DEBUG_READ) debug_access(mem->debug, address, 1, value, DEBUG_WATCH_READ);
+    return value;
+}
+
 void memory_write_byte(memory_t* mem, uint32_t address, uint8_t value) {
     address &= ADDR_MASK;
-    if ((address >= 0x02000000 && address < 0x02200000) || 
-        (address >= 0x00000000 && address < 0x00200000)) {
+    if (mem->write_log) log_write(mem, address, value, 1);
+    if (mem->page_debug[address >> PAGE_SHIFT] & PAGE_DEBUG_WRITE) debug_access(mem->debug, address, 1, value, DEBUG_WATCH_WRITE);
+    if (mem->is_boot_mode &&
+        ((address >= 0x02000000 && address < 0x02200000) ||
+         (address >= 0x00000000 && address < 0x00200000))) {
         printf("Attempted byte write to ROM alias at 0x%08X ignored\n", address);
         return;
     }
     else if (address >= RAM_BASE && address < RAM_BASE + RAM_SIZE) {
         mem->ram[address - RAM_BASE] = value;
+        mem->page_dirty[(address - RAM_BASE) >> PAGE_SHIFT] = PAGE_DIRTY_ALL;
     }
     else if (address >= mem->rom_base && address < mem->rom_base + mem->rom_size) {
         printf("Attempted byte write to ROM at 0x%08X ignored\n", address);
@@ -3,9 +3,12 @@
 
 #include <cstdint>
 #include <cstddef> // Added for size_t
+#include <sys/types.h> // off_t
 
 // Forward declaration of struct io (to avoid circular dependency with io.h)
 struct io;
+struct page_store;
+struct debug;
 
 #define RAM_SIZE (static_cast<size_t>(16 * 1024 * 1024)) // 16MB
 #define ROM_SIZE (static_cast<size_t>(2 * 1024 * 1024))  // 2MB
@@ -14,19 +17,89 @@ struct io;
 #define IO_BASE 0x02000000
 #define IO_SIZE 0x02000000
 #define ADDR_MASK 0x03FFFFFF // 26-bit address space
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1u << PAGE_SHIFT)
+#define RAM_PAGES (RAM_SIZE >> PAGE_SHIFT)
+
+// Per-page RAM dirty bits; writes set all of them, each consumer clears its own
+#define PAGE_DIRTY_VIDEO (1 << 0) // Screen lines need reconverting (progressive/even field)
+#define PAGE_DIRTY_VIDEO_ODD (1 << 1) // Same for the odd field of interlaced modes
+#define PAGE_DIRTY_CLONE (1 << 2) // Changed since RAM was last shared with clones
+#define PAGE_DIRTY_AGE (1 << 3)   // Written since the last memory_age_pages tick
+#define PAGE_DIRTY_HASH (1 << 4)  // Changed since the state hash last covered the page
+#define PAGE_DIRTY_ALL 0xFF
+
+// Per-page debug flags over the whole 26-bit address space (see debug.h)
+#define ADDRESS_PAGES ((ADDR_MASK + 1) >> PAGE_SHIFT)
+#define PAGE_DEBUG_EXEC (1 << 0)  // Holds a breakpoint
+#define PAGE_DEBUG_READ (1 << 1)  // Overlaps a read watchpoint
+#define PAGE_DEBUG_WRITE (1 << 2) // Overlaps a write watchpoint
+
+// Page ages count ticks without a write, saturating at 255
+#define MEMORY_AGE_TICK_FRAMES 50 // One tick per second of emulated time
+
+// RAM and ROM live in one mapping so clones can share both copy-on-write
+#define MEMORY_IMAGE_SIZE (RAM_SIZE + ROM_SIZE)
+
+// Guest writes recorded while memory_t.write_log is set (see lockstep.h).
+// old is the RAM content before the write, so a log can be undone.
+typedef struct {
+    uint32_t address;
+    uint32_t value;
+    uint32_t old;
+    uint32_t size;             // 1 or 4 bytes
+} memory_write_t;
+
+typedef struct {
+    memory_write_t* writes;
+    size_t count;
+    size_t capacity;
+} memory_write_log_t;
 
 typedef struct memory {
     uint8_t* ram;
-    uint8_t* rom;
+    uint8_t* rom;              // Follows RAM in the same mapping
     size_t rom_size;
     uint32_t rom_base;
     uint32_t floppy_offset;
     struct io* io;
     int is_boot_mode; // 1 at boot, 0 after initialization
+    int image_fd;     // memfd holding RAM/ROM as last shared with clones (-1 = none)
+    bool mergeable;   // RAM/ROM offered to KSM for cross-instance dedup
+    int export_fd;    // memfd mapped MAP_SHARED as RAM/ROM for external readers (-1 = private)
+    struct page_store* store;      // Compressed pages while suspended (NULL = all resident)
+    memory_write_log_t* write_log; // Records CPU writes while set (NULL = off)
+    struct debug* debug;           // Breakpoints and watchpoints (NULL = none)
+    // Page maps last, so the fields above share cache lines
+    uint8_t page_dirty[RAM_PAGES]; // PAGE_DIRTY_* bits per 4KB RAM page
+    uint8_t page_age[RAM_PAGES];   // Age ticks since each page was last written
+    uint8_t page_debug[ADDRESS_PAGES]; // PAGE_DEBUG_* bits per 4KB of address space
 } memory_t;
 
 memory_t* memory_create(const char* jfd_path, uint32_t rom_base, struct io* io);
 void memory_destroy(memory_t* mem);
+// In-place variants for callers that own the storage (see machine.cpp)
+bool memory_init(memory_t* mem, const char* jfd_path, uint32_t rom_base, struct io* io);
+void memory_release(memory_t* mem);
+bool memory_reset(memory_t* mem); // Power-on RAM contents; ROM is kept
+bool memory_clone(memory_t* mem, memory_t* src, struct io* io); // RAM/ROM shared copy-on-write
+void memory_set_mergeable(memory_t* mem, bool mergeable); // Needs KSM enabled on the host
+// Move RAM/ROM onto a shared memfd other processes can mmap (via /proc/<pid>/fd);
+// returns the fd. Layout is RAM then ROM, as in MEMORY_IMAGE_SIZE.
+int memory_export(memory_t* mem);
+size_t memory_merged_bytes(memory_t* mem); // RAM currently deduplicated by KSM
+// Map RAM_SIZE bytes of fd at offset (host page aligned) MAP_PRIVATE as RAM:
+// pages load on first touch and stay shared with the page cache until
+// written. false = not possible (exported RAM) or failed; RAM is unchanged.
+bool memory_map_ram(memory_t* mem, int fd, off_t offset);
+// Cold pages: memory_suspend compresses pages idle for at least min_age ticks
+// and drops the originals; memory_resume restores them. RAM must be resumed
+// before anything reads it (machine_run_frame does this on entry).
+void memory_age_pages(memory_t* mem);
+bool memory_suspend(memory_t* mem, unsigned min_age);
+bool memory_resume(memory_t* mem);
+void memory_undo_writes(memory_t* mem, const memory_write_log_t* log); // Restores RAM, newest first
+bool memory_page_is_zero(const uint8_t* page); // PAGE_SIZE bytes, word aligned
 uint32_t memory_read_word(memory_t* mem, uint32_t address);
 void memory_write_word(memory_t* mem, uint32_t address, uint32_t value);
 uint8_t memory_read_byte(memory_t* mem, uint32_t address);
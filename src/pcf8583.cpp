@@ -0,0 +1,160 @@
+#include "pcf8583.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static uint8_t to_bcd(int value) {
+    return (uint8_t)(((value / 10) << 4) | (value % 10));
+}
+
+// Refresh the clock registers from host time before they are read
+static void update_clock(pcf8583_t* rtc) {
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    rtc->ram[0x01] = 0;                                     // Hundredths
+    rtc->ram[0x02] = to_bcd(tm_now.tm_sec % 60);
+    rtc->ram[0x03] = to_bcd(tm_now.tm_min);
+    rtc->ram[0x04] = to_bcd(tm_now.tm_hour);                // 24 hour mode
+    rtc->ram[0x05] = (uint8_t)(((tm_now.tm_year & 3) << 6) | to_bcd(tm_now.tm_mday));
+    rtc->ram[0x06] = (uint8_t)((tm_now.tm_wday << 5) | to_bcd(tm_now.tm_mon + 1));
+}
+
+void pcf8583_init(pcf8583_t* rtc) {
+    memset(rtc, 0, sizeof(*rtc));
+    rtc->state = PCF8583_IDLE;
+    rtc->scl = rtc->sda = true;
+    rtc->sda_out = true;
+    rtc->hle = false; // Enabled by the ROM profile (romprofile.h)
+}
+
+bool pcf8583_load(pcf8583_t* rtc, const char* path) {
+    snprintf(rtc->path, sizeof(rtc->path), "%s", path);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("No CMOS file at %s, starting with cleared CMOS\n", path);
+        return false;
+    }
+    size_t read = fread(rtc->ram, 1, PCF8583_SIZE, file);
+    fclose(file);
+    if (read != PCF8583_SIZE) {
+        printf("Warning: short CMOS file %s (%zu of %d bytes)\n", path, read, PCF8583_SIZE);
+    }
+    rtc->dirty = false;
+    printf("Loaded CMOS from %s\n", path);
+    return true;
+}
+
+bool pcf8583_save(pcf8583_t* rtc) {
+    if (!rtc->dirty || !rtc->path[0]) return true;
+    FILE* file = fopen(rtc->path, "wb");
+    if (!file) {
+        printf("Failed to save CMOS to %s\n", rtc->path);
+        return false;
+    }
+    size_t written = fwrite(rtc->ram, 1, PCF8583_SIZE, file);
+    fclose(file);
+    if (written != PCF8583_SIZE) {
+        printf("Failed to save CMOS to %s\n", rtc->path);
+        return false;
+    }
+    rtc->dirty = false;
+    return true;
+}
+
+uint8_t pcf8583_read(pcf8583_t* rtc, uint8_t address) {
+    if (address < 0x10) update_clock(rtc);
+    return rtc->ram[address];
+}
+
+void pcf8583_write(pcf8583_t* rtc, uint8_t address, uint8_t value) {
+    if (rtc->ram[address] != value) {
+        rtc->ram[address] = value;
+        rtc->dirty = true;
+    }
+}
+
+// A received byte is complete: returns true to ACK it
+static bool byte_received(pcf8583_t* rtc) {
+    if (rtc->state == PCF8583_ADDRESS_BYTE) {
+        if ((rtc->shift & 0xFE) != PCF8583_ADDRESS) return false;
+        rtc->reading = rtc->shift & 1;
+        rtc->have_pointer = false;
+        if (rtc->reading && rtc->pointer < 0x10) update_clock(rtc);
+    } else if (!rtc->have_pointer) {
+        rtc->pointer = rtc->shift;
+        rtc->have_pointer = true;
+    } else {
+        pcf8583_write(rtc, rtc->pointer++, rtc->shift);
+    }
+    return true;
+}
+
+bool pcf8583_lines(pcf8583_t* rtc, bool scl, bool sda) {
+    bool scl_rise = scl && !rtc->scl;
+    bool scl_fall = !scl && rtc->scl;
+
+    if (scl && rtc->scl && sda != rtc->sda) {
+        // SDA changing while SCL is high: START (falling) or STOP (rising)
+        rtc->state = sda ? PCF8583_IDLE : PCF8583_ADDRESS_BYTE;
+        rtc->bits = 0;
+        rtc->shift = 0;
+        rtc->sda_out = true;
+    } else if (scl_rise) {
+        if (rtc->state == PCF8583_ADDRESS_BYTE || rtc->state == PCF8583_RX) {
+            rtc->shift = (uint8_t)((rtc->shift << 1) | (sda ? 1 : 0));
+            rtc->bits++;
+        } else if (rtc->state == PCF8583_ACK_IN) {
+            rtc->master_ack = !sda;
+        }
+    } else if (scl_fall) {
+        switch (rtc->state) {
+            case PCF8583_ADDRESS_BYTE:
+            case PCF8583_RX:
+                if (rtc->bits == 8) {
+                    if (byte_received(rtc)) {
+                        rtc->state = PCF8583_ACK_OUT;
+                        rtc->sda_out = false;
+                    } else {
+                        rtc->state = PCF8583_IDLE; // Not addressed to us
+                    }
+                }
+                break;
+            case PCF8583_ACK_OUT:
+                rtc->sda_out = true;
+                rtc->bits = 0;
+                rtc->shift = 0;
+                if (!rtc->reading) {
+                    rtc->state = PCF8583_RX;
+                    break;
+                }
+                // Fall through: start sending the byte at the word address
+            case PCF8583_ACK_IN:
+                if (rtc->state == PCF8583_ACK_IN && !rtc->master_ack) {
+                    rtc->state = PCF8583_IDLE; // Master ends the read with NACK
+                    rtc->sda_out = true;
+                    break;
+                }
+                rtc->shift = rtc->ram[rtc->pointer++];
+                rtc->state = PCF8583_TX;
+                rtc->sda_out = (rtc->shift & 0x80) != 0;
+                rtc->bits = 1;
+                break;
+            case PCF8583_TX:
+                if (rtc->bits < 8) {
+                    rtc->sda_out = ((rtc->shift << rtc->bits) & 0x80) != 0;
+                    rtc->bits++;
+                } else {
+                    rtc->sda_out = true;
+                    rtc->state = PCF8583_ACK_IN;
+                }
+                break;
+            case PCF8583_IDLE:
+                break;
+        }
+    }
+
+    rtc->scl = scl;
+    rtc->sda = sda;
+    return sda && rtc->sda_out;
+}
@@ -0,0 +1,43 @@
+#ifndef PCF8583_H
+#define PCF8583_H
+
+#include <cstdint>
+
+// PCF8583 clock/calendar with 240 bytes of CMOS RAM on the IOC I2C bus
+#define PCF8583_ADDRESS 0xA0   // Slave address (A0 pin low), bit 0 = read
+#define PCF8583_SIZE 256       // Registers 0x00-0x0F, CMOS RAM 0x10-0xFF
+
+// Bus state machine, advanced on SCL edges and START/STOP conditions
+typedef enum {
+    PCF8583_IDLE,              // Waiting for START
+    PCF8583_ADDRESS_BYTE,      // Receiving slave address
+    PCF8583_RX,                // Receiving word address or data
+    PCF8583_ACK_OUT,           // Driving ACK for a received byte
+    PCF8583_TX,                // Shifting out a data byte
+    PCF8583_ACK_IN,            // Sampling the master's ACK
+} pcf8583_state_t;
+
+typedef struct {
+    uint8_t ram[PCF8583_SIZE]; // Registers and CMOS RAM
+    pcf8583_state_t state;
+    uint8_t shift;             // Byte being received or transmitted
+    uint8_t bits;              // Bits shifted in the current byte
+    uint8_t pointer;           // Word address (auto-increments)
+    bool reading;              // Current transfer is a read
+    bool have_pointer;         // Word address received in this write
+    bool master_ack;           // Master acknowledged the last byte sent
+    bool scl, sda;             // Master's last line levels
+    bool sda_out;              // Our SDA output (true = released)
+    bool dirty;                // CMOS RAM changed since load/save
+    bool hle;                  // Complete CMOS SWIs natively (see cpu_step); per ROM profile
+    char path[256];            // Persistence file ("" = none)
+} pcf8583_t;
+
+void pcf8583_init(pcf8583_t* rtc);
+bool pcf8583_load(pcf8583_t* rtc, const char* path); // Remembers path for saving
+bool pcf8583_save(pcf8583_t* rtc);                   // No-op unless dirty
+bool pcf8583_lines(pcf8583_t* rtc, bool scl, bool sda); // Returns SDA bus level
+uint8_t pcf8583_read(pcf8583_t* rtc, uint8_t address);  // Whole-transaction fast path
+void pcf8583_write(pcf8583_t* rtc, uint8_t address, uint8_t value);
+
+#endif
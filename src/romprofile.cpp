@@ -0,0 +1,99 @@
+#include "romprofile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+uint32_t rom_profile_crc(const uint8_t* rom, size_t size) {
+    return (uint32_t)crc32(crc32(0, Z_NULL, 0), rom, (uInt)size);
+}
+
+static void add_hook(rom_profile_t* profile, const rom_hook_t* hook, const char* path, unsigned line) {
+    if (profile->hook_count == ROM_PROFILE_MAX_HOOKS) {
+        printf("%s:%u: more than %d hooks in profile %s, ignored\n", path, line, ROM_PROFILE_MAX_HOOKS, profile->name);
+        return;
+    }
+    profile->hooks[profile->hook_count++] = *hook;
+}
+
+// One directive of the current profile; false = not understood
+static bool parse_directive(rom_profile_t* profile, bool* crc_matches, uint32_t crc, const char* text,
+                            const char* path, unsigned line) {
+    char word[32], extra[16];
+    rom_hook_t hook = {};
+    int fields;
+    if (sscanf(text, "crc32 %x", &hook.value) == 1) {
+        if (hook.value == crc) *crc_matches = true;
+    } else if (sscanf(text, "idle %x", &hook.pc) == 1) {
+        hook.type = ROM_HOOK_IDLE;
+        add_hook(profile, &hook, path, line);
+    } else if ((fields = sscanf(text, "loop_cap %x %u %x %15s", &hook.pc, &hook.count, &hook.target, extra)) >= 3) {
+        hook.type = ROM_HOOK_LOOP_CAP;
+        hook.skip = fields == 4 && strcmp(extra, "skip") == 0;
+        if (hook.count == 0 || (fields == 4 && !hook.skip)) return false;
+        add_hook(profile, &hook, path, line);
+    } else if (sscanf(text, "write %x %x %x", &hook.pc, &hook.target, &hook.value) == 3) {
+        hook.type = ROM_HOOK_WRITE;
+        add_hook(profile, &hook, path, line);
+    } else if (sscanf(text, "hle %31s", word) == 1 && strcmp(word, "cmos_read") == 0) {
+        profile->hle_cmos_read = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Fast-path range for cpu_step
+static void finish(rom_profile_t* profile) {
+    uint32_t low = 0xFFFFFFFF, high = 0;
+    for (unsigned i = 0; i < profile->hook_count; i++) {
+        if (profile->hooks[i].pc < low) low = profile->hooks[i].pc;
+        if (profile->hooks[i].pc > high) high = profile->hooks[i].pc;
+    }
+    profile->low = profile->hook_count ? low : 0xFFFFFFFF;
+    profile->span = profile->hook_count ? high - low : 0;
+}
+
+bool rom_profile_find(const char* db_path, uint32_t crc, const char* name, rom_profile_t* profile) {
+    memset(profile, 0, sizeof(*profile));
+    FILE* file = fopen(db_path, "r");
+    if (!file) return false;
+
+    rom_profile_t* current = (rom_profile_t*)calloc(1, sizeof(rom_profile_t));
+    if (!current) {
+        fclose(file);
+        return false;
+    }
+    bool in_profile = false, named = false, crc_matches = false, found = false;
+    char text[256];
+    unsigned line = 0;
+    while (!found && fgets(text, sizeof(text), file)) {
+        line++;
+        text[strcspn(text, "#\r\n")] = '\0';
+        char start[16];
+        if (sscanf(text, "%15s", start) != 1) continue; // Blank
+        if (strcmp(start, "profile") == 0) {
+            found = in_profile && (name ? named : crc_matches);
+            if (found) break;
+            memset(current, 0, sizeof(*current));
+            if (sscanf(text, "profile %63s", current->name) != 1) {
+                printf("%s:%u: profile needs a name\n", db_path, line);
+            }
+            in_profile = true;
+            named = name && strcmp(current->name, name) == 0;
+            crc_matches = false;
+        } else if (!in_profile) {
+            printf("%s:%u: directive outside a profile\n", db_path, line);
+        } else if (!parse_directive(current, &crc_matches, crc, text, db_path, line)) {
+            printf("%s:%u: not understood: %s\n", db_path, line, text);
+        }
+    }
+    if (!found) found = in_profile && (name ? named : crc_matches); // The last profile
+    fclose(file);
+    if (found) {
+        finish(current);
+        *profile = *current;
+    }
+    free(current);
+    return found;
+}
@@ -0,0 +1,60 @@
+#ifndef ROMPROFILE_H
+#define ROMPROFILE_H
+
+#include <cstdint>
+#include <stddef.h>
+
+// Per-ROM acceleration profiles. Idle loops, boot shortcuts and routines
+// worth completing natively sit at different addresses in every RISC OS
+// release, so they are data rather than code: a text database maps ROM
+// images (by CRC32) to profiles, and a ROM with no profile runs with none of
+// them. Database format, one directive per line, '#' starts a comment;
+// addresses and values are hex, count decimal:
+//
+//   profile <name>                 Start a profile
+//   crc32 <hex>                    A ROM image it applies to (repeatable)
+//   idle <pc>                      Idle or polling loop: reaching pc with no
+//                                  interrupt pending ends the frame's CPU
+//                                  slice, as nothing can change until the
+//                                  next frame's timers and interrupts
+//   loop_cap <pc> <count> <resume> [skip]
+//                                  Boot shortcut: every count-th fetch of pc
+//                                  continues at resume; skip also drops the
+//                                  instruction at pc
+//   write <pc> <address> <value>   Boot shortcut: a bus word write each time
+//                                  pc is fetched
+//   hle cmos_read                  Complete OS_Byte 161 natively instead of
+//                                  running the kernel's I2C routine
+#define ROM_PROFILE_DB "romprofiles.txt"
+#define ROM_PROFILE_MAX_HOOKS 16        // Also the CPU's loop counters (CPU_LOOP_COUNT)
+#define ROM_PROFILE_NAME_MAX 64
+
+#define ROM_HOOK_IDLE 0
+#define ROM_HOOK_LOOP_CAP 1
+#define ROM_HOOK_WRITE 2
+
+typedef struct {
+    uint32_t type;                  // ROM_HOOK_*
+    uint32_t pc;
+    uint32_t count;                 // LOOP_CAP: fetches before resuming
+    uint32_t target;                // LOOP_CAP: resume PC; WRITE: address
+    uint32_t value;                 // WRITE: word written
+    bool skip;                      // LOOP_CAP: drop the instruction at pc
+} rom_hook_t;
+
+typedef struct rom_profile {
+    char name[ROM_PROFILE_NAME_MAX]; // "" = no profile
+    rom_hook_t hooks[ROM_PROFILE_MAX_HOOKS];
+    unsigned hook_count;
+    uint32_t low;                   // Lowest hook PC; cpu_step only searches
+    uint32_t span;                  // fetches in [low, low + span]
+    bool hle_cmos_read;
+} rom_profile_t;
+
+uint32_t rom_profile_crc(const uint8_t* rom, size_t size);
+// Look up the profile listing crc, or with name not NULL the profile called
+// name whatever its crc32 lines (for a ROM not in the database yet).
+// false = none (profile is then empty): unknown ROM, or no database.
+bool rom_profile_find(const char* db_path, uint32_t crc, const char* name, rom_profile_t* profile);
+
+#endif
@@ -0,0 +1,378 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "hostfs.h"
+
+// Everything but RAM. Device structs are stored whole, so snapshots are tied
+// to the build's struct layout; state_bytes catches mismatches.
+typedef struct {
+    uint32_t registers[16];
+    uint32_t cpsr;
+    uint32_t spsr;
+    uint32_t spsr_irq;
+    uint32_t spsr_fiq;
+    uint32_t halted;
+    uint32_t hle_os;
+    uint32_t exit_code;
+    uint32_t stop_reason;
+    uint32_t fault_pc;
+    uint32_t fault_repeats;
+    uint32_t loop_counts[CPU_LOOP_COUNT];
+    uint32_t is_boot_mode;
+    uint32_t rom_base;              // Must match the machine restored into
+    uint32_t irq_pending;
+    uint32_t fiq_pending;
+    uint64_t cycles;
+    uint64_t frame_count;
+    uint64_t accesses;
+    ioc_t ioc;
+    memc_t memc;
+    vidc_t vidc;
+    pcf8583_t cmos;                 // path and hle are kept from the machine restored into
+} snapshot_state_t;
+
+static_assert(sizeof(snapshot_header_t) + sizeof(snapshot_state_t) <= SNAPSHOT_MAP_ALIGN, "State overlaps mapped RAM");
+
+// Chunks in flight while saving: each slot holds one compressed chunk until
+// every earlier chunk has been written
+typedef struct {
+    const uint8_t* ram;
+    uint8_t* scratch;               // slots buffers of bound bytes
+    uLong bound;
+    unsigned base;                  // First chunk of the current batch
+    uint32_t sizes[SNAPSHOT_CHUNKS]; // Compressed size (0 = not done yet)
+    unsigned next;                  // Next chunk to write
+    bool failed;
+    snapshot_write_t write;
+    void* ctx;
+    pthread_mutex_t lock;           // Serialises writes and next
+} save_job_t;
+
+typedef struct {
+    uint8_t* ram;
+    const uint8_t* chunks[SNAPSHOT_CHUNKS];
+    uint32_t sizes[SNAPSHOT_CHUNKS];
+    bool failed[SNAPSHOT_CHUNKS];
+} load_job_t;
+
+size_t snapshot_max_size(void) {
+    return sizeof(snapshot_header_t) + sizeof(snapshot_state_t) +
+           SNAPSHOT_CHUNKS * (sizeof(snapshot_chunk_t) + compressBound(SNAPSHOT_CHUNK_BYTES));
+}
+
+static void capture_state(machine_t* m, snapshot_state_t* state) {
+    const arm3_cpu_t* cpu = m->cpu;
+    const io_t* io = m->io;
+    memset(state, 0, sizeof(*state)); // Padding too, so equal machines give equal snapshots
+    memcpy(state->registers, cpu->registers, sizeof(state->registers));
+    state->cpsr = cpu->cpsr;
+    state->spsr = cpu->spsr;
+    state->spsr_irq = cpu->spsr_irq;
+    state->spsr_fiq = cpu->spsr_fiq;
+    state->halted = cpu->halted;
+    state->hle_os = cpu->hle_os;
+    state->exit_code = cpu->exit_code;
+    state->stop_reason = cpu->stop_reason;
+    state->fault_pc = cpu->fault_pc;
+    state->fault_repeats = cpu->fault_repeats;
+    memcpy(state->loop_counts, cpu->loop_counts, sizeof(state->loop_counts));
+    state->is_boot_mode = m->mem->is_boot_mode;
+    state->rom_base = m->mem->rom_base;
+    state->irq_pending = io->irq_pending;
+    state->fiq_pending = io->fiq_pending;
+    state->cycles = io->cycles;
+    state->frame_count = io->frame_count;
+    state->accesses = io->accesses;
+    state->ioc = io->ioc;
+    state->memc = io->memc;
+    state->vidc = io->vidc;
+    state->cmos = io->cmos;
+}
+
+static void apply_state(machine_t* m, const snapshot_state_t* state) {
+    arm3_cpu_t* cpu = m->cpu;
+    io_t* io = m->io;
+    memcpy(cpu->registers, state->registers, sizeof(cpu->registers));
+    cpu->cpsr = state->cpsr;
+    cpu->spsr = state->spsr;
+    cpu->spsr_irq = state->spsr_irq;
+    cpu->spsr_fiq = state->spsr_fiq;
+    cpu->halted = state->halted != 0;
+    cpu->hle_os = state->hle_os != 0;
+    cpu->exit_code = state->exit_code;
+    cpu->stop_reason = state->stop_reason;
+    cpu->fault_pc = state->fault_pc;
+    cpu->fault_repeats = state->fault_repeats;
+    memcpy(cpu->loop_counts, state->loop_counts, sizeof(cpu->loop_counts));
+    hostfs_close_all(cpu->hostfs);
+
+    m->mem->is_boot_mode = (int)state->is_boot_mode;
+    io->irq_pending = state->irq_pending != 0;
+    io->fiq_pending = state->fiq_pending != 0;
+    io->cycles = state->cycles;
+    io->frame_count = state->frame_count;
+    io->accesses = state->accesses;
+    io->ioc = state->ioc;
+    io->memc = state->memc;
+    io->vidc = state->vidc;
+    io->vidc.dirty = VIDC_DIRTY_PALETTE | VIDC_DIRTY_GEOMETRY | VIDC_DIRTY_TIMING;
+    io->render_full = 3;
+
+    bool cmos_changed = memcmp(io->cmos.ram, state->cmos.ram, sizeof(io->cmos.ram)) != 0;
+    char path[sizeof(io->cmos.path)];
+    memcpy(path, io->cmos.path, sizeof(path));
+    bool hle = io->cmos.hle; // Set by the ROM profile, not saved state
+    io->cmos = state->cmos;
+    memcpy(io->cmos.path, path, sizeof(path));
+    io->cmos.hle = hle;
+    io->cmos.dirty = io->cmos.dirty || cmos_changed; // Saved like any other CMOS change
+}
+
+// Called with job->lock held: write every finished chunk that is next in order
+static void write_ready(save_job_t* job) {
+    while (job->next < SNAPSHOT_CHUNKS && job->sizes[job->next]) {
+        unsigned chunk = job->next++;
+        if (job->failed) continue;
+        snapshot_chunk_t header = { job->sizes[chunk], 0 };
+        const uint8_t* data = job->scratch + (size_t)(chunk - job->base) * job->bound;
+        if (!job->write(job->ctx, &header, sizeof(header)) || !job->write(job->ctx, data, header.compressed)) {
+            job->failed = true;
+        }
+    }
+}
+
+static void compress_task(void* ctx, unsigned index) {
+    save_job_t* job = (save_job_t*)ctx;
+    unsigned chunk = job->base + index;
+    uLongf size = job->bound;
+    // Level 1: the frontend waits for this, and guest RAM is mostly zeros anyway
+    int result = compress2(job->scratch + (size_t)index * job->bound, &size,
+                           job->ram + (size_t)chunk * SNAPSHOT_CHUNK_BYTES, SNAPSHOT_CHUNK_BYTES, 1);
+    pthread_mutex_lock(&job->lock);
+    if (result != Z_OK) {
+        job->failed = true;
+        size = 1; // Still "done", so later chunks are not held up
+    }
+    job->sizes[chunk] = (uint32_t)size;
+    write_ready(job);
+    pthread_mutex_unlock(&job->lock);
+}
+
+bool snapshot_save(machine_t* m, threadpool_t* pool, snapshot_write_t write, void* ctx) {
+    if (!memory_resume(m->mem)) return false; // Compressed idle pages back into RAM
+
+    snapshot_header_t header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(snapshot_state_t),
+                                 SNAPSHOT_CHUNK_BYTES, SNAPSHOT_CHUNKS, SNAPSHOT_LAYOUT_CHUNKED };
+    snapshot_state_t state;
+    capture_state(m, &state);
+    if (!write(ctx, &header, sizeof(header)) || !write(ctx, &state, sizeof(state))) return false;
+
+    // Two slots per thread, so threads finishing early do not wait on a slow chunk
+    unsigned slots = threadpool_size(pool) * 2;
+    if (slots > SNAPSHOT_CHUNKS) slots = SNAPSHOT_CHUNKS;
+    save_job_t* job = (save_job_t*)calloc(1, sizeof(save_job_t));
+    if (!job) return false;
+    job->bound = compressBound(SNAPSHOT_CHUNK_BYTES);
+    job->scratch = (uint8_t*)malloc((size_t)slots * job->bound);
+    if (!job->scratch) {
+        printf("Failed to allocate snapshot buffers\n");
+        free(job);
+        return false;
+    }
+    job->ram = m->mem->ram;
+    job->write = write;
+    job->ctx = ctx;
+    pthread_mutex_init(&job->lock, NULL);
+    for (job->base = 0; job->base < SNAPSHOT_CHUNKS && !job->failed; job->base += slots) {
+        unsigned count = SNAPSHOT_CHUNKS - job->base < slots ? SNAPSHOT_CHUNKS - job->base : slots;
+        threadpool_run(pool, count, compress_task, job); // Returns with the batch written
+    }
+    bool ok = !job->failed;
+    pthread_mutex_destroy(&job->lock);
+    free(job->scratch);
+    free(job);
+    return ok;
+}
+
+static void inflate_task(void* ctx, unsigned chunk) {
+    load_job_t* job = (load_job_t*)ctx;
+    uLongf size = SNAPSHOT_CHUNK_BYTES;
+    int result = uncompress(job->ram + (size_t)chunk * SNAPSHOT_CHUNK_BYTES, &size, job->chunks[chunk], job->sizes[chunk]);
+    job->failed[chunk] = result != Z_OK || size != SNAPSHOT_CHUNK_BYTES;
+}
+
+// Header and state from the start of a snapshot of size bytes (data need only
+// hold those two); checks they fit this build and machine and that the RAM
+// section is all there
+static bool read_header(machine_t* m, const uint8_t* data, size_t size, snapshot_header_t* header, snapshot_state_t* state) {
+    if (size < sizeof(*header) + sizeof(*state)) {
+        printf("Snapshot truncated\n");
+        return false;
+    }
+    memcpy(header, data, sizeof(*header));
+    memcpy(state, data + sizeof(*header), sizeof(*state));
+    bool chunked = header->layout == SNAPSHOT_LAYOUT_CHUNKED &&
+                   header->chunk_bytes == SNAPSHOT_CHUNK_BYTES && header->chunks == SNAPSHOT_CHUNKS;
+    bool mapped = header->layout == SNAPSHOT_LAYOUT_MAPPED && header->chunk_bytes == RAM_SIZE && header->chunks == 1;
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+        header->state_bytes != sizeof(snapshot_state_t) || (!chunked && !mapped)) {
+        printf("Not a snapshot from this build\n");
+        return false;
+    }
+    if (mapped && size < SNAPSHOT_MAP_ALIGN + RAM_SIZE) {
+        printf("Snapshot truncated\n");
+        return false;
+    }
+    if (state->rom_base != m->mem->rom_base) {
+        printf("Snapshot was taken with the ROM at 0x%08X, not 0x%08X\n", state->rom_base, m->mem->rom_base);
+        return false;
+    }
+    return true;
+}
+
+bool snapshot_load(machine_t* m, threadpool_t* pool, const uint8_t* data, size_t size) {
+    snapshot_header_t header;
+    snapshot_state_t state;
+    if (!read_header(m, data, size, &header, &state)) return false;
+    if (header.layout == SNAPSHOT_LAYOUT_MAPPED) {
+        if (!memory_resume(m->mem)) return false;
+        memcpy(m->mem->ram, data + SNAPSHOT_MAP_ALIGN, RAM_SIZE);
+        memset(m->mem->page_dirty, PAGE_DIRTY_ALL, sizeof(m->mem->page_dirty));
+        apply_state(m, &state);
+        return true;
+    }
+
+    // Walk the chunk headers first, so a truncated snapshot changes nothing
+    load_job_t* job = (load_job_t*)calloc(1, sizeof(load_job_t));
+    if (!job) return false;
+    size_t offset = sizeof(header) + sizeof(state);
+    for (unsigned chunk = 0; chunk < SNAPSHOT_CHUNKS; chunk++) {
+        snapshot_chunk_t chunk_header;
+        if (size - offset < sizeof(chunk_header)) break;
+        memcpy(&chunk_header, data + offset, sizeof(chunk_header));
+        offset += sizeof(chunk_header);
+        if (size - offset < chunk_header.compressed) break;
+        job->chunks[chunk] = data + offset;
+        job->sizes[chunk] = chunk_header.compressed;
+        offset += chunk_header.compressed;
+    }
+    if (!job->chunks[SNAPSHOT_CHUNKS - 1]) {
+        printf("Snapshot truncated\n");
+        free(job);
+        return false;
+    }
+
+    bool ok = memory_resume(m->mem); // Suspended pages would overwrite the restored RAM later
+    if (ok) {
+        job->ram = m->mem->ram;
+        threadpool_run(pool, SNAPSHOT_CHUNKS, inflate_task, job);
+        for (unsigned chunk = 0; chunk < SNAPSHOT_CHUNKS; chunk++) {
+            if (job->failed[chunk]) ok = false;
+        }
+        // Written behind the page-tracking write paths: every consumer must look again
+        memset(m->mem->page_dirty, PAGE_DIRTY_ALL, sizeof(m->mem->page_dirty));
+    }
+    free(job);
+    if (!ok) {
+        printf("Snapshot RAM is corrupt\n");
+        return false;
+    }
+    apply_state(m, &state);
+    return true;
+}
+
+static bool write_file(void* ctx, const void* data, size_t size) {
+    return fwrite(data, 1, size, (FILE*)ctx) == size;
+}
+
+// Snapshots are written beside path and renamed over it when complete: a
+// machine may still map the file being replaced (see memory_map_ram)
+static bool replace_file(const char* temp, const char* path, bool ok) {
+    if (ok && rename(temp, path) != 0) ok = false;
+    if (!ok) {
+        printf("Failed to write snapshot %s\n", path);
+        unlink(temp);
+    }
+    return ok;
+}
+
+bool snapshot_save_file(machine_t* m, threadpool_t* pool, const char* path) {
+    char temp[MACHINE_PATH_MAX + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* file = fopen(temp, "wb");
+    if (!file) {
+        printf("Failed to create snapshot %s\n", path);
+        return false;
+    }
+    bool ok = snapshot_save(m, pool, write_file, file);
+    if (fclose(file) != 0) ok = false;
+    return replace_file(temp, path, ok);
+}
+
+bool snapshot_save_mapped(machine_t* m, const char* path) {
+    if (!memory_resume(m->mem)) return false;
+    char temp[MACHINE_PATH_MAX + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        printf("Failed to create snapshot %s\n", path);
+        return false;
+    }
+    snapshot_header_t header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(snapshot_state_t),
+                                 (uint32_t)RAM_SIZE, 1, SNAPSHOT_LAYOUT_MAPPED };
+    snapshot_state_t state;
+    capture_state(m, &state);
+    bool ok = pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+              pwrite(fd, &state, sizeof(state), sizeof(header)) == (ssize_t)sizeof(state);
+    // Zero pages stay holes: no disk space, and they map as zero
+    for (size_t offset = 0; offset < RAM_SIZE && ok; offset += PAGE_SIZE) {
+        if (memory_page_is_zero(m->mem->ram + offset)) continue;
+        ok = pwrite(fd, m->mem->ram + offset, PAGE_SIZE, SNAPSHOT_MAP_ALIGN + offset) == (ssize_t)PAGE_SIZE;
+    }
+    if (ok) ok = ftruncate(fd, SNAPSHOT_MAP_ALIGN + RAM_SIZE) == 0;
+    if (close(fd) != 0) ok = false;
+    return replace_file(temp, path, ok);
+}
+
+bool snapshot_load_file(machine_t* m, threadpool_t* pool, const char* path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        printf("Failed to open snapshot %s\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    snapshot_header_t header;
+    snapshot_state_t state;
+    uint8_t start[sizeof(header) + sizeof(state)];
+    ssize_t got = pread(fd, start, sizeof(start), 0);
+    size_t size = got == (ssize_t)sizeof(start) ? (size_t)st.st_size : 0; // Short read = truncated
+    if (!read_header(m, start, size, &header, &state)) {
+        close(fd);
+        return false;
+    }
+    if (header.layout == SNAPSHOT_LAYOUT_MAPPED && memory_map_ram(m->mem, fd, SNAPSHOT_MAP_ALIGN)) {
+        close(fd); // The mapping keeps the file
+        apply_state(m, &state);
+        return true;
+    }
+
+    // Inflated (or, for exported RAM, copied) straight from the page cache;
+    // no copy of the file in memory
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Failed to map snapshot %s\n", path);
+        return false;
+    }
+    bool ok = snapshot_load(m, pool, (const uint8_t*)data, (size_t)st.st_size);
+    munmap(data, (size_t)st.st_size);
+    return ok;
+}
@@ -0,0 +1,61 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <stddef.h>
+#include "machine.h"
+#include "threadpool.h"
+
+// Machine snapshots (libretro savestates and files): a header, the CPU and
+// device state, then guest RAM as independently zlib-compressed chunks.
+// Chunks are compressed in parallel on a thread pool and handed to the
+// writer in order as they complete, so saving never holds more than a few
+// compressed chunks in memory; loading inflates all chunks in parallel.
+// ROM is not stored: a snapshot is restored into a machine created with the
+// same ROM or image. Open HostFS handles do not survive a restore.
+//
+// The mapped layout (files only) stores RAM uncompressed at SNAPSHOT_MAP_ALIGN
+// instead, with all-zero pages left as holes. Restoring maps that section
+// MAP_PRIVATE as guest RAM (memory_map_ram), so loading costs a few syscalls,
+// pages are read on first touch, and untouched pages stay shared with the
+// page cache across every machine and fork-server job restored from the file.
+// Files are replaced by rename, never rewritten, so machines still mapping an
+// older snapshot keep their RAM.
+#define SNAPSHOT_MAGIC 0x53535241   // "ARSS"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_CHUNK_BYTES (256 * 1024)
+#define SNAPSHOT_CHUNKS (RAM_SIZE / SNAPSHOT_CHUNK_BYTES)
+#define SNAPSHOT_MAP_ALIGN 65536     // RAM offset in mapped files: any host page size up to 64KB
+
+#define SNAPSHOT_LAYOUT_CHUNKED 0    // Compressed chunks follow the state
+#define SNAPSHOT_LAYOUT_MAPPED 1     // Raw RAM at SNAPSHOT_MAP_ALIGN (one chunk of RAM_SIZE)
+
+typedef struct {
+    uint32_t magic;                 // SNAPSHOT_MAGIC
+    uint32_t version;               // SNAPSHOT_VERSION
+    uint32_t state_bytes;           // sizeof(snapshot_state_t), follows the header
+    uint32_t chunk_bytes;           // Bytes of RAM per chunk
+    uint32_t chunks;                // Chunks making up RAM
+    uint32_t layout;                // SNAPSHOT_LAYOUT_*
+} snapshot_header_t;
+
+typedef struct {
+    uint32_t compressed;            // Bytes of zlib data following
+    uint32_t reserved;
+} snapshot_chunk_t;
+
+// Receives the snapshot in order; false = write failed
+typedef bool (*snapshot_write_t)(void* ctx, const void* data, size_t size);
+
+size_t snapshot_max_size(void); // Upper bound for any snapshot, for retro_serialize_size
+// pool may be NULL (compress on the calling thread)
+bool snapshot_save(machine_t* m, threadpool_t* pool, snapshot_write_t write, void* ctx);
+// On a corrupt snapshot nothing is changed; if a chunk fails to inflate RAM
+// is left partly restored and the machine should be reset
+bool snapshot_load(machine_t* m, threadpool_t* pool, const uint8_t* data, size_t size);
+bool snapshot_save_file(machine_t* m, threadpool_t* pool, const char* path);
+bool snapshot_save_mapped(machine_t* m, const char* path);
+// Either layout; mapped files fall back to a copy when RAM is exported
+bool snapshot_load_file(machine_t* m, threadpool_t* pool, const char* path);
+
+#endif
@@ -0,0 +1,71 @@
+#include "statehash.h"
+#include <stddef.h>
+#include <string.h>
+
+#define HASH_SEED 0x9E3779B97F4A7C15ull
+#define HASH_MULTIPLIER 0xFF51AFD7ED558CCDull
+#define DIRTY_HASH_WORD 0x1010101010101010ull // PAGE_DIRTY_HASH in each of 8 page_dirty bytes
+
+static inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= HASH_MULTIPLIER;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        h = (h ^ word) * HASH_MULTIPLIER;
+        h ^= h >> 29;
+    }
+    for (; size > 0; size--) {
+        h = (h ^ *bytes++) * HASH_MULTIPLIER;
+    }
+    return mix(h);
+}
+
+// A page's contribution depends on its position, so swapped pages differ
+static inline uint64_t page_term(uint32_t page, uint64_t page_hash) {
+    return mix(page_hash + (page + 1) * HASH_SEED);
+}
+
+static void rehash_page(statehash_t* hash, memory_t* mem, uint32_t page) {
+    hash->ram ^= page_term(page, hash->pages[page]);
+    hash->pages[page] = hash_bytes(HASH_SEED, mem->ram + ((size_t)page << PAGE_SHIFT), PAGE_SIZE);
+    hash->ram ^= page_term(page, hash->pages[page]);
+    mem->page_dirty[page] &= ~PAGE_DIRTY_HASH;
+}
+
+void statehash_init(statehash_t* hash, memory_t* mem) {
+    hash->ram = 0;
+    for (uint32_t page = 0; page < RAM_PAGES; page++) {
+        hash->pages[page] = 0;
+        hash->ram ^= page_term(page, 0);
+        rehash_page(hash, mem, page);
+    }
+}
+
+uint64_t statehash_update(statehash_t* hash, const arm3_cpu_t* cpu, memory_t* mem, const io_t* io) {
+    // Eight page_dirty bytes at a time: most are clean between updates
+    for (uint32_t page = 0; page < RAM_PAGES; page += 8) {
+        uint64_t flags;
+        memcpy(&flags, &mem->page_dirty[page], 8);
+        if (!(flags & DIRTY_HASH_WORD)) continue;
+        for (uint32_t i = page; i < page + 8; i++) {
+            if (mem->page_dirty[i] & PAGE_DIRTY_HASH) rehash_page(hash, mem, i);
+        }
+    }
+
+    uint64_t h = hash_bytes(hash->ram, cpu->registers, sizeof(cpu->registers));
+    uint32_t psrs[6] = { cpu->cpsr, cpu->spsr, cpu->spsr_irq, cpu->spsr_fiq, cpu->halted, cpu->halted ? cpu->stop_reason : 0 };
+    h = hash_bytes(h, psrs, sizeof(psrs));
+    uint64_t lines[2] = { (uint64_t)io->irq_pending << 1 | io->fiq_pending, io->cycles };
+    h = hash_bytes(h, lines, sizeof(lines));
+    h = hash_bytes(h, &io->ioc, sizeof(io->ioc));
+    h = hash_bytes(h, &io->memc, sizeof(io->memc));
+    h = hash_bytes(h, &io->vidc, offsetof(vidc_t, dirty)); // Registers, not the derived caches
+    return hash_bytes(h, io->cmos.ram + 0x10, PCF8583_SIZE - 0x10); // CMOS RAM, not the clock
+}
@@ -0,0 +1,24 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <cstdint>
+#include "cpu.h"
+#include "memory.h"
+#include "io.h"
+
+// Running hash of machine state, for comparing two runs without diffing logs.
+// Guest RAM is hashed per 4KB page; an update rehashes only the pages
+// written since the last one (PAGE_DIRTY_HASH) and folds them into the RAM
+// hash in O(1) each. CPU registers and device registers (IOC, MEMC, VIDC,
+// CMOS RAM, interrupt lines, cycle count) are small and hashed whole.
+// Host-dependent state is left out: RTC clock registers, render caches,
+// frame buffers and file paths.
+typedef struct {
+    uint64_t pages[RAM_PAGES];
+    uint64_t ram;                  // Combination of pages[]
+} statehash_t;
+
+void statehash_init(statehash_t* hash, memory_t* mem); // Hashes all of RAM
+uint64_t statehash_update(statehash_t* hash, const arm3_cpu_t* cpu, memory_t* mem, const io_t* io);
+
+#endif
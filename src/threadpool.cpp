@@ -0,0 +1,102 @@
+#include "threadpool.h"
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+struct threadpool {
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;  // Signalled when a batch is posted or on shutdown
+    std::condition_variable done;  // Signalled when the last task of a batch finishes
+    threadpool_task_t task;
+    void* ctx;
+    unsigned next;                 // Next task index to hand out
+    unsigned count;                // Tasks in the current batch
+    unsigned pending;              // Tasks not yet finished
+    uint64_t batch;                // Batch generation, bumped by threadpool_run
+    bool stop;
+};
+
+// Claim and run tasks from the current batch until none are left
+static void run_tasks(threadpool_t* pool, std::unique_lock<std::mutex>& guard) {
+    while (pool->next < pool->count) {
+        unsigned index = pool->next++;
+        guard.unlock();
+        pool->task(pool->ctx, index);
+        guard.lock();
+        if (--pool->pending == 0) pool->done.notify_all();
+    }
+}
+
+static void worker_main(threadpool_t* pool) {
+    std::unique_lock<std::mutex> guard(pool->lock);
+    uint64_t seen = pool->batch;
+    for (;;) {
+        pool->wake.wait(guard, [&] { return pool->stop || pool->batch != seen; });
+        if (pool->stop) return;
+        seen = pool->batch;
+        run_tasks(pool, guard);
+    }
+}
+
+threadpool_t* threadpool_create(unsigned threads) {
+    threadpool_t* pool = new (std::nothrow) threadpool_t();
+    if (!pool) {
+        printf("Failed to allocate thread pool\n");
+        return NULL;
+    }
+    pool->task = NULL;
+    pool->ctx = NULL;
+    pool->next = pool->count = pool->pending = 0;
+    pool->batch = 0;
+    pool->stop = false;
+
+    // The calling thread takes part in every batch, so spawn one fewer worker
+    for (unsigned i = 1; i < threads; i++) {
+        try {
+            pool->workers.emplace_back(worker_main, pool);
+        } catch (...) {
+            printf("Failed to start render worker %u, continuing with %u\n", i, i);
+            break;
+        }
+    }
+    return pool;
+}
+
+void threadpool_destroy(threadpool_t* pool) {
+    if (!pool) return;
+    {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        pool->stop = true;
+    }
+    pool->wake.notify_all();
+    for (std::thread& worker : pool->workers) worker.join();
+    delete pool;
+}
+
+unsigned threadpool_size(threadpool_t* pool) {
+    return pool ? (unsigned)pool->workers.size() + 1 : 1;
+}
+
+void threadpool_run(threadpool_t* pool, unsigned count, threadpool_task_t task, void* ctx) {
+    if (!count) return;
+    if (!pool || pool->workers.empty() || count == 1) {
+        for (unsigned i = 0; i < count; i++) task(ctx, i);
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(pool->lock);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->next = 0;
+    pool->count = count;
+    pool->pending = count;
+    pool->batch++;
+    pool->wake.notify_all();
+
+    run_tasks(pool, guard);
+    pool->done.wait(guard, [&] { return pool->pending == 0; });
+}
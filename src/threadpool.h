@@ -0,0 +1,17 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstdint>
+
+// Small persistent worker pool for splitting per-frame work into tasks
+typedef struct threadpool threadpool_t;
+
+// Task callback: index runs from 0 to count - 1 for each threadpool_run call
+typedef void (*threadpool_task_t)(void* ctx, unsigned index);
+
+threadpool_t* threadpool_create(unsigned threads);
+void threadpool_destroy(threadpool_t* pool);
+unsigned threadpool_size(threadpool_t* pool); // Workers plus the calling thread
+void threadpool_run(threadpool_t* pool, unsigned count, threadpool_task_t task, void* ctx);
+
+#endif
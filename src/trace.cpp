@@ -0,0 +1,63 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TRACE_CHUNK_BYTES (TRACE_CHUNK_RECORDS * sizeof(trace_record_t))
+
+trace_t* trace_open(const char* path) {
+    trace_t* trace = (trace_t*)calloc(1, sizeof(trace_t));
+    if (!trace) return NULL;
+    trace->compressed_capacity = compressBound(TRACE_CHUNK_BYTES);
+    trace->records = (trace_record_t*)malloc(TRACE_CHUNK_BYTES);
+    trace->compressed = (uint8_t*)malloc(trace->compressed_capacity);
+    trace->file = fopen(path, "wb");
+    if (!trace->records || !trace->compressed || !trace->file) {
+        printf("Failed to open trace file %s\n", path);
+        if (trace->file) fclose(trace->file);
+        free(trace->records);
+        free(trace->compressed);
+        free(trace);
+        return NULL;
+    }
+    printf("Tracing instructions to %s\n", path);
+    return trace;
+}
+
+void trace_flush(trace_t* trace) {
+    if (trace->count == 0) return;
+    uint32_t records = trace->count;
+    trace->count = 0;
+    if (trace->failed) return;
+
+    uLongf size = (uLongf)trace->compressed_capacity;
+    // Level 1: the emulation thread pays for this, and records compress well anyway
+    if (compress2(trace->compressed, &size, (const Bytef*)trace->records, records * sizeof(trace_record_t), 1) != Z_OK) {
+        trace->failed = true;
+        printf("Trace compression failed, tracing stopped\n");
+        return;
+    }
+    trace_chunk_header_t header = { TRACE_MAGIC, records, (uint32_t)size, 0, trace->total };
+    if (fwrite(&header, sizeof(header), 1, trace->file) != 1 || fwrite(trace->compressed, 1, size, trace->file) != size) {
+        trace->failed = true;
+        printf("Trace write failed, tracing stopped\n");
+        return;
+    }
+    trace->total += records;
+}
+
+void trace_close(trace_t* trace) {
+    if (!trace) return;
+    trace_flush(trace);
+    if (fclose(trace->file) != 0) printf("Trace write failed\n");
+    free(trace->records);
+    free(trace->compressed);
+    free(trace);
+}
+
+bool trace_decode_chunk(const trace_chunk_header_t* header, const uint8_t* data, trace_record_t* records) {
+    if (header->magic != TRACE_MAGIC || header->records > TRACE_CHUNK_RECORDS) return false;
+    uLongf size = TRACE_CHUNK_BYTES;
+    if (uncompress((Bytef*)records, &size, data, header->compressed) != Z_OK) return false;
+    return size == header->records * sizeof(trace_record_t);
+}
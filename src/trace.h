@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <stddef.h>
+#include <stdio.h>
+
+// Binary instruction trace: one record per instruction cpu_step executes,
+// written as a sequence of independently zlib-compressed chunks. Each chunk
+// header gives its record count and compressed size, so readers can hop from
+// header to header, decode chunks in parallel and seek to a chunk without
+// decoding the rest (see tracetool.cpp).
+#define TRACE_MAGIC 0x54435241      // "ARCT"
+#define TRACE_CHUNK_RECORDS 65536
+
+typedef struct {
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t cpsr;                  // Before the instruction ran
+} trace_record_t;
+
+typedef struct {
+    uint32_t magic;                 // TRACE_MAGIC
+    uint32_t records;               // At most TRACE_CHUNK_RECORDS
+    uint32_t compressed;            // Bytes of zlib data following the header
+    uint32_t reserved;
+    uint64_t first;                 // Trace-wide index of the chunk's first record
+} trace_chunk_header_t;
+
+typedef struct trace {
+    trace_record_t* records;        // Chunk being filled
+    uint32_t count;
+    uint64_t total;                 // Records in earlier chunks
+    FILE* file;
+    uint8_t* compressed;            // Scratch for compressing a chunk
+    size_t compressed_capacity;
+    bool failed;                    // A write failed; recording stopped
+} trace_t;
+
+trace_t* trace_open(const char* path);
+void trace_close(trace_t* trace); // Writes the last, partial chunk
+void trace_flush(trace_t* trace); // Writes the current chunk
+
+static inline void trace_record(trace_t* trace, uint32_t pc, uint32_t instr, uint32_t cpsr) {
+    trace_record_t* record = &trace->records[trace->count];
+    record->pc = pc;
+    record->instr = instr;
+    record->cpsr = cpsr;
+    if (++trace->count == TRACE_CHUNK_RECORDS) trace_flush(trace);
+}
+
+// Reading: data points at header->compressed bytes; records has room for
+// TRACE_CHUNK_RECORDS. false = corrupt chunk.
+bool trace_decode_chunk(const trace_chunk_header_t* header, const uint8_t* data, trace_record_t* records);
+
+#endif
@@ -0,0 +1,377 @@
+// Offline reader for binary traces from acornarc_headless -t (trace.h).
+//
+//   acornarc_trace [-j threads] file           Disassemble every record, in order
+//   acornarc_trace [-j threads] -i file        Build file.idx, the PC index
+//   acornarc_trace [-j threads] -p addr file   Every execution of addr; builds
+//                                              the index first if it is missing
+//
+// The trace is mapped, its chunk headers walked, and chunks decoded and
+// disassembled in parallel on a thread pool (default: one thread per CPU),
+// then printed in trace order. The index lists, for each PC, the chunks that
+// executed it, so a query decodes only those chunks however long the trace.
+// Lines are "record  pc: instr  flags mode  ; disassembly".
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "disasm.h"
+#include "threadpool.h"
+
+#define INDEX_MAGIC 0x49435241      // "ARCI"
+#define INDEX_VERSION 1
+#define LINE_MAX_BYTES 128          // One formatted record, with room to spare
+#define BATCH_PER_THREAD 2          // Chunks in flight per thread
+
+typedef struct {
+    uint32_t magic;                 // INDEX_MAGIC
+    uint32_t version;               // INDEX_VERSION
+    uint64_t trace_size;            // Size of the trace it was built from
+    uint64_t entries;               // index_entry_t that follow, sorted by pc then chunk
+} index_header_t;
+
+typedef struct {
+    uint32_t pc;
+    uint32_t chunk;
+} index_entry_t;
+
+typedef struct {
+    const uint8_t* data;            // Mapped trace
+    size_t size;
+    uint64_t* chunks;               // Offset of each chunk header
+    uint32_t chunk_count;
+} trace_file_t;
+
+// One batch of chunks for the pool: task i handles chunk_list[i]
+typedef struct {
+    const trace_file_t* trace;
+    const uint32_t* chunk_list;
+    bool filter;                    // Only records at filter_pc
+    uint32_t filter_pc;
+    char** text;                    // Decode: formatted lines per task
+    size_t* text_size;
+    uint32_t** pcs;                 // Index: sorted distinct PCs per task
+    uint32_t* pc_count;
+    bool failed;
+} batch_t;
+
+static const char* mode_name(uint32_t cpsr) {
+    switch (cpsr & 0x1F) {
+    case 0x10: return "USR";
+    case 0x11: return "FIQ";
+    case 0x12: return "IRQ";
+    case 0x13: return "SVC";
+    case 0x17: return "ABT";
+    case 0x1B: return "UND";
+    case 0x1F: return "SYS";
+    default: return "???";
+    }
+}
+
+static bool open_trace(trace_file_t* trace, const char* path) {
+    memset(trace, 0, sizeof(*trace));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    trace->size = (size_t)st.st_size;
+    if (trace->size > 0) {
+        void* data = mmap(NULL, trace->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Failed to map %s\n", path);
+            close(fd);
+            return false;
+        }
+        trace->data = (const uint8_t*)data;
+        madvise(data, trace->size, MADV_WILLNEED);
+    }
+    close(fd);
+
+    uint32_t capacity = 0;
+    uint64_t offset = 0;
+    while (offset + sizeof(trace_chunk_header_t) <= trace->size) {
+        trace_chunk_header_t header;
+        memcpy(&header, trace->data + offset, sizeof(header));
+        uint64_t end = offset + sizeof(header) + header.compressed;
+        if (header.magic != TRACE_MAGIC || end > trace->size) {
+            fprintf(stderr, "%s: corrupt or truncated chunk at offset %llu, ignoring the rest\n",
+                    path, (unsigned long long)offset);
+            break;
+        }
+        if (trace->chunk_count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            uint64_t* chunks = (uint64_t*)realloc(trace->chunks, capacity * sizeof(uint64_t));
+            if (!chunks) return false;
+            trace->chunks = chunks;
+        }
+        trace->chunks[trace->chunk_count++] = offset;
+        offset = end;
+    }
+    return true;
+}
+
+static void close_trace(trace_file_t* trace) {
+    if (trace->data) munmap((void*)trace->data, trace->size);
+    free(trace->chunks);
+}
+
+static trace_record_t* decode(const trace_file_t* trace, uint32_t chunk, trace_chunk_header_t* header) {
+    const uint8_t* base = trace->data + trace->chunks[chunk];
+    memcpy(header, base, sizeof(*header));
+    trace_record_t* records = (trace_record_t*)malloc(TRACE_CHUNK_RECORDS * sizeof(trace_record_t));
+    if (records && !trace_decode_chunk(header, base + sizeof(*header), records)) {
+        free(records);
+        return NULL;
+    }
+    return records;
+}
+
+static void decode_task(void* ctx, unsigned index) {
+    batch_t* batch = (batch_t*)ctx;
+    trace_chunk_header_t header;
+    trace_record_t* records = decode(batch->trace, batch->chunk_list[index], &header);
+    char* text = records ? (char*)malloc((size_t)header.records * LINE_MAX_BYTES + 1) : NULL;
+    if (!text) {
+        free(records);
+        batch->failed = true;
+        return;
+    }
+    size_t size = 0;
+    char disasm[64];
+    for (uint32_t i = 0; i < header.records; i++) {
+        const trace_record_t* r = &records[i];
+        if (batch->filter && r->pc != batch->filter_pc) continue;
+        disasm_arm(r->instr, r->pc, disasm, sizeof(disasm));
+        size += (size_t)snprintf(text + size, LINE_MAX_BYTES, "%llu  0x%08X: 0x%08X  %c%c%c%c %s  ; %s\n",
+                                 (unsigned long long)(header.first + i), r->pc, r->instr,
+                                 (r->cpsr & (1u << 31)) ? 'N' : 'n', (r->cpsr & (1u << 30)) ? 'Z' : 'z',
+                                 (r->cpsr & (1u << 29)) ? 'C' : 'c', (r->cpsr & (1u << 28)) ? 'V' : 'v',
+                                 mode_name(r->cpsr), disasm);
+    }
+    free(records);
+    batch->text[index] = text;
+    batch->text_size[index] = size;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_entry(const void* a, const void* b) {
+    const index_entry_t* x = (const index_entry_t*)a;
+    const index_entry_t* y = (const index_entry_t*)b;
+    if (x->pc != y->pc) return x->pc < y->pc ? -1 : 1;
+    return x->chunk < y->chunk ? -1 : x->chunk > y->chunk;
+}
+
+static void index_task(void* ctx, unsigned index) {
+    batch_t* batch = (batch_t*)ctx;
+    trace_chunk_header_t header;
+    trace_record_t* records = decode(batch->trace, batch->chunk_list[index], &header);
+    uint32_t* pcs = records ? (uint32_t*)malloc(header.records * sizeof(uint32_t) + 1) : NULL;
+    if (!pcs) {
+        free(records);
+        batch->failed = true;
+        return;
+    }
+    for (uint32_t i = 0; i < header.records; i++) {
+        pcs[i] = records[i].pc;
+    }
+    free(records);
+    qsort(pcs, header.records, sizeof(uint32_t), compare_u32);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < header.records; i++) {
+        if (count == 0 || pcs[count - 1] != pcs[i]) pcs[count++] = pcs[i];
+    }
+    batch->pcs[index] = pcs;
+    batch->pc_count[index] = count;
+}
+
+// Runs task over chunk_list in batches; decode batches are printed in order,
+// index batches appended to *entries
+static bool run_batches(threadpool_t* pool, const trace_file_t* trace, const uint32_t* chunk_list, uint32_t count,
+                        threadpool_task_t task, batch_t* batch, index_entry_t** entries, uint64_t* entry_count) {
+    unsigned batch_size = threadpool_size(pool) * BATCH_PER_THREAD;
+    uint64_t capacity = *entry_count;
+    bool ok = true;
+    char* text[256];
+    size_t text_size[256];
+    uint32_t* pcs[256];
+    uint32_t pc_count[256];
+    if (batch_size > 256) batch_size = 256;
+    batch->trace = trace;
+    batch->text = text;
+    batch->text_size = text_size;
+    batch->pcs = pcs;
+    batch->pc_count = pc_count;
+
+    for (uint32_t start = 0; start < count && ok; start += batch_size) {
+        unsigned n = count - start < batch_size ? count - start : batch_size;
+        memset(text, 0, sizeof(text));
+        memset(pcs, 0, sizeof(pcs));
+        batch->chunk_list = chunk_list + start;
+        batch->failed = false;
+        threadpool_run(pool, n, task, batch);
+        if (batch->failed) {
+            fprintf(stderr, "Failed to decode a chunk (corrupt trace or out of memory)\n");
+            ok = false;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            if (ok && text[i]) fwrite(text[i], 1, text_size[i], stdout);
+            if (ok && pcs[i]) {
+                if (*entry_count + pc_count[i] > capacity) {
+                    capacity = (*entry_count + pc_count[i]) * 2;
+                    index_entry_t* grown = (index_entry_t*)realloc(*entries, capacity * sizeof(index_entry_t));
+                    if (!grown) {
+                        fprintf(stderr, "Out of memory building the index\n");
+                        ok = false;
+                    } else {
+                        *entries = grown;
+                    }
+                }
+                for (uint32_t j = 0; ok && j < pc_count[i]; j++) {
+                    (*entries)[(*entry_count)++] = { pcs[i][j], chunk_list[start + i] };
+                }
+            }
+            free(text[i]);
+            free(pcs[i]);
+        }
+    }
+    return ok;
+}
+
+static bool build_index(threadpool_t* pool, const trace_file_t* trace, const char* index_path) {
+    uint32_t* all = (uint32_t*)malloc(((size_t)trace->chunk_count + 1) * sizeof(uint32_t));
+    if (!all) return false;
+    for (uint32_t i = 0; i < trace->chunk_count; i++) {
+        all[i] = i;
+    }
+    batch_t batch = {};
+    index_entry_t* entries = NULL;
+    uint64_t count = 0;
+    bool ok = run_batches(pool, trace, all, trace->chunk_count, index_task, &batch, &entries, &count);
+    free(all);
+    // Chunks arrive in order and each is sorted, so this mostly merges runs
+    if (ok) qsort(entries, count, sizeof(index_entry_t), compare_entry);
+
+    FILE* file = ok ? fopen(index_path, "wb") : NULL;
+    if (ok && !file) fprintf(stderr, "Failed to write %s\n", index_path);
+    if (file) {
+        index_header_t header = { INDEX_MAGIC, INDEX_VERSION, trace->size, count };
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             (count == 0 || fwrite(entries, sizeof(index_entry_t), count, file) == count);
+        if (fclose(file) != 0 || !ok) {
+            fprintf(stderr, "Failed to write %s\n", index_path);
+            ok = false;
+        }
+    }
+    if (ok) fprintf(stderr, "Indexed %llu PC/chunk pairs over %u chunks\n", (unsigned long long)count, trace->chunk_count);
+    free(entries);
+    return ok && file;
+}
+
+// Chunks that executed pc, from the index; NULL = no usable index
+static uint32_t* lookup(const char* index_path, const trace_file_t* trace, uint32_t pc, uint32_t* count) {
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(index_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    const index_header_t* header = (const index_header_t*)data;
+    const index_entry_t* entries = (const index_entry_t*)(header + 1);
+    uint32_t* chunks = NULL;
+    if (header->magic == INDEX_MAGIC && header->version == INDEX_VERSION && header->trace_size == trace->size &&
+        sizeof(index_header_t) + header->entries * sizeof(index_entry_t) <= (size_t)st.st_size) {
+        uint64_t low = 0, high = header->entries;
+        while (low < high) { // First entry for pc
+            uint64_t mid = low + (high - low) / 2;
+            if (entries[mid].pc < pc) low = mid + 1;
+            else high = mid;
+        }
+        uint64_t end = low;
+        while (end < header->entries && entries[end].pc == pc) end++;
+        chunks = (uint32_t*)malloc((end - low + 1) * sizeof(uint32_t));
+        *count = 0;
+        for (uint64_t i = low; chunks && i < end; i++) {
+            if (entries[i].chunk < trace->chunk_count) chunks[(*count)++] = entries[i].chunk;
+        }
+    } else {
+        fprintf(stderr, "%s does not match the trace, rebuilding it\n", index_path);
+    }
+    munmap(data, (size_t)st.st_size);
+    return chunks;
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned threads = cpus > 0 ? (unsigned)cpus : 1;
+    bool index_only = false, query = false;
+    uint32_t query_pc = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:ip:")) != -1) {
+        switch (opt) {
+        case 'j': threads = (unsigned)atoi(optarg); break;
+        case 'i': index_only = true; break;
+        case 'p': query = true; query_pc = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "Usage: %s [-j threads] [-i | -p addr] trace\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-j threads] [-i | -p addr] trace\n", argv[0]);
+        return 2;
+    }
+    if (threads < 1) threads = 1;
+    const char* path = argv[optind];
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+
+    trace_file_t trace;
+    if (!open_trace(&trace, path)) return 1;
+    threadpool_t* pool = threadpool_create(threads);
+    if (!pool) {
+        close_trace(&trace);
+        return 1;
+    }
+
+    bool ok;
+    batch_t batch = {};
+    index_entry_t* no_entries = NULL;
+    uint64_t no_count = 0;
+    if (index_only) {
+        ok = build_index(pool, &trace, index_path);
+    } else if (query) {
+        uint32_t count = 0;
+        uint32_t* chunks = lookup(index_path, &trace, query_pc, &count);
+        if (!chunks && build_index(pool, &trace, index_path)) chunks = lookup(index_path, &trace, query_pc, &count);
+        batch.filter = true;
+        batch.filter_pc = query_pc;
+        ok = chunks && run_batches(pool, &trace, chunks, count, decode_task, &batch, &no_entries, &no_count);
+        if (ok) fprintf(stderr, "0x%08X ran in %u of %u chunks\n", query_pc, count, trace.chunk_count);
+        free(chunks);
+    } else {
+        uint32_t* all = (uint32_t*)malloc(((size_t)trace.chunk_count + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; all && i < trace.chunk_count; i++) {
+            all[i] = i;
+        }
+        ok = all && run_batches(pool, &trace, all, trace.chunk_count, decode_task, &batch, &no_entries, &no_count);
+        free(all);
+    }
+    threadpool_destroy(pool);
+    close_trace(&trace);
+    return ok ? 0 : 1;
+}
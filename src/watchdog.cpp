@@ -0,0 +1,101 @@
+#include "watchdog.h"
+#include "machine.h"
+#include <string.h>
+
+void watchdog_init(watchdog_t* wd, const watchdog_config_t* config) {
+    memset(wd, 0, sizeof(*wd));
+    if (config) wd->config = *config;
+    wd->pc_low = 0xFFFFFFFF;
+}
+
+static bool screen_blank(io_t* io) {
+    const uint16_t* pixels = io->video_buffer;
+    size_t count = (size_t)io->frame_width * io->frame_height;
+    for (size_t i = 1; i < count; i++) {
+        if (pixels[i] != pixels[0]) return false;
+    }
+    return true;
+}
+
+void watchdog_frame(watchdog_t* wd, machine_t* m, uint32_t pc_low, uint32_t pc_high, unsigned steps) {
+    arm3_cpu_t* cpu = m->cpu;
+    io_t* io = m->io;
+    const watchdog_config_t* config = &wd->config;
+    wd->frames++;
+    wd->steps += steps;
+
+    if (config->max_steps && wd->steps >= config->max_steps) {
+        cpu_stop(cpu, CPU_STOP_STEP_LIMIT);
+        return;
+    }
+    // A frame with no fault at all ends the run; any fault moves fault_pc or the count
+    if (cpu->fault_pc == wd->fault_pc && cpu->fault_repeats == wd->fault_repeats) cpu->fault_repeats = 0;
+    wd->fault_pc = cpu->fault_pc;
+    wd->fault_repeats = cpu->fault_repeats;
+    if (config->fault_repeats && cpu->fault_repeats >= config->fault_repeats) {
+        cpu_stop(cpu, CPU_STOP_EXCEPTION_LOOP);
+        return;
+    }
+
+    // Stuck: the window grows while the PC stays in range and nothing touches I/O
+    if (config->stuck_frames) {
+        uint32_t low = pc_low < wd->pc_low ? pc_low : wd->pc_low;
+        uint32_t high = pc_high > wd->pc_high ? pc_high : wd->pc_high;
+        if (io->accesses != wd->accesses || high - low >= config->stuck_range) {
+            wd->accesses = io->accesses;
+            wd->pc_low = pc_low;
+            wd->pc_high = pc_high;
+            wd->stuck = 0;
+        } else {
+            wd->pc_low = low;
+            wd->pc_high = high;
+            if (++wd->stuck >= config->stuck_frames) {
+                cpu_stop(cpu, CPU_STOP_STUCK);
+                return;
+            }
+        }
+    }
+
+    if (config->blank_frames && wd->frames % WATCHDOG_BLANK_SAMPLE_FRAMES == 0) {
+        wd->blank = screen_blank(io) ? wd->blank + WATCHDOG_BLANK_SAMPLE_FRAMES : 0;
+        if (wd->blank >= config->blank_frames) {
+            cpu_stop(cpu, CPU_STOP_BLANK_SCREEN);
+        }
+    }
+}
+
+const char* watchdog_status_name(machine_t* m) {
+    if (!m->cpu->halted) return "running";
+    switch (m->cpu->stop_reason) {
+    case CPU_STOP_EXIT:           return "exit";
+    case CPU_STOP_INVALID_FETCH:  return "invalid_fetch";
+    case CPU_STOP_EXCEPTION_LOOP: return "exception_loop";
+    case CPU_STOP_STUCK:          return "stuck";
+    case CPU_STOP_BLANK_SCREEN:   return "blank_screen";
+    case CPU_STOP_STEP_LIMIT:     return "step_limit";
+    case CPU_STOP_BREAKPOINT:     return "breakpoint";
+    case CPU_STOP_WATCHPOINT:     return "watchpoint";
+    default:                      return "stopped";
+    }
+}
+
+void watchdog_report(const watchdog_t* wd, machine_t* m, FILE* out) {
+    arm3_cpu_t* cpu = m->cpu;
+    fprintf(out, "{\"status\":\"%s\",\"exit_code\":%u,\"frame\":%llu,\"steps\":%llu,\"cycles\":%llu,"
+                 "\"io_accesses\":%llu,\"pc\":\"0x%08X\",\"cpsr\":\"0x%08X\",\"registers\":[",
+            watchdog_status_name(m), cpu->exit_code, (unsigned long long)wd->frames,
+            (unsigned long long)wd->steps, (unsigned long long)m->io->cycles,
+            (unsigned long long)m->io->accesses, cpu->registers[15] & ADDR_MASK, cpu->cpsr);
+    for (int i = 0; i < 16; i++) {
+        fprintf(out, "%s\"0x%08X\"", i ? "," : "", cpu->registers[i]);
+    }
+    fprintf(out, "]");
+    if (cpu->stop_reason == CPU_STOP_STUCK) {
+        fprintf(out, ",\"pc_range\":[\"0x%08X\",\"0x%08X\"],\"stuck_frames\":%u", wd->pc_low, wd->pc_high, wd->stuck);
+    }
+    if (cpu->fault_repeats) {
+        fprintf(out, ",\"fault_pc\":\"0x%08X\",\"fault_repeats\":%u", cpu->fault_pc, cpu->fault_repeats);
+    }
+    fprintf(out, "}\n");
+    fflush(out);
+}
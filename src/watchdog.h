@@ -0,0 +1,40 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <cstdint>
+#include <stdio.h>
+
+struct machine;
+
+// No-progress detection, checked after every frame. A trip stops the CPU with
+// one of the watchdog CPU_STOP_* reasons; watchdog_report then describes it.
+#define WATCHDOG_BLANK_SAMPLE_FRAMES 50 // Screen checked once per emulated second
+
+typedef struct {
+    unsigned stuck_frames;     // Frames with PC inside stuck_range bytes and no I/O (0 = off)
+    uint32_t stuck_range;      // Size of the PC window in bytes
+    unsigned fault_repeats;    // Consecutive faults at one instruction (0 = off)
+    unsigned blank_frames;     // Frames with a single-colour screen (0 = off)
+    uint64_t max_steps;        // CPU steps before stopping (0 = unlimited)
+} watchdog_config_t;
+
+typedef struct {
+    watchdog_config_t config;
+    uint64_t frames;           // Frames checked
+    uint64_t steps;            // CPU steps executed
+    uint64_t accesses;         // I/O access count when the stuck window opened
+    uint32_t pc_low;           // Fetch PC range over the stuck window
+    uint32_t pc_high;
+    unsigned stuck;            // Frames in the stuck window
+    unsigned blank;            // Frames the screen has been blank
+    uint32_t fault_pc;         // cpu->fault_pc/fault_repeats at the end of the last frame
+    uint32_t fault_repeats;
+} watchdog_t;
+
+void watchdog_init(watchdog_t* wd, const watchdog_config_t* config);
+// Called after each frame with the fetch PC range and steps of that frame
+void watchdog_frame(watchdog_t* wd, struct machine* m, uint32_t pc_low, uint32_t pc_high, unsigned steps);
+void watchdog_report(const watchdog_t* wd, struct machine* m, FILE* out); // One JSON line
+const char* watchdog_status_name(struct machine* m);
+
+#endif